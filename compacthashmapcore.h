@@ -0,0 +1,326 @@
+#pragma once
+
+#include "hashmapcore.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Compact hash table in the style of CPython's dict: the entries (key,
+// value, hash) live in one dense array in insertion order, and the hash
+// table proper is a sparse array of slot indices into it, probed linearly.
+// Index slots are 8, 16 or 32 bits wide, the narrowest that can address
+// the table, so a small table spends one byte per slot on hashing.
+//
+// Iterating (forEach, rehash) is a linear scan of the entry array and
+// visits the entries in the order they were inserted. Erasing leaves a
+// dummy index slot and a hole in the entry array; holes are squeezed out,
+// order kept, the next time the index is rebuilt.
+//
+// Same interface as HashMapCore, with one "bucket" per index slot, so a
+// bucket holds at most one entry and probing walks on to the next one.
+template<typename K, typename V,
+         typename Hash = HashMapHash<K>,
+         typename Eq = std::equal_to<>>
+class CompactHashMapCore {
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using hasher = Hash;
+
+    struct Node {
+        K key;
+        V value;
+        size_t hash;
+    };
+
+    // Linear probing over single slots degrades past about 2/3 full.
+    static constexpr float kMaxLoadFactor = 2.0f / 3.0f;
+    static constexpr bool kCuckoo = false;
+    // forEach() scans a contiguous array in insertion order.
+    static constexpr bool kDenseEntries = true;
+    static constexpr bool kPlainModulo = false;
+
+    explicit CompactHashMapCore(int initialBucketCount = 16, float maxLoadFactor = 0.75f,
+                                const Hash &hash = Hash(), const Eq &eq = Eq())
+        : maxLoadFactor_(std::min(maxLoadFactor, kMaxLoadFactor)),
+        hash_(hash),
+        eq_(eq) {
+        allocate(std::max(2, initialBucketCount));
+    }
+
+    int size() const { return numElements_; }
+    int bucketCount() const { return slotCount_; }
+    // Bytes per index slot: 1, 2 or 4.
+    int indexWidth() const { return width_; }
+    // Erased entries still taking room in the entry array.
+    int holes() const { return static_cast<int>(entries_.size()) - numElements_; }
+    float maxLoadFactor() const { return maxLoadFactor_; }
+    void setMaxLoadFactor(float maxLoadFactor) { maxLoadFactor_ = std::min(maxLoadFactor, kMaxLoadFactor); }
+
+    // Fraction of index slots pointing at a live entry.
+    float loadFactor() const {
+        return static_cast<float>(numElements_) / static_cast<float>(slotCount_);
+    }
+
+    template<typename Q>
+    size_t hashOf(const Q &key) const { return hash_(key); }
+    const Hash &hashFunction() const { return hash_; }
+
+    int bucketForHash(size_t hash, int bucketCount) const {
+        return static_cast<int>(mix(hash) % static_cast<size_t>(bucketCount));
+    }
+    int bucketForHash(size_t hash) const { return bucketForHash(hash, slotCount_); }
+    int bucketFor(const K &key, int bucketCount) const { return bucketForHash(hash_(key), bucketCount); }
+    int bucketFor(const K &key) const { return bucketFor(key, slotCount_); }
+    // Index slot that points at the node, which probing may have moved
+    // past its home slot.
+    int bucketOf(const Node &node) const {
+        const qint32 entry = static_cast<qint32>(&node - entries_.data());
+        int slot = bucketForHash(node.hash);
+        while (indexAt(slot) != entry) slot = nextSlot(slot);
+        return slot;
+    }
+
+    // Holes occupy entry positions and dummies occupy probe positions
+    // until the next rebuild, so both count towards the limit.
+    bool needsGrow() const {
+        const int used = std::max(static_cast<int>(entries_.size()), numElements_ + dummies_);
+        return static_cast<float>(used + 1) / static_cast<float>(slotCount_) > maxLoadFactor_;
+    }
+
+    // When holes rather than live entries fill the table, rebuilding at
+    // the same size is enough to reclaim them.
+    int grownBucketCount() const {
+        const float liveLoad = static_cast<float>(numElements_ + 1) / static_cast<float>(slotCount_);
+        if (liveLoad <= maxLoadFactor_ / 2.0f) return slotCount_;
+        return std::max(2, slotCount_ * 2);
+    }
+
+    // Live entries passed on the probe under a uniform hash, plus the
+    // match (Knuth's linear-probing estimate).
+    double expectedHitCompares() const { return 0.5 * (1.0 + 1.0 / (1.0 - loadFactor())); }
+
+    int bucketCountFor(int expectedElements, float load) const {
+        const float effective = std::min(load, maxLoadFactor_);
+        return std::max(1, static_cast<int>(std::ceil(expectedElements / effective)));
+    }
+
+    template<typename Q, typename Visit>
+    Node *find(const Q &key, size_t hash, Visit &&visit) {
+        const int slot = findSlot(key, hash, visit);
+        return slot < 0 ? nullptr : &entries_[static_cast<size_t>(indexAt(slot))];
+    }
+
+    Node *find(const K &key) {
+        return find(key, hash_(key), [](const Node &, bool) {});
+    }
+
+    // The entry's position is only known once the index slot is read, so
+    // only the slot is prefetched.
+    void prefetch(size_t hash) const {
+        hashMapPrefetch(&index_[static_cast<size_t>(bucketForHash(hash)) * static_cast<size_t>(width_)]);
+    }
+
+    // Appends the entry and points the first free or dummy slot of its
+    // probe sequence at it. The key must be absent.
+    Node &insertUnique(size_t hash, K key, V value) {
+        if (static_cast<int>(entries_.size()) >= maxEntries()) rehash(grownBucketCount());
+        int slot = bucketForHash(hash);
+        while (indexAt(slot) >= 0) slot = nextSlot(slot);
+        if (indexAt(slot) == kDummy) --dummies_;
+        setIndex(slot, static_cast<qint32>(entries_.size()));
+        entries_.push_back(Node{std::move(key), std::move(value), hash});
+        erased_.push_back(false);
+        ++numElements_;
+        return entries_.back();
+    }
+
+    template<typename Q, typename Visit>
+    bool erase(const Q &key, size_t hash, Visit &&visit) {
+        const int slot = findSlot(key, hash, visit);
+        if (slot < 0) return false;
+        const size_t entry = static_cast<size_t>(indexAt(slot));
+        setIndex(slot, kDummy);
+        ++dummies_;
+        --numElements_;
+        if (entry + 1 == entries_.size()) {
+            // The newest entry leaves no hole
+            entries_.pop_back();
+            erased_.pop_back();
+        } else {
+            // Release what the key and value own until the hole is squeezed out
+            entries_[entry] = Node{K{}, V{}, 0};
+            erased_[entry] = true;
+        }
+        return true;
+    }
+
+    // Squeezes the holes out of the entry array, keeping the order, and
+    // builds a fresh index of newBucketCount slots (grown if needed to fit
+    // the entries). Only the index is rehashed: no entry is hashed again.
+    template<typename OnMove>
+    void rehash(int newBucketCount, OnMove &&onMove) {
+        const int minimum = bucketCountFor(numElements_ + 1, maxLoadFactor_);
+        newBucketCount = std::max({2, newBucketCount, minimum});
+
+        if (holes() > 0) {
+            size_t live = 0;
+            for (size_t i = 0; i < entries_.size(); ++i) {
+                if (erased_[i]) continue;
+                if (live != i) entries_[live] = std::move(entries_[i]);
+                ++live;
+            }
+            entries_.erase(entries_.begin() + static_cast<std::ptrdiff_t>(live), entries_.end());
+            erased_.assign(live, false);
+        }
+
+        allocate(newBucketCount);
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            int slot = bucketForHash(entries_[i].hash);
+            while (indexAt(slot) != kEmpty) slot = nextSlot(slot);
+            setIndex(slot, static_cast<qint32>(i));
+            onMove(static_cast<const Node &>(entries_[i]), slot);
+        }
+        numElements_ = static_cast<int>(entries_.size());
+    }
+
+    void rehash(int newBucketCount) {
+        rehash(newBucketCount, [](const Node &, int) {});
+    }
+
+    // Rebuilding the index is one linear pass over the entries, so this
+    // backend always resizes in one go.
+    static constexpr bool kIncrementalRehash = false;
+
+    template<typename OnMove>
+    bool rehashStep(int, OnMove &&) { return false; }
+
+    size_t nodeBytesReserved() const {
+        return entries_.capacity() * sizeof(Node) + index_.size() + erased_.capacity() / 8;
+    }
+    size_t nodeBytesLive() const { return static_cast<size_t>(numElements_) * sizeof(Node); }
+    // The entry array and the index.
+    int nodeSlabs() const { return 2; }
+
+    bool isRehashing() const { return false; }
+    int rehashSourceBuckets() const { return 0; }
+    int rehashedBuckets() const { return 0; }
+
+    bool isTreeBucket(int) const { return false; }
+    int treeBucketCount() const { return 0; }
+
+    void clear() {
+        entries_.clear();
+        erased_.clear();
+        std::fill(index_.begin(), index_.end(), static_cast<unsigned char>(0xFF));
+        numElements_ = 0;
+        dummies_ = 0;
+    }
+
+    int bucketSize(int index) const { return indexAt(index) >= 0 ? 1 : 0; }
+
+    template<typename F>
+    void forEachInBucket(int index, F &&f) const {
+        const qint32 entry = indexAt(index);
+        if (entry >= 0) f(entries_[static_cast<size_t>(entry)]);
+    }
+
+    // Insertion order.
+    template<typename F>
+    void forEach(F &&f) const {
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            if (!erased_[i]) f(entries_[i]);
+        }
+    }
+
+    // First entry, in insertion order, that pred accepts; pred sees every
+    // entry up to it.
+    template<typename Pred>
+    const Node *findEntry(Pred &&pred) const {
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            if (!erased_[i] && pred(entries_[i])) return &entries_[i];
+        }
+        return nullptr;
+    }
+
+private:
+    // Index slot values; anything else is a position in entries_. All-ones
+    // bytes read back as kEmpty at every width.
+    static constexpr qint32 kEmpty = -1;
+    static constexpr qint32 kDummy = -2;
+
+    std::vector<Node> entries_;
+    std::vector<bool> erased_;           // per entry, parallel to entries_
+    std::vector<unsigned char> index_;   // slotCount_ slots of width_ bytes
+    int width_ = 1;
+    int slotCount_ = 0;
+    int numElements_ = 0;
+    int dummies_ = 0;                    // index slots left by erases
+    float maxLoadFactor_ = 0.75f;
+    Hash hash_;
+    Eq eq_;
+
+    // Spread the hash so identity hashes (std::hash<int>) still land on
+    // well-distributed home slots.
+    static size_t mix(size_t hash) {
+        const quint64 h = static_cast<quint64>(hash) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+
+    int nextSlot(int slot) const { return slot + 1 == slotCount_ ? 0 : slot + 1; }
+
+    // One slot always stays empty, so every probe ends.
+    int maxEntries() const { return slotCount_ - 1; }
+
+    qint32 indexAt(int slot) const {
+        const unsigned char *p = &index_[static_cast<size_t>(slot) * static_cast<size_t>(width_)];
+        switch (width_) {
+        case 1: return static_cast<qint8>(*p);
+        case 2: { qint16 v; std::memcpy(&v, p, sizeof v); return v; }
+        default: { qint32 v; std::memcpy(&v, p, sizeof v); return v; }
+        }
+    }
+
+    void setIndex(int slot, qint32 value) {
+        unsigned char *p = &index_[static_cast<size_t>(slot) * static_cast<size_t>(width_)];
+        switch (width_) {
+        case 1: { const qint8 v = static_cast<qint8>(value); std::memcpy(p, &v, sizeof v); break; }
+        case 2: { const qint16 v = static_cast<qint16>(value); std::memcpy(p, &v, sizeof v); break; }
+        default: std::memcpy(p, &value, sizeof value); break;
+        }
+    }
+
+    template<typename Q, typename Visit>
+    int findSlot(const Q &key, size_t hash, Visit &visit) {
+        int slot = bucketForHash(hash);
+        for (int probes = 0; probes < slotCount_; ++probes) {
+            const qint32 entry = indexAt(slot);
+            if (entry == kEmpty) return -1;
+            if (entry >= 0) {
+                Node &node = entries_[static_cast<size_t>(entry)];
+                const bool matched = node.hash == hash && eq_(node.key, key);
+                visit(static_cast<const Node &>(node), matched);
+                if (matched) return slot;
+            }
+            slot = nextSlot(slot);
+        }
+        return -1;
+    }
+
+    // Entry positions stay below the slot count, so the width follows it.
+    // The entry array is reserved in full so inserts never move entries.
+    void allocate(int slots) {
+        slotCount_ = slots;
+        width_ = slots <= 0x80 ? 1 : slots <= 0x8000 ? 2 : 4;
+        index_.assign(static_cast<size_t>(slots) * static_cast<size_t>(width_), static_cast<unsigned char>(0xFF));
+        entries_.reserve(static_cast<size_t>(maxEntries()));
+        erased_.reserve(static_cast<size_t>(maxEntries()));
+        numElements_ = 0;
+        dummies_ = 0;
+    }
+};
@@ -0,0 +1,266 @@
+#include "concurrenthashmap.h"
+#include "hashmapengine.h"
+
+#include <algorithm>
+#include <cstdint>
+
+// Shards sit on their own cache lines so one shard's lock traffic doesn't
+// invalidate its neighbours'.
+struct alignas(64) ConcurrentHashMap::Shard {
+    mutable std::shared_mutex lock;
+    HashMapTrace trace;  // the engine's own trace, kept OFF
+    std::unique_ptr<HashMapEngine> engine;
+    // Published by writers under the lock, read without it.
+    std::atomic<int> size{0};
+    std::atomic<int> buckets{0};
+};
+
+namespace {
+
+std::atomic<quint64> nextMapId{1};
+
+} // namespace
+
+ConcurrentHashMap::ConcurrentHashMap(HashMap::DataType keyType, HashMap::DataType valueType, int shardCount,
+                                     int initialBucketsPerShard, float maxLoadFactor, HashMap::Backend backend)
+    : keyType_(keyType),
+    valueType_(valueType),
+    backend_(backend),
+    id_(nextMapId.fetch_add(1, std::memory_order_relaxed)),
+    created_(std::chrono::steady_clock::now()) {
+    // Round up to a power of two; the shard is the top bits of the mixed hash.
+    shardCount_ = 1;
+    shardShift_ = 64;
+    while (shardCount_ < std::min(std::max(1, shardCount), 1024)) {
+        shardCount_ <<= 1;
+        --shardShift_;
+    }
+
+    shards_ = std::make_unique<Shard[]>(shardCount_);
+    for (int i = 0; i < shardCount_; ++i) {
+        Shard &shard = shards_[i];
+        shard.trace.setLevel(HashMapTrace::OFF);
+        shard.engine = makeHashMapEngine(keyType_, valueType_, backend_, initialBucketsPerShard, maxLoadFactor,
+                                         shard.trace);
+        shard.engine->setLookupStats(false);
+        publish(shard);
+    }
+}
+
+ConcurrentHashMap::~ConcurrentHashMap() = default;
+
+bool ConcurrentHashMap::insert(const QVariant &key, const QVariant &value) {
+    int index = 0;
+    Shard &shard = shardAt(key, &index);
+    bool inserted = false;
+    {
+        std::unique_lock<std::shared_mutex> guard(shard.lock);
+        shard.engine->maybeGrow();
+        inserted = shard.engine->emplaceOrAssign(key, value, false);
+        publish(shard);
+    }
+    trace(HashMapTrace::INSERT_OP, index, key, inserted);
+    return inserted;
+}
+
+void ConcurrentHashMap::put(const QVariant &key, const QVariant &value) {
+    int index = 0;
+    Shard &shard = shardAt(key, &index);
+    bool inserted = false;
+    {
+        std::unique_lock<std::shared_mutex> guard(shard.lock);
+        shard.engine->maybeGrow();
+        inserted = shard.engine->emplaceOrAssign(key, value, true);
+        publish(shard);
+    }
+    trace(HashMapTrace::PUT_OP, index, key, inserted);
+}
+
+std::optional<QVariant> ConcurrentHashMap::get(const QVariant &key) const {
+    int index = 0;
+    Shard &shard = shardAt(key, &index);
+    std::optional<QVariant> value;
+    {
+        std::shared_lock<std::shared_mutex> guard(shard.lock);
+        value = shard.engine->get(key);
+    }
+    trace(HashMapTrace::SEARCH_OP, index, key, value.has_value());
+    return value;
+}
+
+bool ConcurrentHashMap::erase(const QVariant &key) {
+    int index = 0;
+    Shard &shard = shardAt(key, &index);
+    bool erased = false;
+    {
+        std::unique_lock<std::shared_mutex> guard(shard.lock);
+        erased = shard.engine->erase(key);
+        publish(shard);
+    }
+    trace(HashMapTrace::DELETE_OP, index, key, erased);
+    return erased;
+}
+
+bool ConcurrentHashMap::contains(const QVariant &key) const {
+    return get(key).has_value();
+}
+
+std::optional<QVariant> ConcurrentHashMap::findByValue(const QVariant &value) const {
+    for (int i = 0; i < shardCount_; ++i) {
+        Shard &shard = shards_[i];
+        std::optional<QVariant> key;
+        {
+            std::shared_lock<std::shared_mutex> guard(shard.lock);
+            key = shard.engine->findByValue(value);
+        }
+        if (key) {
+            trace(HashMapTrace::VALUE_SEARCH_OP, i, *key, true);
+            return key;
+        }
+    }
+    trace(HashMapTrace::VALUE_SEARCH_OP, -1, value, false);
+    return std::nullopt;
+}
+
+void ConcurrentHashMap::clear() {
+    for (int i = 0; i < shardCount_; ++i) {
+        Shard &shard = shards_[i];
+        std::unique_lock<std::shared_mutex> guard(shard.lock);
+        shard.engine->clear();
+        publish(shard);
+    }
+}
+
+int ConcurrentHashMap::size() const {
+    int total = 0;
+    for (int i = 0; i < shardCount_; ++i) total += shards_[i].size.load(std::memory_order_relaxed);
+    return total;
+}
+
+int ConcurrentHashMap::bucketCount() const {
+    int total = 0;
+    for (int i = 0; i < shardCount_; ++i) total += shards_[i].buckets.load(std::memory_order_relaxed);
+    return total;
+}
+
+float ConcurrentHashMap::loadFactor() const {
+    const int buckets = bucketCount();
+    return buckets > 0 ? static_cast<float>(size()) / buckets : 0.0f;
+}
+
+int ConcurrentHashMap::shardFor(const QVariant &key) const {
+    int index = 0;
+    shardAt(key, &index);
+    return index;
+}
+
+QVector<int> ConcurrentHashMap::shardSizes() const {
+    QVector<int> sizes;
+    sizes.reserve(shardCount_);
+    for (int i = 0; i < shardCount_; ++i) sizes.append(shards_[i].size.load(std::memory_order_relaxed));
+    return sizes;
+}
+
+QVector<int> ConcurrentHashMap::shardBucketCounts() const {
+    QVector<int> counts;
+    counts.reserve(shardCount_);
+    for (int i = 0; i < shardCount_; ++i) counts.append(shards_[i].buckets.load(std::memory_order_relaxed));
+    return counts;
+}
+
+QVector<QString> ConcurrentHashMap::steps() const {
+    QVector<TraceEvent> events;
+    {
+        std::lock_guard<std::mutex> guard(buffersLock_);
+        for (const auto &entry : buffers_) {
+            std::lock_guard<std::mutex> bufferGuard(entry.second->lock);
+            events += entry.second->events;
+        }
+    }
+    std::stable_sort(events.begin(), events.end(),
+                     [](const TraceEvent &a, const TraceEvent &b) { return a.nanos < b.nanos; });
+
+    QVector<QString> lines;
+    lines.reserve(events.size());
+    for (const TraceEvent &event : events) lines.append(formatEvent(event));
+    return lines;
+}
+
+void ConcurrentHashMap::clearSteps() {
+    std::lock_guard<std::mutex> guard(buffersLock_);
+    for (const auto &entry : buffers_) {
+        std::lock_guard<std::mutex> bufferGuard(entry.second->lock);
+        entry.second->events.clear();
+    }
+}
+
+ConcurrentHashMap::Shard &ConcurrentHashMap::shardAt(const QVariant &key, int *index) const {
+    if (shardShift_ >= 64) {
+        *index = 0;
+        return shards_[0];
+    }
+    // Fibonacci mix, then the top bits: the engine's bucket index uses the
+    // low bits of the same hash, so shard and bucket stay independent.
+    const std::uint64_t hash = shards_[0].engine->hashFor(key);
+    *index = static_cast<int>((hash * 0x9E3779B97F4A7C15ull) >> shardShift_);
+    return shards_[*index];
+}
+
+void ConcurrentHashMap::publish(Shard &shard) {
+    shard.size.store(shard.engine->size(), std::memory_order_relaxed);
+    shard.buckets.store(shard.engine->bucketCount(), std::memory_order_relaxed);
+}
+
+ConcurrentHashMap::ThreadBuffer &ConcurrentHashMap::threadBuffer() const {
+    // One-entry cache per thread, keyed by map id rather than address so a
+    // new map at a recycled address never sees a stale buffer.
+    thread_local quint64 cachedMap = 0;
+    thread_local ThreadBuffer *cachedBuffer = nullptr;
+    if (cachedMap == id_) return *cachedBuffer;
+
+    std::lock_guard<std::mutex> guard(buffersLock_);
+    std::unique_ptr<ThreadBuffer> &buffer = buffers_[std::this_thread::get_id()];
+    if (!buffer) buffer = std::make_unique<ThreadBuffer>(static_cast<int>(buffers_.size()) - 1);
+    cachedMap = id_;
+    cachedBuffer = buffer.get();
+    return *buffer;
+}
+
+void ConcurrentHashMap::trace(HashMapTrace::OperationKind operation, int shard, const QVariant &key,
+                              bool result) const {
+    if (traceLevel() == HashMapTrace::OFF) return;
+    const qint64 nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - created_).count();
+    ThreadBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> guard(buffer.lock);
+    // Bounded like HashMapTrace: drop the oldest half when full.
+    if (buffer.events.size() >= kMaxEventsPerThread) buffer.events.remove(0, kMaxEventsPerThread / 2);
+    buffer.events.append({nanos, buffer.thread, shard, operation, static_cast<quint8>(result), key});
+}
+
+QString ConcurrentHashMap::formatEvent(const TraceEvent &e) {
+    const QString prefix = QStringLiteral("[%1 µs] T%2 ").arg(e.nanos / 1000.0, 0, 'f', 1).arg(e.thread);
+    const QString key = HashMap::variantToDisplayString(e.key);
+    switch (e.operation) {
+    case HashMapTrace::INSERT_OP:
+        return prefix + QStringLiteral("shard %1: INSERT %2 → %3")
+                            .arg(e.shard)
+                            .arg(key, e.result ? QStringLiteral("inserted") : QStringLiteral("duplicate"));
+    case HashMapTrace::PUT_OP:
+        return prefix + QStringLiteral("shard %1: PUT %2 → %3")
+                            .arg(e.shard)
+                            .arg(key, e.result ? QStringLiteral("inserted") : QStringLiteral("updated"));
+    case HashMapTrace::SEARCH_OP:
+        return prefix + QStringLiteral("shard %1: GET %2 → %3")
+                            .arg(e.shard)
+                            .arg(key, e.result ? QStringLiteral("found") : QStringLiteral("not found"));
+    case HashMapTrace::DELETE_OP:
+        return prefix + QStringLiteral("shard %1: ERASE %2 → %3")
+                            .arg(e.shard)
+                            .arg(key, e.result ? QStringLiteral("erased") : QStringLiteral("not found"));
+    case HashMapTrace::VALUE_SEARCH_OP:
+        return e.result ? prefix + QStringLiteral("shard %1: FIND BY VALUE → key %2").arg(e.shard).arg(key)
+                        : prefix + QStringLiteral("FIND BY VALUE %1 → not found").arg(key);
+    }
+    return prefix + QStringLiteral("shard %1: %2").arg(e.shard).arg(key);
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "hashmap.h"
+#include "hashmaptrace.h"
+
+#include <QString>
+#include <QVariant>
+#include <QVector>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+
+class HashMapEngine;
+
+// Lock-striped HashMap for several producer/consumer threads. Keys are
+// spread over a power-of-two number of shards by the high bits of their
+// hash; each shard is an ordinary typed engine behind its own reader/writer
+// lock, so threads only contend when they land on the same shard, and each
+// shard grows (rehashes) on its own without stalling the others.
+//
+// size() and loadFactor() sum per-shard counters that writers publish
+// after every change, so they never take a lock (and are only a snapshot
+// while writers are running).
+//
+// Shard engines run with their step trace OFF, lookup stats off
+// (HashMapEngine::setLookupStats) and without incremental rehash, so
+// lookups never write and can share a shard's lock. Instead,
+// at SUMMARY level or above, every operation appends one timestamped event
+// to a buffer owned by the calling thread; steps() merges all buffers by
+// timestamp.
+class ConcurrentHashMap {
+public:
+    explicit ConcurrentHashMap(HashMap::DataType keyType = HashMap::STRING,
+                               HashMap::DataType valueType = HashMap::STRING,
+                               int shardCount = 16, int initialBucketsPerShard = 16,
+                               float maxLoadFactor = 0.75f, HashMap::Backend backend = HashMap::CHAINING);
+    ~ConcurrentHashMap();
+
+    ConcurrentHashMap(const ConcurrentHashMap &) = delete;
+    ConcurrentHashMap &operator=(const ConcurrentHashMap &) = delete;
+
+    HashMap::DataType getKeyType() const { return keyType_; }
+    HashMap::DataType getValueType() const { return valueType_; }
+    HashMap::Backend getBackend() const { return backend_; }
+
+    // Thread-safe operations
+    bool insert(const QVariant &key, const QVariant &value);
+    void put(const QVariant &key, const QVariant &value);
+    std::optional<QVariant> get(const QVariant &key) const;
+    bool erase(const QVariant &key);
+    bool contains(const QVariant &key) const;
+    // Scans the shards one at a time, so a value moved between keys by a
+    // concurrent writer may be missed.
+    std::optional<QVariant> findByValue(const QVariant &value) const;
+    void clear();
+
+    // Lock-free aggregates
+    int size() const;
+    int bucketCount() const;
+    float loadFactor() const;
+
+    int shardCount() const { return shardCount_; }
+    int shardFor(const QVariant &key) const;
+    QVector<int> shardSizes() const;
+    QVector<int> shardBucketCounts() const;
+
+    // Per-thread operation trace. Only OFF and SUMMARY are distinguished.
+    void setTraceLevel(HashMapTrace::Level level) { traceLevel_.store(level, std::memory_order_relaxed); }
+    HashMapTrace::Level traceLevel() const { return traceLevel_.load(std::memory_order_relaxed); }
+    QVector<QString> steps() const;
+    void clearSteps();
+
+    static constexpr int kMaxEventsPerThread = 1 << 16;
+
+private:
+    struct Shard;
+
+    struct TraceEvent {
+        qint64 nanos;       // since the map was created
+        int thread;
+        int shard;
+        quint8 operation;   // HashMapTrace::OperationKind
+        quint8 result;      // 1 = inserted / found / erased
+        QVariant key;
+    };
+
+    // Written only by its thread; the lock is uncontended except while
+    // steps() or clearSteps() runs.
+    struct ThreadBuffer {
+        explicit ThreadBuffer(int thread) : thread(thread) {}
+        std::mutex lock;
+        int thread;
+        QVector<TraceEvent> events;
+    };
+
+    HashMap::DataType keyType_;
+    HashMap::DataType valueType_;
+    HashMap::Backend backend_;
+    int shardCount_;
+    int shardShift_;
+    std::unique_ptr<Shard[]> shards_;
+
+    std::atomic<HashMapTrace::Level> traceLevel_{HashMapTrace::OFF};
+    const quint64 id_;  // tells this map apart in the per-thread buffer cache
+    const std::chrono::steady_clock::time_point created_;
+    mutable std::mutex buffersLock_;
+    mutable std::unordered_map<std::thread::id, std::unique_ptr<ThreadBuffer>> buffers_;
+
+    Shard &shardAt(const QVariant &key, int *index) const;
+    static void publish(Shard &shard);
+    ThreadBuffer &threadBuffer() const;
+    void trace(HashMapTrace::OperationKind operation, int shard, const QVariant &key, bool result) const;
+    static QString formatEvent(const TraceEvent &event);
+};
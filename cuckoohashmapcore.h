@@ -0,0 +1,418 @@
+#pragma once
+
+#include "hashmapcore.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Bucketized cuckoo hashing: each key may live in exactly two buckets of
+// kSlots slots, chosen by two hash functions derived from the key's hash,
+// so a lookup compares at most 2 * kSlots keys plus the stash, however
+// full the table and whatever order the keys arrived in.
+//
+// An insert that finds both of its buckets full kicks a resident out of one
+// of them into that resident's other bucket, and so on, for at most
+// kMaxEvictions moves. A longer path is taken as a cycle: the key left over
+// is parked in a small stash, and once the stash holds kStashSize entries
+// needsGrow() asks for a rehash into twice the buckets, which empties it
+// again. Keys whose full hashes are identical share both buckets at every
+// size, so beyond 2 * kSlots of them the rest stay in the stash.
+//
+// Same interface as HashMapCore. Stashed entries are reported under their
+// primary bucket, which can therefore show more than kSlots entries.
+template<typename K, typename V,
+         typename Hash = HashMapHash<K>,
+         typename Eq = std::equal_to<>>
+class CuckooHashMapCore {
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using hasher = Hash;
+
+    struct Node {
+        K key;
+        V value;
+        size_t hash;
+    };
+
+    static constexpr int kSlots = 4;
+    static constexpr int kMaxEvictions = 64;
+    static constexpr int kStashSize = 8;
+    // 4-way buckets stay insertable to about 95% full.
+    static constexpr float kMaxLoadFactor = 0.9f;
+    // Two candidate buckets per key; inserts may relocate other entries.
+    static constexpr bool kCuckoo = true;
+    static constexpr bool kDenseEntries = false;
+    static constexpr bool kPlainModulo = false;
+
+    explicit CuckooHashMapCore(int initialBucketCount = 16, float maxLoadFactor = 0.75f,
+                               const Hash &hash = Hash(), const Eq &eq = Eq())
+        : maxLoadFactor_(std::min(maxLoadFactor, kMaxLoadFactor)),
+        hash_(hash),
+        eq_(eq) {
+        allocate(std::max(1, initialBucketCount));
+    }
+
+    ~CuckooHashMapCore() { destroyAll(); }
+
+    CuckooHashMapCore(const CuckooHashMapCore &) = delete;
+    CuckooHashMapCore &operator=(const CuckooHashMapCore &) = delete;
+
+    int size() const { return numElements_; }
+    int bucketCount() const { return bucketCount_; }
+    int capacity() const { return bucketCount_ * kSlots; }
+    int stashSize() const { return static_cast<int>(stash_.size()); }
+    float maxLoadFactor() const { return maxLoadFactor_; }
+    void setMaxLoadFactor(float maxLoadFactor) { maxLoadFactor_ = std::min(maxLoadFactor, kMaxLoadFactor); }
+
+    // Fraction of table slots in use (stashed entries included).
+    float loadFactor() const {
+        return static_cast<float>(numElements_) / static_cast<float>(capacity());
+    }
+
+    template<typename Q>
+    size_t hashOf(const Q &key) const { return hash_(key); }
+    const Hash &hashFunction() const { return hash_; }
+
+    // The primary bucket; alternateBucketForHash() is the other choice.
+    int bucketForHash(size_t hash, int bucketCount) const {
+        return static_cast<int>(h1(hash) % static_cast<size_t>(bucketCount));
+    }
+    int bucketForHash(size_t hash) const { return bucketForHash(hash, bucketCount_); }
+    int alternateBucketForHash(size_t hash, int bucketCount) const {
+        const int primary = bucketForHash(hash, bucketCount);
+        const int alternate = static_cast<int>(h2(hash) % static_cast<size_t>(bucketCount));
+        // A key whose choices coincide would only have one
+        return alternate != primary || bucketCount == 1 ? alternate : (primary + 1) % bucketCount;
+    }
+    int alternateBucketForHash(size_t hash) const { return alternateBucketForHash(hash, bucketCount_); }
+    int bucketFor(const K &key, int bucketCount) const { return bucketForHash(hash_(key), bucketCount); }
+    int bucketFor(const K &key) const { return bucketFor(key, bucketCount_); }
+    int bucketOf(const Node &node) const {
+        if (inStash(&node)) return bucketForHash(node.hash);
+        return static_cast<int>(indexOf(&node) / kSlots);
+    }
+
+    // Full stashes are what cuckoo cycles leave behind.
+    bool stashFull() const { return stashSize() >= stashLimit_; }
+
+    // One more element would pass the load limit, or the stash is full.
+    bool needsGrow() const {
+        if (stashFull()) return true;
+        const float projected = static_cast<float>(numElements_ + 1) / static_cast<float>(capacity());
+        return projected > maxLoadFactor_;
+    }
+
+    int grownBucketCount() const { return std::max(2, bucketCount_ * 2); }
+
+    // Roughly half a bucket's other residents are compared first.
+    double expectedHitCompares() const { return 1.0 + (kSlots - 1) * loadFactor() / 2.0; }
+
+    int bucketCountFor(int expectedElements, float load) const {
+        const float effective = std::min(load, maxLoadFactor_);
+        const int slots = static_cast<int>(std::ceil(expectedElements / effective));
+        return std::max(1, (slots + kSlots - 1) / kSlots);
+    }
+
+    template<typename Q, typename Visit>
+    Node *find(const Q &key, size_t hash, Visit &&visit) {
+        if (Node *node = findInBucket(bucketForHash(hash), key, hash, visit)) return node;
+        if (Node *node = findInBucket(alternateBucketForHash(hash), key, hash, visit)) return node;
+        for (Node &node : stash_) {
+            const bool matched = node.hash == hash && eq_(node.key, key);
+            visit(static_cast<const Node &>(node), matched);
+            if (matched) return &node;
+        }
+        return nullptr;
+    }
+
+    Node *find(const K &key) {
+        return find(key, hash_(key), [](const Node &, bool) {});
+    }
+
+    void prefetch(size_t hash) const {
+        hashMapPrefetch(&slots_[static_cast<size_t>(bucketForHash(hash)) * kSlots]);
+        hashMapPrefetch(&slots_[static_cast<size_t>(alternateBucketForHash(hash)) * kSlots]);
+    }
+
+    // Places a new element, kicking residents along a cuckoo path if both
+    // its buckets are full. onRelocate(node, from, to, stashed) reports
+    // each resident moved on the way (to is its primary bucket when it
+    // lands in the stash). The key must be absent.
+    template<typename OnRelocate>
+    Node &insertUnique(size_t hash, K key, V value, OnRelocate &&onRelocate) {
+        ++numElements_;
+        for (int bucket : {bucketForHash(hash), alternateBucketForHash(hash)}) {
+            const int free = freeSlot(bucket);
+            if (free >= 0) return place(bucket, free, Node{std::move(key), std::move(value), hash});
+        }
+
+        // Both full: the new node takes a slot in its primary bucket and the
+        // evicted resident carries on. inserted is where the new node sits,
+        // or null while it is the one being carried.
+        int bucket = bucketForHash(hash);
+        Node carried{std::move(key), std::move(value), hash};
+        Node *inserted = nullptr;
+        for (int kick = 0; kick < kMaxEvictions; ++kick) {
+            Node &resident = slot(bucket, victimIn(bucket));
+            const bool evictingNew = inserted == &resident;
+            std::swap(carried, resident);
+            if (!inserted) {
+                inserted = &resident;
+            } else if (evictingNew) {
+                inserted = nullptr;
+            }
+
+            const int target = otherBucket(carried.hash, bucket);
+            if (inserted) onRelocate(static_cast<const Node &>(carried), bucket, target, false);
+            const int free = freeSlot(target);
+            if (free >= 0) {
+                Node &landed = place(target, free, std::move(carried));
+                return inserted ? *inserted : landed;
+            }
+            bucket = target;
+        }
+
+        // Path too long: park whoever is left over in the stash
+        stash_.push_back(std::move(carried));
+        Node &parked = stash_.back();
+        if (inserted) {
+            onRelocate(static_cast<const Node &>(parked), bucket, bucketForHash(parked.hash), true);
+            return *inserted;
+        }
+        return parked;
+    }
+
+    Node &insertUnique(size_t hash, K key, V value) {
+        return insertUnique(hash, std::move(key), std::move(value), [](const Node &, int, int, bool) {});
+    }
+
+    template<typename Q, typename Visit>
+    bool erase(const Q &key, size_t hash, Visit &&visit) {
+        Node *node = find(key, hash, std::forward<Visit>(visit));
+        if (!node) return false;
+        if (inStash(node)) {
+            const size_t i = static_cast<size_t>(node - stash_.data());
+            if (i + 1 != stash_.size()) stash_[i] = std::move(stash_.back());
+            stash_.pop_back();
+        } else {
+            const size_t index = indexOf(node);
+            node->~Node();
+            occupied_[index / kSlots] &= static_cast<quint8>(~(1u << (index % kSlots)));
+        }
+        --numElements_;
+        return true;
+    }
+
+    // Rebuilds into newBucketCount buckets (more if the elements wouldn't
+    // fit), placing the stash back into the table where it now fits.
+    template<typename OnMove>
+    void rehash(int newBucketCount, OnMove &&onMove) {
+        const int minimum = bucketCountFor(numElements_ + 1, maxLoadFactor_);
+        newBucketCount = std::max({1, newBucketCount, minimum});
+
+        std::unique_ptr<Slot[]> oldSlots;
+        std::vector<quint8> oldOccupied;
+        std::vector<Node> oldStash;
+        oldSlots.swap(slots_);
+        oldOccupied.swap(occupied_);
+        oldStash.swap(stash_);
+        const size_t oldCapacity = oldOccupied.size() * kSlots;
+        allocate(newBucketCount);
+
+        // A reinsert may kick nodes placed earlier on to their other bucket
+        // or the stash; those moves are reported too, so the last onMove
+        // for each node names where it ended up.
+        auto reinsert = [&](Node &&node) {
+            const size_t hash = node.hash;
+            Node &placed = insertUnique(hash, std::move(node.key), std::move(node.value),
+                                        [&](const Node &kicked, int, int to, bool) { onMove(kicked, to); });
+            onMove(static_cast<const Node &>(placed), bucketOf(placed));
+        };
+        for (size_t i = 0; i < oldCapacity; ++i) {
+            if (!(oldOccupied[i / kSlots] & (1u << (i % kSlots)))) continue;
+            Node &node = *oldSlots[i].node();
+            reinsert(std::move(node));
+            node.~Node();
+        }
+        for (Node &node : oldStash) reinsert(std::move(node));
+        // Inseparable keys (identical hashes) may keep the stash over its
+        // size; don't ask to grow again until it doubles.
+        stashLimit_ = std::max(kStashSize, stashSize() * 2);
+    }
+
+    void rehash(int newBucketCount) {
+        rehash(newBucketCount, [](const Node &, int) {});
+    }
+
+    // Rebuilding moves entries between two layouts at once, so this
+    // backend always resizes in one go.
+    static constexpr bool kIncrementalRehash = false;
+
+    template<typename OnMove>
+    bool rehashStep(int, OnMove &&) { return false; }
+
+    size_t nodeBytesReserved() const {
+        return static_cast<size_t>(capacity()) * sizeof(Slot) + occupied_.size() + stash_.capacity() * sizeof(Node);
+    }
+    size_t nodeBytesLive() const { return static_cast<size_t>(numElements_) * sizeof(Node); }
+    int nodeSlabs() const { return (bucketCount_ > 0 ? 1 : 0) + (stash_.capacity() > 0 ? 1 : 0); }
+
+    bool isRehashing() const { return false; }
+    int rehashSourceBuckets() const { return 0; }
+    int rehashedBuckets() const { return 0; }
+
+    bool isTreeBucket(int) const { return false; }
+    int treeBucketCount() const { return 0; }
+
+    void clear() {
+        destroyAll();
+        std::fill(occupied_.begin(), occupied_.end(), 0);
+        stashLimit_ = kStashSize;
+    }
+
+    int bucketSize(int index) const {
+        int count = 0;
+        for (quint8 mask = occupied_[static_cast<size_t>(index)]; mask; mask &= mask - 1) ++count;
+        for (const Node &node : stash_) count += bucketForHash(node.hash) == index;
+        return count;
+    }
+
+    template<typename F>
+    void forEachInBucket(int index, F &&f) const {
+        const quint8 mask = occupied_[static_cast<size_t>(index)];
+        for (int s = 0; s < kSlots; ++s) {
+            if (mask & (1u << s)) f(static_cast<const Node &>(slot(index, s)));
+        }
+        for (const Node &node : stash_) {
+            if (bucketForHash(node.hash) == index) f(node);
+        }
+    }
+
+    template<typename F>
+    void forEach(F &&f) const {
+        for (int b = 0; b < bucketCount_; ++b) {
+            const quint8 mask = occupied_[static_cast<size_t>(b)];
+            for (int s = 0; s < kSlots; ++s) {
+                if (mask & (1u << s)) f(static_cast<const Node &>(slot(b, s)));
+            }
+        }
+        for (const Node &node : stash_) f(node);
+    }
+
+private:
+    struct Slot {
+        alignas(Node) unsigned char bytes[sizeof(Node)];
+        Node *node() { return std::launder(reinterpret_cast<Node *>(bytes)); }
+        const Node *node() const { return std::launder(reinterpret_cast<const Node *>(bytes)); }
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    std::vector<quint8> occupied_;  // per bucket, bit s = slot s in use
+    std::vector<Node> stash_;
+    int stashLimit_ = kStashSize;
+    int bucketCount_ = 0;
+    int numElements_ = 0;
+    quint32 victimState_ = 0x9e3779b9u;
+    float maxLoadFactor_ = 0.75f;
+    Hash hash_;
+    Eq eq_;
+
+    // Two mixes of the one hash with unrelated multipliers, so identity
+    // hashes still spread and a key's two buckets are independent.
+    static size_t h1(size_t hash) {
+        const quint64 h = static_cast<quint64>(hash) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+    static size_t h2(size_t hash) {
+        const quint64 h = (static_cast<quint64>(hash) ^ 0x5bd1e9955bd1e995ull) * 0xC2B2AE3D27D4EB4Full;
+        return static_cast<size_t>(h ^ (h >> 29));
+    }
+
+    int otherBucket(size_t hash, int bucket) const {
+        const int primary = bucketForHash(hash);
+        return bucket == primary ? alternateBucketForHash(hash) : primary;
+    }
+
+    // Slot of a full bucket to evict: one whose resident can move straight
+    // into its other bucket if there is one, else a pseudo-random slot so
+    // successive walks don't loop over the same residents.
+    int victimIn(int bucket) {
+        for (int s = 0; s < kSlots; ++s) {
+            const Node &resident = slot(bucket, s);
+            if (freeSlot(otherBucket(resident.hash, bucket)) >= 0) return s;
+        }
+        victimState_ ^= victimState_ << 13;
+        victimState_ ^= victimState_ >> 17;
+        victimState_ ^= victimState_ << 5;
+        return static_cast<int>(victimState_ % kSlots);
+    }
+
+    int freeSlot(int bucket) const {
+        const quint8 mask = occupied_[static_cast<size_t>(bucket)];
+        for (int s = 0; s < kSlots; ++s) {
+            if (!(mask & (1u << s))) return s;
+        }
+        return -1;
+    }
+
+    Node &place(int bucket, int s, Node &&node) {
+        occupied_[static_cast<size_t>(bucket)] |= static_cast<quint8>(1u << s);
+        return *new (slots_[static_cast<size_t>(bucket) * kSlots + static_cast<size_t>(s)].bytes) Node{std::move(node)};
+    }
+
+    Node &slot(int bucket, int s) {
+        return *slots_[static_cast<size_t>(bucket) * kSlots + static_cast<size_t>(s)].node();
+    }
+    const Node &slot(int bucket, int s) const {
+        return *slots_[static_cast<size_t>(bucket) * kSlots + static_cast<size_t>(s)].node();
+    }
+
+    template<typename Q, typename Visit>
+    Node *findInBucket(int bucket, const Q &key, size_t hash, Visit &visit) {
+        const quint8 mask = occupied_[static_cast<size_t>(bucket)];
+        for (int s = 0; s < kSlots; ++s) {
+            if (!(mask & (1u << s))) continue;
+            Node &node = slot(bucket, s);
+            const bool matched = node.hash == hash && eq_(node.key, key);
+            visit(static_cast<const Node &>(node), matched);
+            if (matched) return &node;
+        }
+        return nullptr;
+    }
+
+    bool inStash(const Node *node) const {
+        return !stash_.empty() && node >= stash_.data() && node < stash_.data() + stash_.size();
+    }
+
+    size_t indexOf(const Node *node) const {
+        const Slot *s = reinterpret_cast<const Slot *>(reinterpret_cast<const unsigned char *>(node));
+        return static_cast<size_t>(s - slots_.get());
+    }
+
+    void allocate(int buckets) {
+        bucketCount_ = buckets;
+        slots_.reset(new Slot[static_cast<size_t>(buckets) * kSlots]);
+        occupied_.assign(static_cast<size_t>(buckets), 0);
+        numElements_ = 0;
+    }
+
+    void destroyAll() {
+        if (slots_) {
+            for (size_t b = 0; b < occupied_.size(); ++b) {
+                for (int s = 0; s < kSlots; ++s) {
+                    if (occupied_[b] & (1u << s)) slot(static_cast<int>(b), s).~Node();
+                }
+            }
+        }
+        stash_.clear();
+        numElements_ = 0;
+    }
+};
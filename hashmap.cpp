@@ -1,15 +1,147 @@
 #include "hashmap.h"
+#include "hashmapengine.h"
+
+#include <QRandomGenerator>
 
 #include <algorithm>
-#include <cmath>
-#include <functional>
-#include <string>
 
-HashMap::HashMap(int initialBucketCount, float maxLoadFactor)
-    : buckets_(static_cast<size_t>(std::max(1, initialBucketCount))),
-    numElements_(0),
-    maxLoadFactor_(maxLoadFactor) {
-    stepHistory_.clear();
+namespace {
+
+struct EngineConfig {
+    HashMap::Backend backend;
+    int bucketCount;
+    float maxLoadFactor;
+    HashMapTrace &trace;
+    HashMapHashing hashing;
+};
+
+// Times one facade operation into profile, when there is one, and notes
+// whether the engine started a resize meanwhile.
+class LatencyScope {
+public:
+    LatencyScope(HashMapLatencyProfile *profile, HashMapLatencyProfile::Operation operation,
+                 const HashMapEngine &engine)
+        : profile_(profile), operation_(operation), engine_(engine),
+        resizes_(profile ? engine.resizeCount() : 0),
+        start_(profile ? HashMapStatsRecorder::nowNanos() : 0) {}
+    ~LatencyScope() {
+        if (!profile_) return;
+        const qint64 elapsed = HashMapStatsRecorder::nowNanos() - start_;
+        profile_->record(operation_, elapsed, engine_.resizeCount() != resizes_);
+    }
+    LatencyScope(const LatencyScope &) = delete;
+    LatencyScope &operator=(const LatencyScope &) = delete;
+
+private:
+    HashMapLatencyProfile *profile_;
+    HashMapLatencyProfile::Operation operation_;
+    const HashMapEngine &engine_;
+    int resizes_;
+    qint64 start_;
+};
+
+template<typename K, typename V>
+std::unique_ptr<HashMapEngine> makeEngineFor(const EngineConfig &config) {
+    switch (config.backend) {
+    case HashMap::CHAINING:
+        return std::make_unique<TypedHashMapEngine<HashMapCore<K, V>>>(
+            config.bucketCount, config.maxLoadFactor, config.trace, config.hashing);
+    case HashMap::SWISS_TABLE:
+        return std::make_unique<TypedHashMapEngine<SwissHashMapCore<K, V>>>(
+            config.bucketCount, config.maxLoadFactor, config.trace, config.hashing);
+    case HashMap::CUCKOO:
+        return std::make_unique<TypedHashMapEngine<CuckooHashMapCore<K, V>>>(
+            config.bucketCount, config.maxLoadFactor, config.trace, config.hashing);
+    case HashMap::COMPACT:
+        return std::make_unique<TypedHashMapEngine<CompactHashMapCore<K, V>>>(
+            config.bucketCount, config.maxLoadFactor, config.trace, config.hashing);
+    }
+    return nullptr;
+}
+
+template<typename K>
+std::unique_ptr<HashMapEngine> makeEngineForKey(HashMap::DataType valueType, const EngineConfig &config) {
+    switch (valueType) {
+    case HashMap::STRING: return makeEngineFor<K, HashMapString>(config);
+    case HashMap::INTEGER: return makeEngineFor<K, int>(config);
+    case HashMap::DOUBLE: return makeEngineFor<K, double>(config);
+    case HashMap::FLOAT: return makeEngineFor<K, float>(config);
+    case HashMap::CHAR: return makeEngineFor<K, QChar>(config);
+    }
+    return nullptr;
+}
+
+// Picks the typed core for a (key, value) DataType pair and backend.
+std::unique_ptr<HashMapEngine> makeEngine(HashMap::DataType keyType, HashMap::DataType valueType,
+                                          const EngineConfig &config) {
+    switch (keyType) {
+    case HashMap::STRING: return makeEngineForKey<HashMapString>(valueType, config);
+    case HashMap::INTEGER: return makeEngineForKey<int>(valueType, config);
+    case HashMap::DOUBLE: return makeEngineForKey<double>(valueType, config);
+    case HashMap::FLOAT: return makeEngineForKey<float>(valueType, config);
+    case HashMap::CHAR: return makeEngineForKey<QChar>(valueType, config);
+    }
+    return nullptr;
+}
+
+} // namespace
+
+std::unique_ptr<HashMapEngine> makeHashMapEngine(HashMap::DataType keyType, HashMap::DataType valueType,
+                                                 HashMap::Backend backend, int bucketCount,
+                                                 float maxLoadFactor, HashMapTrace &trace,
+                                                 HashMapHashing hashing) {
+    return makeEngine(keyType, valueType,
+                      EngineConfig{backend, std::max(1, bucketCount), maxLoadFactor, trace, hashing});
+}
+
+HashMap::HashMap(int initialBucketCount, float maxLoadFactor, Backend backend, HashMapHashing hashing)
+    : maxLoadFactor_(maxLoadFactor),
+    initialBucketCount_(std::max(1, initialBucketCount)),
+    backend_(backend),
+    hashing_(hashing) {
+    engine_ = makeEngine(keyType_, valueType_,
+                         EngineConfig{backend_, std::max(1, initialBucketCount), maxLoadFactor_, trace_, hashing_});
+}
+
+HashMap::~HashMap() = default;
+
+void HashMap::setKeyType(DataType type) {
+    if (type == keyType_) return;
+    keyType_ = type;
+    rebuildEngine();
+}
+
+void HashMap::setValueType(DataType type) {
+    if (type == valueType_) return;
+    valueType_ = type;
+    rebuildEngine();
+}
+
+void HashMap::setBackend(Backend backend) {
+    if (backend == backend_) return;
+    backend_ = backend;
+    rebuildEngine();
+}
+
+void HashMap::rebuildEngine() {
+    rebuildEngine(engine_->bucketCount());
+}
+
+void HashMap::rebuildEngine(int bucketCount) {
+    const quint64 epoch = engine_->modificationEpoch();
+    engine_ = makeEngine(keyType_, valueType_,
+                         EngineConfig{backend_, std::max(1, bucketCount), maxLoadFactor_, trace_, hashing_});
+    engine_->setIncrementalRehash(incrementalRehash_);
+    engine_->setMinLoadFactor(minLoadFactor_, initialBucketCount_);
+    engine_->setValueIndexEnabled(valueIndex_);
+    engine_->setBloomFilter(bloomFilter_, bloomFalsePositiveRate_);
+    engine_->setAdaptiveLoadFactor(adaptiveLoad_, adaptiveMinLoad_, adaptiveMaxLoad_, maxLoadFactor_);
+    engine_->restartVersionsAt(epoch);
+}
+
+void HashMap::setIncrementalRehash(bool enabled) {
+    incrementalRehash_ = enabled;
+    engine_->setIncrementalRehash(enabled);
 }
 
 QString HashMap::dataTypeToString(DataType type) {
@@ -30,388 +162,277 @@ QString HashMap::variantToDisplayString(const QVariant &var) {
         return QString::number(var.toInt());
     } else if (var.type() == QVariant::Double) {
         return QString::number(var.toDouble(), 'f', 2);
-    } else if (var.canConvert<float>()) {
-        return QString::number(var.toFloat(), 'f', 2);
     } else if (var.type() == QVariant::Char) {
         return QString(var.toChar());
+    } else if (var.canConvert<float>()) {
+        return QString::number(var.toFloat(), 'f', 2);
     }
     return var.toString();
 }
 
+quint64 HashMap::randomHashSeed() {
+    return QRandomGenerator::system()->generate64();
+}
+
 int HashMap::indexFor(const QVariant &key, int bucketCount) const {
-    size_t hashValue = 0;
-
-    // Use std::hash-like behavior to mirror unordered_map hashing
-    switch (key.type()) {
-    case QVariant::String: {
-        const std::string s = key.toString().toStdString();
-        hashValue = std::hash<std::string>{}(s);
-        break;
-    }
-    case QVariant::Int: {
-        const int v = key.toInt();
-        hashValue = std::hash<int>{}(v);
-        break;
-    }
-    case QVariant::Double: {
-        // QVariant stores float as double by default; both map through std::hash<double>
-        const double v = key.toDouble();
-        hashValue = std::hash<double>{}(v);
-        break;
-    }
-    case QVariant::Char: {
-        const QChar qc = key.toChar();
-        const char c = qc.toLatin1();
-        hashValue = std::hash<char>{}(c);
-        break;
-    }
-    default: {
-        // Try float explicitly if convertible
-        if (key.canConvert<float>()) {
-            const float v = key.toFloat();
-            hashValue = std::hash<float>{}(v);
-        } else {
-            // Fallback to string representation
-            const std::string s = key.toString().toStdString();
-            hashValue = std::hash<std::string>{}(s);
-        }
-        break;
-    }
-    }
+    return engine_->indexFor(key, bucketCount);
+}
 
-    // bucket_index = hash(key) % bucketCount
-    return static_cast<int>(hashValue % static_cast<size_t>(bucketCount));
-}
-
-bool HashMap::validateType(const QVariant &value, DataType expectedType) const {
-    switch (expectedType) {
-    case STRING:
-        return value.canConvert<QString>();
-    case INTEGER:
-        return value.canConvert<int>();
-    case DOUBLE:
-        return value.canConvert<double>();
-    case FLOAT:
-        return value.canConvert<float>();
-    case CHAR:
-        return value.canConvert<QChar>();
-    default:
-        return false;
-    }
+int HashMap::indexForView(const HashMapKeyView &key) const {
+    return engine_->indexFor(key);
 }
 
-void HashMap::addStep(const QString &text) {
-    stepHistory_.append(text);
+void HashMap::beginOperation(HashMapTrace::OperationKind kind) {
+    if (trace_.wants(HashMapTrace::SUMMARY)) {
+        trace_.record({HashMapTrace::OP_BEGIN, kind});
+    }
 }
 
 void HashMap::addStepToHistory(const QString &step) {
-    stepHistory_.append(step);
+    trace_.addText(step);
 }
 
 void HashMap::clearSteps() {
     // Don't clear history, just mark a separator
-    stepHistory_.append("--- Operation Complete ---");
+    if (trace_.wants(HashMapTrace::SUMMARY)) {
+        trace_.record({HashMapTrace::OP_END});
+    }
 }
 
-const QVector<QString> &HashMap::lastSteps() const {
-    return stepHistory_;
+QVector<QString> HashMap::lastSteps() const {
+    return trace_.steps();
 }
 
 int HashMap::size() const {
-    return numElements_;
+    return engine_->size();
 }
 
 int HashMap::bucketCount() const {
-    return static_cast<int>(buckets_.size());
+    return engine_->bucketCount();
 }
 
 float HashMap::loadFactor() const {
-    if (buckets_.empty()) return 0.0f;
-    return static_cast<float>(numElements_) / static_cast<float>(buckets_.size());
-}
-
-void HashMap::maybeGrow() {
-    const float projected = (static_cast<float>(numElements_) + 1.0f)
-    / static_cast<float>(buckets_.empty() ? 1 : buckets_.size());
-    if (projected > maxLoadFactor_) {
-        const int newCount = std::max(2, bucketCount() * 2);
-        addStep(QStringLiteral("Load factor %.2f exceeds %.2f → rehash to %1 buckets")
-                    .arg(newCount)
-                    .arg(loadFactor(), 0, 'f', 2)
-                    .arg(maxLoadFactor_, 0, 'f', 2));
-        rehash(newCount);
-    }
+    return engine_->loadFactor();
 }
 
-bool HashMap::emplaceOrAssign(const QVariant &key, const QVariant &value, bool assignIfExists) {
-    // Validate types
-    if (!validateType(key, keyType_) || !validateType(value, valueType_)) {
-        addStep(QStringLiteral("Type validation failed"));
-        return false;
-    }
-
-    const int bucketCountNow = bucketCount();
+bool HashMap::insert(const QVariant &key, const QVariant &value) {
+    beginOperation(HashMapTrace::INSERT_OP);
+    const LatencyScope timing(latency_.get(), HashMapLatencyProfile::INSERT, *engine_);
+    engine_->maybeGrow();
+    bool result = engine_->emplaceOrAssign(key, value, /*assignIfExists=*/false);
+    clearSteps();
+    return result;
+}
 
-    QString keyStr = variantToDisplayString(key);
-    QString valueStr = variantToDisplayString(value);
+void HashMap::put(const QVariant &key, const QVariant &value) {
+    beginOperation(HashMapTrace::PUT_OP);
+    const LatencyScope timing(latency_.get(), HashMapLatencyProfile::PUT, *engine_);
+    engine_->maybeGrow();
+    (void)engine_->emplaceOrAssign(key, value, /*assignIfExists=*/true);
+    clearSteps();
+}
 
-    // Use our custom indexFor method which shows the simple hash
-    const int index = indexFor(key, bucketCountNow);
+std::optional<QVariant> HashMap::get(const QVariant &key) {
+    beginOperation(HashMapTrace::SEARCH_OP);
+    const LatencyScope timing(latency_.get(), HashMapLatencyProfile::GET, *engine_);
+    std::optional<QVariant> result = engine_->get(key);
+    clearSteps();
+    return result;
+}
 
-    // Show hash calculation based on type
-    if (key.type() == QVariant::Int || key.type() == QVariant::Double) {
-        addStep(QString("📊 Compute: hash(%1) = %1").arg(keyStr));
-        addStep(QString("📐 Calculate: %1 % %2 = %3").arg(keyStr).arg(bucketCountNow).arg(index));
-    } else {
-        addStep(QString("📊 Compute hash for: \"%1\"").arg(keyStr));
-        addStep(QString("📐 Index = hash % %1 = %2").arg(bucketCountNow).arg(index));
-    }
-    addStep(QStringLiteral("Visit bucket %1").arg(index));
-
-    auto &chain = buckets_[static_cast<size_t>(index)];
-    for (auto &node : chain) {
-        QString nodeKeyStr = variantToDisplayString(node.key);
-        addStep(QStringLiteral("Compare keys: %1 == %2 ? %3")
-                    .arg(nodeKeyStr, keyStr, node.key == key ? QStringLiteral("Yes") : QStringLiteral("No")));
-        if (node.key == key) {
-            if (assignIfExists) {
-                QString oldValueStr = variantToDisplayString(node.value);
-                addStep(QStringLiteral("Key exists → update value: %1 → %2").arg(oldValueStr, valueStr));
-                node.value = value;
-            } else {
-                addStep(QStringLiteral("Key exists → no insert (duplicate)"));
-            }
-            return false; // not a new insertion
-        }
-        addStep(QStringLiteral("Traverse next in chain"));
-    }
+bool HashMap::erase(const QVariant &key) {
+    beginOperation(HashMapTrace::DELETE_OP);
+    const LatencyScope timing(latency_.get(), HashMapLatencyProfile::ERASE, *engine_);
+    const bool removed = engine_->erase(key);
+    clearSteps();
+    return removed;
+}
 
-    addStep(QStringLiteral("Append new node to bucket %1").arg(index));
-    chain.push_front(Node{key, value});
-    ++numElements_;
-    addStep(QStringLiteral("New size = %1, load factor = %2")
-                .arg(numElements_)
-                .arg(loadFactor(), 0, 'f', 2));
-    return true;
+bool HashMap::contains(const QVariant &key) {
+    return get(key).has_value();
 }
 
-bool HashMap::insert(const QVariant &key, const QVariant &value) {
-    addStep(QStringLiteral("=== INSERT OPERATION ==="));
-    maybeGrow();
-    bool result = emplaceOrAssign(key, value, /*assignIfExists=*/false);
+std::optional<QVariant> HashMap::getView(const HashMapKeyView &key) {
+    beginOperation(HashMapTrace::SEARCH_OP);
+    const LatencyScope timing(latency_.get(), HashMapLatencyProfile::GET, *engine_);
+    std::optional<QVariant> result = engine_->get(key);
     clearSteps();
     return result;
 }
 
-void HashMap::put(const QVariant &key, const QVariant &value) {
-    addStep(QStringLiteral("=== PUT OPERATION ==="));
-    maybeGrow();
-    (void)emplaceOrAssign(key, value, /*assignIfExists=*/true);
+bool HashMap::eraseView(const HashMapKeyView &key) {
+    beginOperation(HashMapTrace::DELETE_OP);
+    const LatencyScope timing(latency_.get(), HashMapLatencyProfile::ERASE, *engine_);
+    const bool removed = engine_->erase(key);
     clearSteps();
+    return removed;
 }
 
-std::optional<QVariant> HashMap::get(const QVariant &key) {
-    addStep(QStringLiteral("=== SEARCH OPERATION ==="));
-    if (buckets_.empty()) {
-        addStep(QStringLiteral("Table is empty → not found"));
-        clearSteps();
-        return std::nullopt;
-    }
+std::optional<QVariant> HashMap::findByValue(const QVariant &value) {
+    beginOperation(HashMapTrace::VALUE_SEARCH_OP);
+    const LatencyScope timing(latency_.get(), HashMapLatencyProfile::FIND_BY_VALUE, *engine_);
+    return engine_->findByValue(value);
+}
 
-    const int bucketCountNow = bucketCount();
+int HashMap::insertBatch(const QVector<QVariant> &keys, const QVector<QVariant> &values) {
+    beginOperation(HashMapTrace::BATCH_INSERT_OP);
+    const int inserted = engine_->emplaceOrAssignBatch(keys, values, /*assignIfExists=*/false);
+    clearSteps();
+    return inserted;
+}
 
-    QString keyStr = variantToDisplayString(key);
+void HashMap::putBatch(const QVector<QVariant> &keys, const QVector<QVariant> &values) {
+    beginOperation(HashMapTrace::BATCH_PUT_OP);
+    (void)engine_->emplaceOrAssignBatch(keys, values, /*assignIfExists=*/true);
+    clearSteps();
+}
 
-    // Use our custom indexFor method
-    const int index = indexFor(key, bucketCountNow);
+QVector<std::optional<QVariant>> HashMap::getBatch(const QVector<QVariant> &keys) {
+    beginOperation(HashMapTrace::BATCH_GET_OP);
+    QVector<std::optional<QVariant>> results = engine_->getBatch(keys);
+    clearSteps();
+    return results;
+}
 
-    // Show hash calculation
-    if (key.type() == QVariant::Int || key.type() == QVariant::Double) {
-        addStep(QString("📊 Compute: hash(%1) = %1").arg(keyStr));
-        addStep(QString("📐 Calculate: %1 % %2 = %3").arg(keyStr).arg(bucketCountNow).arg(index));
-    } else {
-        addStep(QString("📊 Compute hash for: \"%1\"").arg(keyStr));
-        addStep(QString("📐 Index = hash % %1 = %2").arg(bucketCountNow).arg(index));
-    }
-    addStep(QString("🎯 Visit bucket %1").arg(index));
-
-    const auto &chain = buckets_[static_cast<size_t>(index)];
-    for (const auto &node : chain) {
-        QString nodeKeyStr = variantToDisplayString(node.key);
-        addStep(QStringLiteral("Compare keys: %1 == %2 ? %3")
-                    .arg(nodeKeyStr, keyStr, node.key == key ? QStringLiteral("Yes") : QStringLiteral("No")));
-        if (node.key == key) {
-            QString valueStr = variantToDisplayString(node.value);
-            addStep(QStringLiteral("Found → return value %1").arg(valueStr));
-            clearSteps();
-            return node.value;
-        }
-        addStep(QStringLiteral("Traverse next in chain"));
-    }
-    addStep(QStringLiteral("Reached end of chain → not found"));
+int HashMap::eraseBatch(const QVector<QVariant> &keys) {
+    beginOperation(HashMapTrace::BATCH_ERASE_OP);
+    const int erased = engine_->eraseBatch(keys);
     clearSteps();
-    return std::nullopt;
+    return erased;
 }
 
-bool HashMap::erase(const QVariant &key) {
-    addStep(QStringLiteral("=== DELETE OPERATION ==="));
-    if (buckets_.empty()) {
-        addStep(QStringLiteral("Table is empty → nothing to erase"));
-        clearSteps();
-        return false;
+void HashMap::clear() {
+    engine_->clear();
+    trace_.reset();
+    if (trace_.wants(HashMapTrace::SUMMARY)) {
+        trace_.record({HashMapTrace::CLEARED});
     }
+}
 
-    const int bucketCountNow = bucketCount();
+void HashMap::rehash(int newBucketCount) {
+    beginOperation(HashMapTrace::RESIZE_OP);
+    engine_->rehash(newBucketCount);
+    clearSteps();
+}
 
-    QString keyStr = variantToDisplayString(key);
+void HashMap::reserve(int expectedElements) {
+    beginOperation(HashMapTrace::RESIZE_OP);
+    engine_->reserve(expectedElements);
+    clearSteps();
+}
 
-    // Use our custom indexFor method
-    const int index = indexFor(key, bucketCountNow);
+void HashMap::setMinLoadFactor(float minLoadFactor) {
+    minLoadFactor_ = std::max(0.0f, minLoadFactor);
+    engine_->setMinLoadFactor(minLoadFactor_, initialBucketCount_);
+}
 
-    // Show hash calculation for delete operation
-    if (key.type() == QVariant::Int || key.type() == QVariant::Double) {
-        addStep(QString("📊 Compute: hash(%1) = %1").arg(keyStr));
-        addStep(QString("📐 Calculate: %1 % %2 = %3").arg(keyStr).arg(bucketCountNow).arg(index));
-    } else {
-        addStep(QString("📊 Compute hash for: \"%1\"").arg(keyStr));
-        addStep(QString("📐 Index = hash % %1 = %2").arg(bucketCountNow).arg(index));
-    }
-    addStep(QStringLiteral("Visit bucket %1").arg(index));
-
-    auto &chain = buckets_[static_cast<size_t>(index)];
-    auto before = chain.before_begin();
-    for (auto it = chain.begin(); it != chain.end(); ++it) {
-        QString nodeKeyStr = variantToDisplayString(it->key);
-        addStep(QStringLiteral("Compare keys: %1 == %2 ? %3")
-                    .arg(nodeKeyStr, keyStr, it->key == key ? QStringLiteral("Yes") : QStringLiteral("No")));
-        if (it->key == key) {
-            chain.erase_after(before);
-            --numElements_;
-            addStep(QStringLiteral("Erased node. New size = %1, load factor = %2")
-                        .arg(numElements_)
-                        .arg(loadFactor(), 0, 'f', 2));
-            clearSteps();
-            return true;
-        }
-        ++before;
-        addStep(QStringLiteral("Traverse next in chain"));
-    }
-    addStep(QStringLiteral("Reached end of chain → key not found"));
+void HashMap::shrinkToFit() {
+    beginOperation(HashMapTrace::RESIZE_OP);
+    engine_->shrinkToFit();
     clearSteps();
-    return false;
 }
 
-bool HashMap::contains(const QVariant &key) {
-    return get(key).has_value();
+void HashMap::setValueIndexEnabled(bool enabled) {
+    valueIndex_ = enabled;
+    engine_->setValueIndexEnabled(enabled);
 }
 
-std::optional<QVariant> HashMap::findByValue(const QVariant &value) {
-    addStep("🔍 === SEARCH BY VALUE OPERATION ===");
-    QString valueStr = variantToDisplayString(value);
-    addStep(QString("🎯 Target value: %1").arg(valueStr));
-    addStep(QString("📝 Algorithm: Linear search through all buckets"));
-
-    int totalChecked = 0;
-    // Search through all buckets
-    for (size_t i = 0; i < buckets_.size(); ++i) {
-        addStep(QString("🔎 Checking bucket %1...").arg(i));
-
-        int itemsInBucket = 0;
-        for (const auto &node : buckets_[i]) {
-            itemsInBucket++;
-            totalChecked++;
-            QString currentValue = variantToDisplayString(node.value);
-            QString currentKey = variantToDisplayString(node.key);
-
-            addStep(QString("   Comparing: <%1,%2> value == %3?")
-                        .arg(currentKey, currentValue, valueStr));
-
-            // Compare values
-            if (node.value == value) {
-                addStep(QString("✅ FOUND! Value '%1' at:").arg(valueStr));
-                addStep(QString("   📍 Bucket: %1").arg(i));
-                addStep(QString("   🔑 Key: %1").arg(currentKey));
-                addStep(QString("   📊 Total items checked: %1").arg(totalChecked));
-                return node.key; // Return the key associated with this value
-            }
-        }
-
-        if (itemsInBucket == 0) {
-            addStep(QString("   Bucket %1 is empty").arg(i));
-        }
-    }
+void HashMap::setBloomFilterEnabled(bool enabled, float falsePositiveRate) {
+    bloomFilter_ = enabled;
+    bloomFalsePositiveRate_ = falsePositiveRate;
+    engine_->setBloomFilter(enabled, falsePositiveRate);
+}
 
-    addStep(QString("❌ NOT FOUND: Value '%1' not in any bucket").arg(valueStr));
-    addStep(QString("📊 Total items checked: %1 across %2 buckets")
-                .arg(totalChecked).arg(buckets_.size()));
-    return std::nullopt;
+void HashMap::setAdaptiveLoadFactor(bool enabled, float minLoadFactor, float maxLoadFactor) {
+    adaptiveLoad_ = enabled;
+    adaptiveMinLoad_ = minLoadFactor;
+    adaptiveMaxLoad_ = maxLoadFactor;
+    engine_->setAdaptiveLoadFactor(enabled, minLoadFactor, maxLoadFactor, maxLoadFactor_);
 }
 
-void HashMap::clear() {
-    clearSteps();
-    for (auto &chain : buckets_) {
-        chain.clear();
+void HashMap::setLatencyTracking(bool enabled) {
+    if (!enabled) {
+        latency_.reset();
+    } else if (!latency_) {
+        latency_ = std::make_unique<HashMapLatencyProfile>();
     }
-    numElements_ = 0;
-    addStep(QStringLiteral("Cleared all buckets"));
 }
 
-void HashMap::rehash(int newBucketCount) {
-    if (newBucketCount < 1) newBucketCount = 1;
-    QVector<QString> rehashSteps;
-    rehashSteps.push_back(QStringLiteral("Rehashing to %1 buckets").arg(newBucketCount));
-
-    std::vector<std::forward_list<Node>> newBuckets(static_cast<size_t>(newBucketCount));
-    for (auto &chain : buckets_) {
-        for (auto &node : chain) {
-            const int newIndex = indexFor(node.key, newBucketCount);
-            rehashSteps.append(QStringLiteral("Move (%1,%2) → bucket %3")
-                                   .arg(variantToDisplayString(node.key), variantToDisplayString(node.value))
-                                   .arg(newIndex));
-            newBuckets[static_cast<size_t>(newIndex)].push_front(Node{std::move(node.key), std::move(node.value)});
-        }
-    }
-    buckets_.swap(newBuckets);
-    // Append rehash steps to the live steps log.
-    for (const auto &s : rehashSteps) stepHistory_.append(s);
+void HashMap::resetLatencyProfile() {
+    if (latency_) latency_->reset();
 }
 
-void HashMap::reserve(int expectedElements) {
-    if (expectedElements <= 0) return;
-    const float desiredLoad = 0.6f; // target below max for headroom
-    const int requiredBuckets = std::max(1, static_cast<int>(expectedElements / desiredLoad));
-    if (requiredBuckets > bucketCount()) {
-        addStep(QStringLiteral("Reserve(%1) → rehash to %2 buckets")
-                    .arg(expectedElements)
-                    .arg(requiredBuckets));
-        rehash(requiredBuckets);
-    }
+HashMapStats HashMap::stats() const {
+    return engine_->stats();
+}
+
+bool HashMap::saveSnapshot(const QString &path, QString *error) {
+    HashMapSnapshotHeader header{};
+    header.keyType = static_cast<quint8>(keyType_);
+    header.valueType = static_cast<quint8>(valueType_);
+    header.backend = static_cast<quint8>(backend_);
+    header.maxLoadFactor = maxLoadFactor_;
+    header.hashPolicy = static_cast<quint8>(hashing_.policy);
+    header.hashSeed = hashing_.seed;
+    return engine_->writeSnapshot(path, header, error);
+}
+
+bool HashMap::loadSnapshot(const QString &path, QString *error) {
+    std::shared_ptr<const HashMapSnapshot> snapshot = HashMapSnapshot::open(path, error);
+    if (!snapshot) return false;
+
+    const HashMapSnapshotHeader &header = snapshot->header();
+    keyType_ = static_cast<DataType>(header.keyType);
+    valueType_ = static_cast<DataType>(header.valueType);
+    backend_ = static_cast<Backend>(header.backend);
+    maxLoadFactor_ = header.maxLoadFactor;
+    hashing_ = HashMapHashing{static_cast<HashMapHashing::Policy>(header.hashPolicy), header.hashSeed};
+    rebuildEngine(header.bucketCount);
+    engine_->attachSnapshot(std::move(snapshot));
+    return true;
+}
+
+int HashMap::pendingSnapshotEntries() const {
+    return engine_->pendingSnapshotEntries();
+}
+
+void HashMap::materializeSnapshot() {
+    engine_->materializeSnapshot();
 }
 
 QVector<int> HashMap::bucketSizes() const {
-    QVector<int> sizes;
-    sizes.reserve(static_cast<int>(buckets_.size()));
-    for (const auto &chain : buckets_) {
-        int count = 0;
-        for (const auto &n : chain) {
-            (void)n; // suppress unused variable warning
-            ++count;
-        }
-        sizes.push_back(count);
-    }
-    return sizes;
+    return engine_->bucketSizes();
+}
+
+bool HashMap::isTreeBucket(int bucket) const {
+    return engine_->isTreeBucket(bucket);
 }
 
 QVector<QVector<QPair<QVariant, QVariant>>> HashMap::getBucketContents() const {
-    QVector<QVector<QPair<QVariant, QVariant>>> contents;
-    contents.reserve(static_cast<int>(buckets_.size()));
-    for (const auto &chain : buckets_) {
-        QVector<QPair<QVariant, QVariant>> bucketItems;
-        for (const auto &node : chain) {
-            bucketItems.push_back(QPair<QVariant, QVariant>(node.key, node.value));
-        }
-        contents.push_back(bucketItems);
-    }
-    return contents;
+    return engine_->getBucketContents();
+}
+
+void HashMap::forEachInBucket(int bucket, const EntryVisitor &visitor) const {
+    engine_->forEachInBuckets(bucket, bucket + 1,
+                              [&visitor](int, const QVariant &key, const QVariant &value) { visitor(key, value); });
+}
+
+void HashMap::forEachInBuckets(int first, int last, const BucketEntryVisitor &visitor) const {
+    engine_->forEachInBuckets(first, last, visitor);
 }
 
+void HashMap::forEachEntry(const EntryVisitor &visitor) const {
+    engine_->forEachEntry(visitor);
+}
+
+quint64 HashMap::modificationEpoch() const {
+    return engine_->modificationEpoch();
+}
+
+quint64 HashMap::bucketVersion(int bucket) const {
+    return engine_->bucketVersion(bucket);
+}
+
+QVector<int> HashMap::bucketsChangedSince(quint64 epoch) const {
+    return engine_->bucketsChangedSince(epoch);
+}
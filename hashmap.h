@@ -4,12 +4,24 @@
 #include <QVector>
 #include <QVariant>
 #include <QHashFunctions>
-#include <forward_list>
+#include <functional>
+#include <memory>
 #include <optional>
-#include <vector>
+#include "hashmapbloomfilter.h"
+#include "hashmaphash.h"
+#include "hashmapkeyview.h"
+#include "hashmaplatency.h"
+#include "hashmapstats.h"
+#include "hashmaptrace.h"
+
+class HashMapEngine;
 
 // Generic HashMap supporting multiple data types for keys and values.
 // Instrumented with a human-readable step trace for visualization.
+//
+// The QVariant API is a thin facade: storage lives in a typed core
+// specialised for the selected key/value DataTypes and Backend (see
+// hashmapengine.h).
 class HashMap {
 public:
     enum DataType {
@@ -20,14 +32,43 @@ public:
         CHAR
     };
 
-    explicit HashMap(int initialBucketCount = 16, float maxLoadFactor = 0.75f);
+    // Storage layout. CHAINING keeps a linked list per bucket; SWISS_TABLE is
+    // open addressing with 16-slot probe groups (one "bucket" per group);
+    // CUCKOO gives every key two 4-slot buckets plus a small stash, so a
+    // lookup never compares more than a fixed number of keys; COMPACT keeps
+    // the entries in one dense array in insertion order behind a sparse
+    // index of narrow slot numbers (one "bucket" per index slot).
+    enum Backend {
+        CHAINING,
+        SWISS_TABLE,
+        CUCKOO,
+        COMPACT
+    };
+
+    // Entry visitors get the key and value boxed on the fly; no per-bucket
+    // containers are built.
+    using EntryVisitor = std::function<void(const QVariant &key, const QVariant &value)>;
+    using BucketEntryVisitor = std::function<void(int bucket, const QVariant &key, const QVariant &value)>;
 
-    // Set data types for key and value
-    void setKeyType(DataType type) { keyType_ = type; }
-    void setValueType(DataType type) { valueType_ = type; }
+    explicit HashMap(int initialBucketCount = 16, float maxLoadFactor = 0.75f,
+                     Backend backend = CHAINING, HashMapHashing hashing = HashMapHashing());
+    ~HashMap();
+
+    // Set data types for key and value. Changing a type discards the contents.
+    void setKeyType(DataType type);
+    void setValueType(DataType type);
     DataType getKeyType() const { return keyType_; }
     DataType getValueType() const { return valueType_; }
 
+    // Switching backend discards the contents, like changing a DataType.
+    void setBackend(Backend backend);
+    Backend getBackend() const { return backend_; }
+
+    // Fixed for the map's lifetime; saved with snapshots.
+    HashMapHashing hashing() const { return hashing_; }
+    // A seed for HashMapHashing::seed from the system's entropy source.
+    static quint64 randomHashSeed();
+
     // Generic insert/put methods using QVariant
     bool insert(const QVariant &key, const QVariant &value);
     void put(const QVariant &key, const QVariant &value);
@@ -36,6 +77,31 @@ public:
     bool contains(const QVariant &key);
     std::optional<QVariant> findByValue(const QVariant &value);
 
+    // Transparent lookups: a QStringView, std::string_view (UTF-8) or
+    // numeric key is matched against the stored keys as it is, hashed in
+    // place, with no QVariant built for it. Nothing is allocated for the
+    // key only while the step trace is OFF: the trace defaults to FULL, and
+    // from SUMMARY up it copies the key into its operand pool (and at FULL
+    // each key compared against it), just as for the QVariant forms. UTF-8
+    // keys longer than 256 UTF-16 units are decoded through a QString. See
+    // hashmapkeyview.h for how each key type matches; unlike the QVariant
+    // forms, text is never parsed as a number or the other way round.
+    template<typename Key, std::enable_if_t<HashMapKeyView::accepts<Key>, int> = 0>
+    std::optional<QVariant> get(Key key) { return getView(HashMapKeyView(key)); }
+    template<typename Key, std::enable_if_t<HashMapKeyView::accepts<Key>, int> = 0>
+    bool contains(Key key) { return getView(HashMapKeyView(key)).has_value(); }
+    template<typename Key, std::enable_if_t<HashMapKeyView::accepts<Key>, int> = 0>
+    bool erase(Key key) { return eraseView(HashMapKeyView(key)); }
+
+    // Batch forms of the above. Keys are hashed together and their buckets
+    // prefetched ahead of use; inserts reserve once for the whole batch.
+    // Each call records one summarized trace. keys/values are paired up to
+    // the shorter of the two; keys of the wrong type are skipped.
+    int insertBatch(const QVector<QVariant> &keys, const QVector<QVariant> &values);
+    void putBatch(const QVector<QVariant> &keys, const QVector<QVariant> &values);
+    QVector<std::optional<QVariant>> getBatch(const QVector<QVariant> &keys);
+    int eraseBatch(const QVector<QVariant> &keys);
+
     void clear();
 
     int size() const;
@@ -45,35 +111,154 @@ public:
     void rehash(int newBucketCount);
     void reserve(int expectedElements);
 
-    // Visualization helpers
-    const QVector<QString> &lastSteps() const;
+    // Adaptive growth threshold (hashmaploadcontroller.h). The maximum load
+    // factor starts from the constructor's and moves in steps within
+    // [minLoadFactor, maxLoadFactor] as lookups turn out cheaper or dearer
+    // than a uniform hash would make them; reserve() follows it. Each
+    // change is a LOAD_ADAPT step and is counted in stats(). The open
+    // backends never exceed their own limit. Disabling restores the
+    // constructor's maximum.
+    void setAdaptiveLoadFactor(bool enabled, float minLoadFactor = 0.5f, float maxLoadFactor = 1.0f);
+    bool adaptiveLoadFactor() const { return adaptiveLoad_; }
+
+    // Shrinking. Once erases bring the load factor below minLoadFactor the
+    // table is resized so the load lands halfway between the minimum and
+    // the maximum, never below the initial bucket count (incrementally when
+    // setIncrementalRehash() is on). The minimum is capped at a quarter of
+    // the maximum, so a table just grown or shrunk is never close to the
+    // opposite limit. 0, the default, never shrinks.
+    void setMinLoadFactor(float minLoadFactor);
+    float minLoadFactor() const { return minLoadFactor_; }
+    // Rehashes at once into the fewest buckets that hold the current
+    // entries within the maximum load factor.
+    void shrinkToFit();
+
+    // When enabled, growth no longer moves every node inside one insert: the
+    // old and new bucket arrays coexist and each operation migrates a few old
+    // buckets (CHAINING only; the other backends always resize at once).
+    void setIncrementalRehash(bool enabled);
+    bool incrementalRehash() const { return incrementalRehash_; }
+
+    // Opt-in reverse index value -> keys, kept current by every mutation, so
+    // findByValue() is a hash lookup instead of a scan of every bucket.
+    // Enabling it indexes the current contents in forEachEntry() order.
+    // When several keys hold the value, the scan returns the first in
+    // bucket order while the index returns the one indexed first (a key
+    // counts as indexed again when its value is updated), so enabling it
+    // can change which key comes back; either answer is repeatable.
+    void setValueIndexEnabled(bool enabled);
+    bool valueIndexEnabled() const { return valueIndex_; }
+
+    // Opt-in blocked Bloom filter (hashmapbloomfilter.h) consulted before
+    // the buckets by get, contains and erase, single and batch: most
+    // lookups of absent keys then cost one cache line and no key compares.
+    // falsePositiveRate is the target share of absent keys that still get
+    // through; stats() reports the rate actually seen.
+    void setBloomFilterEnabled(bool enabled,
+                               float falsePositiveRate = HashMapBloomFilter::kDefaultFalsePositiveRate);
+    bool bloomFilterEnabled() const { return bloomFilter_; }
+
+    // Opt-in per-operation latency (hashmaplatency.h). Every insert, put,
+    // get/contains, erase and findByValue is timed, growth included, into
+    // a log-linear histogram for its kind; the ones that started a resize
+    // are recorded a second time under resizing(). Unlike the 1-in-64
+    // sample in stats() nothing is skipped, so the tail is real. Batch
+    // calls aren't timed. The samples survive type and backend changes;
+    // disabling drops them.
+    void setLatencyTracking(bool enabled);
+    bool latencyTracking() const { return latency_ != nullptr; }
+    // Null while tracking is off.
+    const HashMapLatencyProfile *latencyProfile() const { return latency_.get(); }
+    void resetLatencyProfile();
+
+    HashMapStats stats() const;
+
+    // Binary snapshot of the contents, types, backend and bucket count
+    // (format in hashmapsnapshot.h). Loading replaces the contents and
+    // settings, maps the file and moves each snapshot bucket into the live
+    // table only when an operation first touches it (or findByValue,
+    // shrinkToFit, saving or enabling the value index needs them all).
+    // Until then the read accessors below - bucketSizes(), the visitors,
+    // getBucketContents() - see only the live table; materializeSnapshot()
+    // moves the rest in at once. On failure *error says why and the map is
+    // unchanged. Saving materializes first.
+    bool saveSnapshot(const QString &path, QString *error = nullptr);
+    bool loadSnapshot(const QString &path, QString *error = nullptr);
+    int pendingSnapshotEntries() const;
+    void materializeSnapshot();
+
+    // Visualization helpers. Steps are recorded as compact events and only
+    // formatted into text when lastSteps() is read; OFF records nothing.
+    void setTraceLevel(HashMapTrace::Level level) { trace_.setLevel(level); }
+    HashMapTrace::Level traceLevel() const { return trace_.level(); }
+    QVector<QString> lastSteps() const;
     void clearSteps();
+
+    // Step history is a bounded ring of numbered lines. Readers keep a
+    // cursor (a line number) and page forward with readSteps(); older lines
+    // are dropped, or spilled to a file when one is set. clear() and
+    // resetSteps() empty it and bump stepEpoch().
+    void setStepHistoryCapacity(int lines) { trace_.setCapacity(lines); }
+    bool setStepSpillFile(const QString &path) { return trace_.setSpillFile(path); }
+    qint64 firstStep() const { return trace_.firstLine(); }
+    qint64 endStep() const { return trace_.endLine(); }
+    int stepEpoch() const { return trace_.epoch(); }
+    QVector<QString> readSteps(qint64 cursor, int maxCount) const { return trace_.readSteps(cursor, maxCount); }
+    void resetSteps() { trace_.reset(); }
     void addStepToHistory(const QString &step);
     QVector<int> bucketSizes() const;
     QVector<QVector<QPair<QVariant, QVariant>>> getBucketContents() const;
+    void forEachInBucket(int bucket, const EntryVisitor &visitor) const;
+    void forEachInBuckets(int first, int last, const BucketEntryVisitor &visitor) const;
+    // Every entry without going through the buckets; COMPACT visits them
+    // in insertion order.
+    void forEachEntry(const EntryVisitor &visitor) const;
+    // Chaining buckets whose chain grew past HashMapCore::kTreeifyThreshold
+    // are kept as red-black trees; their entries are visited in tree order.
+    bool isTreeBucket(int bucket) const;
+
+    // Change tracking for redraws. Each modification stamps the bucket it
+    // touched with a new epoch; a resize, clear or type/backend change
+    // stamps every bucket. Remember modificationEpoch() after drawing and
+    // later ask which buckets changed since then.
+    quint64 modificationEpoch() const;
+    quint64 bucketVersion(int bucket) const;
+    QVector<int> bucketsChangedSince(quint64 epoch) const;
 
     // Type conversion helpers
     static QString dataTypeToString(DataType type);
     static QString variantToDisplayString(const QVariant &var);
     // Hash function (public for visualization)
     int indexFor(const QVariant &key, int bucketCount) const;
+    // Same for a transparent key (see get(Key)) in the current table, with
+    // no QVariant built; -1 when no key of the key type equals it.
+    template<typename Key, std::enable_if_t<HashMapKeyView::accepts<Key>, int> = 0>
+    int indexFor(Key key) const { return indexForView(HashMapKeyView(key)); }
 
 private:
-    struct Node {
-        QVariant key;
-        QVariant value;
-    };
-
-    std::vector<std::forward_list<Node>> buckets_;
-    int numElements_ = 0;
+    std::unique_ptr<HashMapEngine> engine_;
     float maxLoadFactor_ = 0.75f;
-    QVector<QString> stepHistory_;  // Persistent history
+    float minLoadFactor_ = 0.0f;
+    int initialBucketCount_ = 16;   // floor for automatic shrinking
+    HashMapTrace trace_;  // Persistent history
     DataType keyType_ = STRING;
     DataType valueType_ = STRING;
+    Backend backend_ = CHAINING;
+    HashMapHashing hashing_;
+    bool incrementalRehash_ = false;
+    bool valueIndex_ = false;
+    bool bloomFilter_ = false;
+    bool adaptiveLoad_ = false;
+    float adaptiveMinLoad_ = 0.5f;
+    float adaptiveMaxLoad_ = 1.0f;
+    float bloomFalsePositiveRate_ = HashMapBloomFilter::kDefaultFalsePositiveRate;
+    std::unique_ptr<HashMapLatencyProfile> latency_;  // null unless tracking
 
-    void addStep(const QString &text);
-    bool emplaceOrAssign(const QVariant &key, const QVariant &value, bool assignIfExists);
-    void maybeGrow();
-    bool validateType(const QVariant &value, DataType expectedType) const;
+    void beginOperation(HashMapTrace::OperationKind kind);
+    std::optional<QVariant> getView(const HashMapKeyView &key);
+    bool eraseView(const HashMapKeyView &key);
+    int indexForView(const HashMapKeyView &key) const;
+    void rebuildEngine();
+    void rebuildEngine(int bucketCount);
 };
 
@@ -0,0 +1,718 @@
+// advds_bench_hashmap - micro-benchmarks for the HashMap engine.
+//
+// For every DataType, size (powers of ten) and key distribution it measures
+// insert, get, findByValue, rehash, erase and get_miss (lookups of the erased
+// keys) on every HashMap backend, chaining with its Bloom filter, and on
+// std::unordered_map / QHash holding the same native types, and prints the
+// results as JSON.
+//
+//   advds_bench_hashmap [--min-size N] [--max-size N] [--max-adversarial N]
+//                       [--types string,integer,double,float,char]
+//                       [--distributions uniform,zipfian,adversarial]
+//                       [--seed N] [--out results.json]
+//   advds_bench_hashmap --self-test
+//
+// --self-test instead checks snapshots: for every DataType and backend a
+// map is saved and loaded back (lazily and with materializeSnapshot()) and
+// compared with the original, and truncated or corrupted copies of the file
+// must be rejected with the target map left unchanged. Exits nonzero on the
+// first failure.
+//
+// HashMap is driven through its QVariant API, so its numbers include the
+// boxing every caller pays; "get_view" repeats the lookups through the
+// transparent overloads (QStringView and native numbers) for comparison.
+// Every phase reports heap allocations per op. Memory is counted by replacing the global
+// operator new; storage Qt allocates internally (QString payloads) isn't
+// seen, for any of the implementations.
+
+#include "hashmap.h"
+#include "hashmapcore.h"
+#include "hashmapsnapshot.h"
+
+#include <QChar>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+#include <QStringView>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QVariant>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <numeric>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// Allocation accounting
+
+namespace {
+constexpr size_t kAllocHeader = alignof(std::max_align_t);
+size_t liveBytes = 0;
+size_t allocations = 0;
+} // namespace
+
+void *operator new(size_t size) {
+    void *base = std::malloc(size + kAllocHeader);
+    if (!base) throw std::bad_alloc();
+    *static_cast<size_t *>(base) = size;
+    liveBytes += size;
+    ++allocations;
+    return static_cast<char *>(base) + kAllocHeader;
+}
+
+void operator delete(void *p) noexcept {
+    if (!p) return;
+    char *base = static_cast<char *>(p) - kAllocHeader;
+    liveBytes -= *reinterpret_cast<size_t *>(base);
+    std::free(base);
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete[](void *p) noexcept { operator delete(p); }
+void operator delete(void *p, size_t) noexcept { operator delete(p); }
+void operator delete[](void *p, size_t) noexcept { operator delete(p); }
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// Key and value material
+
+using Clock = std::chrono::steady_clock;
+
+// Every op is timed as part of its phase; one in kSampleEvery is also timed
+// on its own for the percentiles (which therefore include clock overhead).
+constexpr size_t kSampleEvery = 16;
+// Adversarial keys all hash to a multiple of this, so they share buckets in
+// HashMap's hash % bucketCount layout.
+constexpr size_t kCollisionModulus = 256;
+constexpr double kZipfTheta = 0.99;
+
+// Distinct-ish material for id, per type
+template<typename T> T makeValue(uint64_t id);
+template<> QString makeValue<QString>(uint64_t id) { return QStringLiteral("k") + QString::number(static_cast<qulonglong>(id), 36); }
+template<> int makeValue<int>(uint64_t id) { return static_cast<int>(static_cast<uint32_t>(id * 2654435761u)); }
+template<> double makeValue<double>(uint64_t id) { return static_cast<double>(id) * 1.000001 + 0.5; }
+template<> float makeValue<float>(uint64_t id) { return static_cast<float>(id); } // exact below 2^24
+template<> QChar makeValue<QChar>(uint64_t id) { return QChar(static_cast<ushort>(id % 65536)); }
+
+// Zipfian ranks in [0, n) (Gray et al., as used by YCSB).
+class ZipfianGenerator {
+public:
+    explicit ZipfianGenerator(uint64_t n, double theta = kZipfTheta)
+        : n_(n), theta_(theta), alpha_(1.0 / (1.0 - theta)), zetan_(zeta(n, theta)) {
+        const double zeta2 = zeta(2, theta);
+        eta_ = (1.0 - std::pow(2.0 / static_cast<double>(n), 1.0 - theta)) / (1.0 - zeta2 / zetan_);
+    }
+
+    template<typename Rng>
+    uint64_t next(Rng &rng) {
+        const double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        const double uz = u * zetan_;
+        if (uz < 1.0) return 0;
+        if (uz < 1.0 + std::pow(0.5, theta_)) return std::min<uint64_t>(1, n_ - 1);
+        const auto rank = static_cast<uint64_t>(static_cast<double>(n_) * std::pow(eta_ * u - eta_ + 1.0, alpha_));
+        return std::min(rank, n_ - 1);
+    }
+
+private:
+    uint64_t n_;
+    double theta_;
+    double alpha_;
+    double zetan_;
+    double eta_ = 0.0;
+
+    static double zeta(uint64_t n, double theta) {
+        double sum = 0.0;
+        for (uint64_t i = 1; i <= n; ++i) sum += 1.0 / std::pow(static_cast<double>(i), theta);
+        return sum;
+    }
+};
+
+enum Distribution {
+    UNIFORM,
+    ZIPFIAN,
+    ADVERSARIAL
+};
+
+const char *distributionName(Distribution d) {
+    switch (d) {
+    case UNIFORM: return "uniform";
+    case ZIPFIAN: return "zipfian";
+    case ADVERSARIAL: return "adversarial";
+    }
+    return "unknown";
+}
+
+// Key universe plus the index streams each phase replays, so every
+// implementation sees exactly the same operations.
+template<typename K>
+struct Workload {
+    std::vector<K> keys;
+    std::vector<uint32_t> putOrder;
+    std::vector<uint32_t> getOrder;
+    std::vector<uint32_t> eraseOrder;
+};
+
+template<typename K>
+std::vector<K> distinctKeys(size_t n) {
+    std::vector<K> keys;
+    keys.reserve(n);
+    for (uint64_t id = 0; id < n; ++id) keys.push_back(makeValue<K>(id));
+    std::sort(keys.begin(), keys.end(), [](const K &a, const K &b) { return a < b; });
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+template<typename K>
+std::vector<K> collidingKeys(size_t n) {
+    const HashMapHash<K> hash;
+    std::vector<K> keys;
+    keys.reserve(n);
+    // CHAR runs out of candidates long before n; keep what exists.
+    const uint64_t limit = static_cast<uint64_t>(n) * kCollisionModulus * 8;
+    for (uint64_t id = 0; keys.size() < n && id < limit; ++id) {
+        K key = makeValue<K>(id);
+        if (hash(key) % kCollisionModulus == 0) keys.push_back(std::move(key));
+    }
+    std::sort(keys.begin(), keys.end(), [](const K &a, const K &b) { return a < b; });
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+template<typename K>
+Workload<K> makeWorkload(Distribution distribution, size_t n, std::mt19937_64 &rng) {
+    Workload<K> w;
+    w.keys = distribution == ADVERSARIAL ? collidingKeys<K>(n) : distinctKeys<K>(n);
+    const auto count = static_cast<uint32_t>(w.keys.size());
+    if (count == 0) return w;
+
+    if (distribution == ZIPFIAN) {
+        // Hot ranks land on random keys, not on the first few
+        std::vector<uint32_t> rankToKey(count);
+        std::iota(rankToKey.begin(), rankToKey.end(), 0u);
+        std::shuffle(rankToKey.begin(), rankToKey.end(), rng);
+        ZipfianGenerator zipf(count);
+        auto draw = [&](std::vector<uint32_t> &out, size_t ops) {
+            out.resize(ops);
+            for (auto &i : out) i = rankToKey[zipf.next(rng)];
+        };
+        draw(w.putOrder, count);
+        draw(w.getOrder, count);
+        draw(w.eraseOrder, count / 2);
+        return w;
+    }
+
+    w.putOrder.resize(count);
+    std::iota(w.putOrder.begin(), w.putOrder.end(), 0u);
+    std::shuffle(w.putOrder.begin(), w.putOrder.end(), rng);
+    std::uniform_int_distribution<uint32_t> pick(0, count - 1);
+    w.getOrder.resize(count);
+    for (auto &i : w.getOrder) i = pick(rng);
+    w.eraseOrder = w.putOrder;
+    std::shuffle(w.eraseOrder.begin(), w.eraseOrder.end(), rng);
+    w.eraseOrder.resize(count / 2);
+    return w;
+}
+
+// ---------------------------------------------------------------------------
+// Timing
+
+struct PhaseResult {
+    size_t ops = 0;
+    double nsPerOp = 0.0;
+    double p50 = 0.0;
+    double p99 = 0.0;
+    double allocsPerOp = 0.0;
+};
+
+uint64_t sink = 0; // keeps results observable
+
+template<typename Op>
+PhaseResult timePhase(size_t ops, Op &&op) {
+    std::vector<double> samples;
+    samples.reserve(ops / kSampleEvery + 1);
+    const size_t allocationsBefore = allocations;
+    const auto start = Clock::now();
+    for (size_t i = 0; i < ops; ++i) {
+        if (i % kSampleEvery == 0) {
+            const auto t0 = Clock::now();
+            op(i);
+            samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - t0).count());
+        } else {
+            op(i);
+        }
+    }
+    const double total = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    // samples was reserved up front, so every allocation here is an op's
+    const size_t opAllocations = allocations - allocationsBefore;
+
+    PhaseResult r;
+    r.ops = ops;
+    r.nsPerOp = ops ? total / static_cast<double>(ops) : 0.0;
+    r.allocsPerOp = ops ? static_cast<double>(opAllocations) / static_cast<double>(ops) : 0.0;
+    auto percentile = [&samples](double p) {
+        if (samples.empty()) return 0.0;
+        const size_t k = std::min(samples.size() - 1, static_cast<size_t>(p * static_cast<double>(samples.size())));
+        std::nth_element(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(k), samples.end());
+        return samples[k];
+    };
+    r.p50 = percentile(0.50);
+    r.p99 = percentile(0.99);
+    return r;
+}
+
+QJsonObject toJson(const PhaseResult &r) {
+    QJsonObject o;
+    o["ops"] = static_cast<double>(r.ops);
+    o["ns_per_op"] = r.nsPerOp;
+    o["p50_ns"] = r.p50;
+    o["p99_ns"] = r.p99;
+    o["allocs_per_op"] = r.allocsPerOp;
+    return o;
+}
+
+// ---------------------------------------------------------------------------
+// Implementations under test. Each adapter exposes the same five operations,
+// plus getView: the same lookup without building a HashMap QVariant.
+
+// Key as HashMap's transparent lookups take it.
+QStringView lookupKey(const QString &key) { return QStringView(key); }
+QStringView lookupKey(const QChar &key) { return QStringView(&key, 1); }
+template<typename K>
+K lookupKey(const K &key) { return key; }
+
+template<typename K, typename V>
+class HashMapSubject {
+public:
+    HashMapSubject(HashMap::Backend backend, HashMap::DataType type, bool bloomFilter = false)
+        : map_(16, 0.75f, backend) {
+        map_.setTraceLevel(HashMapTrace::OFF);
+        map_.setKeyType(type);
+        map_.setValueType(type);
+        map_.setBloomFilterEnabled(bloomFilter);
+    }
+
+    void put(const K &key, const V &value) { map_.put(QVariant::fromValue(key), QVariant::fromValue(value)); }
+    bool get(const K &key) { return map_.get(QVariant::fromValue(key)).has_value(); }
+    bool getView(const K &key) { return map_.contains(lookupKey(key)); }
+    bool erase(const K &key) { return map_.erase(QVariant::fromValue(key)); }
+    bool findByValue(const V &value) { return map_.findByValue(QVariant::fromValue(value)).has_value(); }
+    void rehash() { map_.rehash(map_.bucketCount() * 2); }
+    size_t size() const { return static_cast<size_t>(map_.size()); }
+
+private:
+    HashMap map_;
+};
+
+// Same hash functor as HashMap, so the comparison is about table layout.
+template<typename K, typename V>
+class StdSubject {
+public:
+    void put(const K &key, const V &value) { map_[key] = value; }
+    bool get(const K &key) { return map_.find(key) != map_.end(); }
+    bool getView(const K &key) { return get(key); }
+    bool erase(const K &key) { return map_.erase(key) != 0; }
+    bool findByValue(const V &value) {
+        return std::find_if(map_.begin(), map_.end(), [&](const auto &p) { return p.second == value; }) != map_.end();
+    }
+    void rehash() { map_.rehash(map_.bucket_count() * 2); }
+    size_t size() const { return map_.size(); }
+
+private:
+    std::unordered_map<K, V, HashMapHash<K>> map_;
+};
+
+template<typename K, typename V>
+class QHashSubject {
+public:
+    void put(const K &key, const V &value) { map_.insert(key, value); }
+    bool get(const K &key) { return map_.constFind(key) != map_.constEnd(); }
+    bool getView(const K &key) { return get(key); }
+    bool erase(const K &key) { return map_.remove(key); }
+    bool findByValue(const V &value) {
+        for (auto it = map_.cbegin(); it != map_.cend(); ++it) {
+            if (it.value() == value) return true;
+        }
+        return false;
+    }
+    void rehash() { map_.reserve(map_.capacity() * 2); }
+    size_t size() const { return static_cast<size_t>(map_.size()); }
+
+private:
+    QHash<K, V> map_;
+};
+
+template<typename K, typename Subject>
+QJsonObject runSubject(Subject &subject, const Workload<K> &w) {
+    using V = K;
+    QJsonObject ops;
+    const size_t before = liveBytes;
+
+    ops["insert"] = toJson(timePhase(w.putOrder.size(), [&](size_t i) {
+        const uint32_t k = w.putOrder[i];
+        subject.put(w.keys[k], makeValue<V>(k + 1));
+    }));
+    const size_t entries = subject.size();
+    const double bytesPerEntry = entries ? static_cast<double>(liveBytes - before) / static_cast<double>(entries) : 0.0;
+
+    ops["get"] = toJson(timePhase(w.getOrder.size(), [&](size_t i) {
+        sink += subject.get(w.keys[w.getOrder[i]]);
+    }));
+    ops["get_view"] = toJson(timePhase(w.getOrder.size(), [&](size_t i) {
+        sink += subject.getView(w.keys[w.getOrder[i]]);
+    }));
+
+    // Each query is a full scan, so keep the total work near 1e7 nodes.
+    const size_t queries = std::max<size_t>(1, std::min<size_t>(100, 10000000 / std::max<size_t>(1, entries)));
+    std::mt19937_64 rng(entries);
+    ops["findByValue"] = toJson(timePhase(queries, [&](size_t) {
+        const size_t k = rng() % w.keys.size();
+        sink += subject.findByValue(makeValue<V>(k + 1));
+    }));
+
+    ops["rehash"] = toJson(timePhase(1, [&](size_t) { subject.rehash(); }));
+
+    ops["erase"] = toJson(timePhase(w.eraseOrder.size(), [&](size_t i) {
+        sink += subject.erase(w.keys[w.eraseOrder[i]]);
+    }));
+
+    // The erased keys again: every lookup misses.
+    ops["get_miss"] = toJson(timePhase(w.eraseOrder.size(), [&](size_t i) {
+        sink += subject.get(w.keys[w.eraseOrder[i]]);
+    }));
+
+    QJsonObject run;
+    run["entries"] = static_cast<double>(entries);
+    run["bytes_per_entry"] = bytesPerEntry;
+    run["ops"] = ops;
+    return run;
+}
+
+struct Options {
+    size_t minSize = 100;
+    size_t maxSize = 10000000;
+    size_t maxAdversarial = 100000; // colliding keys cost O(chain) per op
+    QStringList types = {"string", "integer", "double", "float", "char"};
+    QStringList distributions = {"uniform", "zipfian", "adversarial"};
+    uint64_t seed = 42;
+    QString out;
+    bool selfTest = false;
+};
+
+template<typename K>
+void runType(HashMap::DataType type, const Options &options, QJsonArray &results) {
+    const QString typeName = HashMap::dataTypeToString(type);
+    const Distribution distributions[] = {UNIFORM, ZIPFIAN, ADVERSARIAL};
+    for (Distribution distribution : distributions) {
+        if (!options.distributions.contains(QString::fromLatin1(distributionName(distribution)))) continue;
+        const size_t maxSize = distribution == ADVERSARIAL ? std::min(options.maxSize, options.maxAdversarial)
+                                                           : options.maxSize;
+        for (size_t n = options.minSize; n <= maxSize; n *= 10) {
+            std::mt19937_64 rng(options.seed ^ n);
+            const Workload<K> w = makeWorkload<K>(distribution, n, rng);
+            if (w.keys.empty()) continue;
+
+            auto record = [&](const char *impl, QJsonObject run) {
+                run["impl"] = QString::fromLatin1(impl);
+                run["type"] = typeName;
+                run["distribution"] = QString::fromLatin1(distributionName(distribution));
+                run["size"] = static_cast<double>(n);
+                run["distinct_keys"] = static_cast<double>(w.keys.size());
+                std::fprintf(stderr, "%-18s %-7s %-11s n=%-9zu insert %.1f ns/op\n", impl,
+                             qPrintable(typeName), distributionName(distribution), n,
+                             run["ops"].toObject()["insert"].toObject()["ns_per_op"].toDouble());
+                results.append(run);
+            };
+            {
+                HashMapSubject<K, K> subject(HashMap::CHAINING, type);
+                record("HashMap/chaining", runSubject<K>(subject, w));
+            }
+            {
+                HashMapSubject<K, K> subject(HashMap::CHAINING, type, /*bloomFilter=*/true);
+                record("HashMap/chaining+bloom", runSubject<K>(subject, w));
+            }
+            {
+                HashMapSubject<K, K> subject(HashMap::SWISS_TABLE, type);
+                record("HashMap/swiss", runSubject<K>(subject, w));
+            }
+            {
+                HashMapSubject<K, K> subject(HashMap::CUCKOO, type);
+                record("HashMap/cuckoo", runSubject<K>(subject, w));
+            }
+            {
+                HashMapSubject<K, K> subject(HashMap::COMPACT, type);
+                record("HashMap/compact", runSubject<K>(subject, w));
+            }
+            {
+                StdSubject<K, K> subject;
+                record("std::unordered_map", runSubject<K>(subject, w));
+            }
+            {
+                QHashSubject<K, K> subject;
+                record("QHash", runSubject<K>(subject, w));
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// --self-test
+
+int selfTestFailures = 0;
+
+void check(bool ok, const QString &what) {
+    if (ok) return;
+    if (++selfTestFailures <= 20) std::fprintf(stderr, "self-test: %s\n", qPrintable(what));
+}
+
+template<typename T>
+void poke(QByteArray &bytes, size_t offset, T value) {
+    std::memcpy(bytes.data() + offset, &value, sizeof value);
+}
+
+// Every entry of `map` must match `expected`, and `erased` must be absent.
+template<typename K>
+void checkContents(HashMap &map, const std::vector<std::pair<K, K>> &expected, const std::vector<K> &erased,
+                   const QString &what) {
+    for (const auto &entry : expected) {
+        const std::optional<QVariant> value = map.get(QVariant::fromValue(entry.first));
+        if (!value || value->template value<K>() != entry.second) {
+            check(false, what + QStringLiteral(": wrong or missing value"));
+            return;
+        }
+    }
+    for (const K &key : erased) {
+        if (map.contains(QVariant::fromValue(key))) {
+            check(false, what + QStringLiteral(": erased key came back"));
+            return;
+        }
+    }
+    check(map.size() == static_cast<int>(expected.size()), what + QStringLiteral(": wrong size()"));
+}
+
+// Loading each damaged copy of `bytes` has to fail and leave the map as it was.
+void checkRejected(const QByteArray &bytes, const QString &dir, const QString &what) {
+    const auto *header = reinterpret_cast<const HashMapSnapshotHeader *>(bytes.constData());
+    const size_t directory = sizeof(HashMapSnapshotHeader);
+    const size_t directoryEnd = directory + static_cast<size_t>(header->bucketCount) * sizeof(quint32);
+
+    std::vector<std::pair<const char *, QByteArray>> damaged;
+    damaged.emplace_back("empty", QByteArray());
+    damaged.emplace_back("header cut short", bytes.left(static_cast<int>(sizeof(HashMapSnapshotHeader)) - 1));
+    damaged.emplace_back("last byte missing", bytes.left(bytes.size() - 1));
+    damaged.emplace_back("trailing byte", bytes + QByteArray(1, '\0'));
+    auto corrupt = [&](const char *name, auto &&edit) {
+        QByteArray copy = bytes;
+        edit(copy);
+        damaged.emplace_back(name, copy);
+    };
+    corrupt("bad magic", [](QByteArray &b) { b[0] = static_cast<char>(b[0] ^ 0xff); });
+    corrupt("bad version", [](QByteArray &b) { poke<quint32>(b, offsetof(HashMapSnapshotHeader, version), 99); });
+    corrupt("foreign byte order",
+            [](QByteArray &b) { poke<quint32>(b, offsetof(HashMapSnapshotHeader, byteOrder), 0x04030201); });
+    corrupt("bad key type", [](QByteArray &b) { poke<quint8>(b, offsetof(HashMapSnapshotHeader, keyType), 9); });
+    corrupt("bad value type", [](QByteArray &b) { poke<quint8>(b, offsetof(HashMapSnapshotHeader, valueType), 9); });
+    corrupt("bad backend", [](QByteArray &b) { poke<quint8>(b, offsetof(HashMapSnapshotHeader, backend), 9); });
+    corrupt("bad hash policy", [](QByteArray &b) { poke<quint8>(b, offsetof(HashMapSnapshotHeader, hashPolicy), 9); });
+    corrupt("bad max load factor", [](QByteArray &b) {
+        poke<float>(b, offsetof(HashMapSnapshotHeader, maxLoadFactor), 1e-30f);
+    });
+    corrupt("infinite max load factor", [](QByteArray &b) {
+        poke<float>(b, offsetof(HashMapSnapshotHeader, maxLoadFactor), std::numeric_limits<float>::infinity());
+    });
+    corrupt("no buckets", [](QByteArray &b) { poke<qint32>(b, offsetof(HashMapSnapshotHeader, bucketCount), 0); });
+    corrupt("entry count too large", [header](QByteArray &b) {
+        poke<quint64>(b, offsetof(HashMapSnapshotHeader, entryCount), header->entryCount + 1);
+    });
+    corrupt("directory not starting at 0", [directory](QByteArray &b) { poke<quint32>(b, directory, 1); });
+    corrupt("directory end mismatch", [header, directoryEnd](QByteArray &b) {
+        poke<quint32>(b, directoryEnd, static_cast<quint32>(header->entryCount) + 1);
+    });
+    if (header->bucketCount >= 2) {
+        corrupt("directory out of order", [directory](QByteArray &b) {
+            poke<quint32>(b, directory + sizeof(quint32), 0xffffffffu);
+        });
+    }
+
+    for (const auto &copy : damaged) {
+        const QString path = dir + QStringLiteral("/damaged.snapshot");
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(copy.second) != copy.second.size()) {
+            check(false, QStringLiteral("cannot write %1").arg(path));
+            continue;
+        }
+        file.close();
+
+        HashMap target(16, 0.75f, HashMap::CUCKOO);
+        target.setTraceLevel(HashMapTrace::OFF);
+        target.setKeyType(HashMap::INTEGER);
+        target.setValueType(HashMap::INTEGER);
+        target.put(1, 2);
+        QString error;
+        const QString name = what + QStringLiteral(" (%1)").arg(QString::fromLatin1(copy.first));
+        check(!target.loadSnapshot(path, &error), name + QStringLiteral(": damaged snapshot was accepted"));
+        check(!error.isEmpty(), name + QStringLiteral(": no error message"));
+        check(target.getKeyType() == HashMap::INTEGER && target.getValueType() == HashMap::INTEGER
+                  && target.getBackend() == HashMap::CUCKOO && target.size() == 1
+                  && target.get(1).value_or(QVariant()).toInt() == 2,
+              name + QStringLiteral(": map changed by a failed load"));
+    }
+}
+
+template<typename K>
+void selfTestType(HashMap::DataType type, const QString &dir) {
+    const HashMap::Backend backends[] = {HashMap::CHAINING, HashMap::SWISS_TABLE, HashMap::CUCKOO, HashMap::COMPACT};
+    const char *backendNames[] = {"chaining", "swiss", "cuckoo", "compact"};
+    const std::vector<K> keys = distinctKeys<K>(3000);
+
+    for (int b = 0; b < 4; ++b) {
+        const QString what = QStringLiteral("%1/%2").arg(HashMap::dataTypeToString(type),
+                                                          QString::fromLatin1(backendNames[b]));
+        HashMap map(16, 0.75f, backends[b]);
+        map.setTraceLevel(HashMapTrace::OFF);
+        map.setKeyType(type);
+        map.setValueType(type);
+
+        // Erase every seventh key so the saved table has holes.
+        std::vector<std::pair<K, K>> expected;
+        std::vector<K> erased;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            map.put(QVariant::fromValue(keys[i]), QVariant::fromValue(makeValue<K>(i + 1)));
+        }
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (i % 7 == 3) {
+                map.erase(QVariant::fromValue(keys[i]));
+                erased.push_back(keys[i]);
+            } else {
+                expected.emplace_back(keys[i], makeValue<K>(i + 1));
+            }
+        }
+        checkContents(map, expected, erased, what + QStringLiteral(" before saving"));
+
+        const QString path = dir + QStringLiteral("/map.snapshot");
+        QString error;
+        if (!map.saveSnapshot(path, &error)) {
+            check(false, what + QStringLiteral(": save failed: ") + error);
+            continue;
+        }
+
+        // Lazily: every lookup moves its bucket in on first use.
+        HashMap lazy;
+        lazy.setTraceLevel(HashMapTrace::OFF);
+        check(lazy.loadSnapshot(path, &error), what + QStringLiteral(": load failed: ") + error);
+        check(lazy.getKeyType() == type && lazy.getValueType() == type && lazy.getBackend() == backends[b],
+              what + QStringLiteral(": types or backend not restored"));
+        checkContents(lazy, expected, erased, what + QStringLiteral(" loaded lazily"));
+
+        // At once: afterwards nothing is pending and the visitors see everything.
+        HashMap eager;
+        eager.setTraceLevel(HashMapTrace::OFF);
+        check(eager.loadSnapshot(path, &error), what + QStringLiteral(": load failed: ") + error);
+        eager.materializeSnapshot();
+        check(eager.pendingSnapshotEntries() == 0, what + QStringLiteral(": entries still pending"));
+        int visited = 0;
+        eager.forEachEntry([&visited](const QVariant &, const QVariant &) { ++visited; });
+        check(visited == static_cast<int>(expected.size()), what + QStringLiteral(": forEachEntry misses entries"));
+        checkContents(eager, expected, erased, what + QStringLiteral(" materialized"));
+
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            check(false, QStringLiteral("cannot read %1").arg(path));
+            continue;
+        }
+        const QByteArray bytes = file.readAll();
+        file.close();
+        checkRejected(bytes, dir, what);
+    }
+    std::fprintf(stderr, "self-test %-7s %s\n", qPrintable(HashMap::dataTypeToString(type)),
+                 selfTestFailures ? "FAILED" : "ok");
+}
+
+int runSelfTest() {
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        std::fprintf(stderr, "cannot create a temporary directory\n");
+        return 1;
+    }
+    selfTestType<QString>(HashMap::STRING, dir.path());
+    selfTestType<int>(HashMap::INTEGER, dir.path());
+    selfTestType<double>(HashMap::DOUBLE, dir.path());
+    selfTestType<float>(HashMap::FLOAT, dir.path());
+    selfTestType<QChar>(HashMap::CHAR, dir.path());
+    return selfTestFailures ? 1 : 0;
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (std::strcmp(arg, "--self-test") == 0) {
+            options.selfTest = true;
+            continue;
+        }
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value) {
+            std::fprintf(stderr, "missing value for %s\n", arg);
+            return false;
+        }
+        if (std::strcmp(arg, "--min-size") == 0) options.minSize = std::max<size_t>(1, std::strtoull(value, nullptr, 10));
+        else if (std::strcmp(arg, "--max-size") == 0) options.maxSize = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(arg, "--max-adversarial") == 0) options.maxAdversarial = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(arg, "--types") == 0) options.types = QString::fromLocal8Bit(value).toLower().split(',');
+        else if (std::strcmp(arg, "--distributions") == 0) options.distributions = QString::fromLocal8Bit(value).toLower().split(',');
+        else if (std::strcmp(arg, "--seed") == 0) options.seed = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(arg, "--out") == 0) options.out = QString::fromLocal8Bit(value);
+        else {
+            std::fprintf(stderr, "unknown option %s\n", arg);
+            return false;
+        }
+        ++i;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) return 2;
+    if (options.selfTest) return runSelfTest();
+
+    QJsonArray results;
+    if (options.types.contains("string")) runType<QString>(HashMap::STRING, options, results);
+    if (options.types.contains("integer")) runType<int>(HashMap::INTEGER, options, results);
+    if (options.types.contains("double")) runType<double>(HashMap::DOUBLE, options, results);
+    if (options.types.contains("float")) runType<float>(HashMap::FLOAT, options, results);
+    if (options.types.contains("char")) runType<QChar>(HashMap::CHAR, options, results);
+
+    QJsonObject root;
+    root["benchmark"] = QStringLiteral("advds_bench_hashmap");
+    root["seed"] = static_cast<double>(options.seed);
+    root["sample_every"] = static_cast<double>(kSampleEvery);
+    root["results"] = results;
+    const QByteArray json = QJsonDocument(root).toJson();
+
+    if (options.out.isEmpty()) {
+        std::fwrite(json.constData(), 1, static_cast<size_t>(json.size()), stdout);
+    } else {
+        QFile file(options.out);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size()) {
+            std::fprintf(stderr, "cannot write %s\n", qPrintable(options.out));
+            return 1;
+        }
+    }
+    std::fprintf(stderr, "checksum %llu\n", static_cast<unsigned long long>(sink));
+    return 0;
+}
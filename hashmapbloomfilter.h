@@ -0,0 +1,112 @@
+#pragma once
+
+#include <QtGlobal>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// Optional blocked Bloom filter in front of a HashMap's buckets, so most
+// lookups of absent keys end after one cache line instead of a bucket walk.
+// It works on the full key hashes the core already computes: each hash
+// picks one 64-byte block and sets hashCount() bits inside it.
+//
+// Bloom filters can't forget, so erases are only counted. Once the stale
+// keys or the keys added since the last build pass what the filter was
+// sized for, needsRebuild() asks the engine to rebuild it from the live
+// entries; the engine also rebuilds it whenever the table is rehashed.
+class HashMapBloomFilter {
+public:
+    static constexpr int kBlockBits = 512;  // one cache line
+    static constexpr int kMinKeys = 64;
+    static constexpr float kDefaultFalsePositiveRate = 0.01f;
+
+    explicit HashMapBloomFilter(float falsePositiveRate = kDefaultFalsePositiveRate) {
+        setFalsePositiveRate(falsePositiveRate);
+        reset(0);
+    }
+
+    // Takes effect at the next reset().
+    void setFalsePositiveRate(float rate) {
+        rate_ = std::min(0.5f, std::max(1e-6f, rate));
+        // -ln p / ln^2 2 bits per key; blocking costs a little accuracy, so
+        // round up and add one
+        const double ln2 = std::log(2.0);
+        bitsPerKey_ = std::ceil(-std::log(static_cast<double>(rate_)) / (ln2 * ln2)) + 1.0;
+        hashCount_ = std::max(1, std::min(16, static_cast<int>(std::lround((bitsPerKey_ - 1.0) * ln2))));
+    }
+    float falsePositiveRate() const { return rate_; }
+
+    // Empties the filter and sizes it for about twice expectedKeys, so a
+    // table can grow a while before the filter must be rebuilt.
+    void reset(int expectedKeys) {
+        capacity_ = std::max(kMinKeys, expectedKeys * 2);
+        const double bits = static_cast<double>(capacity_) * bitsPerKey_;
+        blocks_.assign(static_cast<size_t>(std::ceil(bits / kBlockBits)), Block{});
+        added_ = 0;
+        stale_ = 0;
+    }
+
+    void add(size_t hash) {
+        Block &block = blocks_[blockIndex(hash)];
+        forEachBit(hash, [&block](int bit) { block.words[bit >> 6] |= quint64(1) << (bit & 63); });
+        ++added_;
+    }
+
+    // False means the key is certainly absent.
+    bool mayContain(size_t hash) const {
+        const Block &block = blocks_[blockIndex(hash)];
+        bool all = true;
+        forEachBit(hash, [&](int bit) { all &= (block.words[bit >> 6] >> (bit & 63)) & 1; });
+        return all;
+    }
+
+    void noteErase() { ++stale_; }
+
+    // Erased keys still pass, and lookups of recently erased keys are
+    // common, so stale bits get a quarter of the budget: a rebuild costs
+    // about two re-adds per erase.
+    bool needsRebuild() const { return added_ > capacity_ || stale_ > capacity_ / 4; }
+
+    int hashCount() const { return hashCount_; }
+    size_t bytes() const { return blocks_.size() * sizeof(Block); }
+
+private:
+    struct alignas(64) Block {
+        quint64 words[kBlockBits / 64];
+    };
+
+    std::vector<Block> blocks_;
+    float rate_ = kDefaultFalsePositiveRate;
+    double bitsPerKey_ = 0.0;
+    int hashCount_ = 1;
+    int capacity_ = 0;  // keys the current size was chosen for
+    int added_ = 0;     // since the last reset
+    int stale_ = 0;     // erased since the last reset
+
+    // The key hash may be weak (numbers hash to themselves), so mix it
+    // before it chooses anything.
+    static quint64 mix(size_t hash) {
+        quint64 h = static_cast<quint64>(hash);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // High half of the mix, scaled onto the block count.
+    size_t blockIndex(size_t hash) const {
+        return static_cast<size_t>(((mix(hash) >> 32) * blocks_.size()) >> 32);
+    }
+
+    // Double hashing inside the block with the low half of the mix.
+    template<typename F>
+    void forEachBit(size_t hash, F &&f) const {
+        const quint32 low = static_cast<quint32>(mix(hash));
+        const quint32 step = (low >> 16) | 1;
+        quint32 bit = low;
+        for (int i = 0; i < hashCount_; ++i, bit += step) f(static_cast<int>(bit % kBlockBits));
+    }
+};
@@ -0,0 +1,299 @@
+// advds_bench_concurrent_hashmap - thread-scaling benchmark for
+// ConcurrentHashMap.
+//
+// For 1, 2, 4, ... up to --max-threads threads it runs the same total
+// number of mixed operations (gets, puts and erases over a shared key range)
+// against a ConcurrentHashMap and, as the baseline, against one HashMap
+// behind a single mutex. Prints throughput per thread count as JSON.
+//
+//   advds_bench_concurrent_hashmap [--max-threads N] [--shards N] [--keys N]
+//                                  [--ops N] [--read-percent N] [--seed N]
+//                                  [--out results.json]
+//   advds_bench_concurrent_hashmap --self-test
+//
+// --self-test instead runs a consistency check on every backend: writer
+// threads put, erase and re-put disjoint key ranges while reader threads
+// look up all of them, then the final contents are compared with what the
+// writers must have left. Exits nonzero on the first mismatch.
+
+#include "concurrenthashmap.h"
+#include "hashmap.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+#include <QVariant>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    int shards = 64;
+    int keys = 1 << 20;
+    size_t ops = 4000000;
+    int readPercent = 90;  // the rest is split 2:1 between put and erase
+    uint64_t seed = 42;
+    QString out;
+    bool selfTest = false;
+};
+
+std::atomic<uint64_t> sink{0}; // keeps results observable
+
+// Runs options.ops operations split over `threads` threads against
+// map.get/put/erase; returns the wall time in seconds.
+template<typename Map>
+double runThreads(Map &map, int threads, const Options &options) {
+    std::atomic<int> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    const size_t perThread = options.ops / static_cast<size_t>(threads);
+
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            std::mt19937_64 rng(options.seed + static_cast<uint64_t>(t) * 7919);
+            std::uniform_int_distribution<int> keyDist(0, options.keys - 1);
+            std::uniform_int_distribution<int> opDist(0, 299);
+            uint64_t found = 0;
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+            for (size_t i = 0; i < perThread; ++i) {
+                const QVariant key(keyDist(rng));
+                const int op = opDist(rng);
+                if (op < options.readPercent * 3) {
+                    found += map.get(key).has_value();
+                } else if (op % 3 != 0) {
+                    map.put(key, key);
+                } else {
+                    found += map.erase(key);
+                }
+            }
+            sink.fetch_add(found, std::memory_order_relaxed);
+        });
+    }
+    while (ready.load() < threads) std::this_thread::yield();
+    const auto start = Clock::now();
+    go.store(true, std::memory_order_release);
+    for (std::thread &worker : workers) worker.join();
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Baseline: the single-threaded HashMap behind one lock.
+class GlobalLockHashMap {
+public:
+    GlobalLockHashMap() : map_(16, 0.75f, HashMap::CHAINING) {
+        map_.setKeyType(HashMap::INTEGER);
+        map_.setValueType(HashMap::INTEGER);
+        map_.setTraceLevel(HashMapTrace::OFF);
+    }
+    std::optional<QVariant> get(const QVariant &key) {
+        std::lock_guard<std::mutex> guard(lock_);
+        return map_.get(key);
+    }
+    void put(const QVariant &key, const QVariant &value) {
+        std::lock_guard<std::mutex> guard(lock_);
+        map_.put(key, value);
+    }
+    bool erase(const QVariant &key) {
+        std::lock_guard<std::mutex> guard(lock_);
+        return map_.erase(key);
+    }
+
+private:
+    std::mutex lock_;
+    HashMap map_;
+};
+
+template<typename Map>
+void prefill(Map &map, const Options &options) {
+    for (int key = 0; key < options.keys; key += 2) map.put(key, key);
+}
+
+QJsonObject measure(const char *impl, int threads, double seconds, const Options &options) {
+    QJsonObject run;
+    run["impl"] = QString::fromLatin1(impl);
+    run["threads"] = threads;
+    run["ops"] = static_cast<double>(options.ops / static_cast<size_t>(threads) * static_cast<size_t>(threads));
+    run["seconds"] = seconds;
+    run["mops_per_sec"] = seconds > 0.0 ? run["ops"].toDouble() / seconds / 1e6 : 0.0;
+    std::fprintf(stderr, "%-22s threads=%-3d %.2f Mops/s\n", impl, threads, run["mops_per_sec"].toDouble());
+    return run;
+}
+
+// ---------------------------------------------------------------------------
+// --self-test
+
+// Writer t owns the keys k with k % writers == t. It puts every key with
+// value 2k, erases the multiples of 3, then puts the multiples of 5 again
+// with value 2k + 1, so afterwards key k is present iff k % 3 != 0 or
+// k % 5 == 0, and holds 2k + 1 iff k % 5 == 0.
+bool expectedPresent(int key) { return key % 3 != 0 || key % 5 == 0; }
+int expectedValue(int key) { return key % 5 == 0 ? 2 * key + 1 : 2 * key; }
+
+bool selfTestBackend(HashMap::Backend backend, const char *name) {
+    constexpr int kKeys = 60000;
+    constexpr int kWriters = 4;
+    constexpr int kReaders = 4;
+    // Few, small shards so every shard grows several times under load.
+    ConcurrentHashMap map(HashMap::INTEGER, HashMap::INTEGER, 8, 4, 0.75f, backend);
+
+    std::atomic<int> failures{0};
+    std::atomic<int> writersLeft{kWriters};
+    auto fail = [&](const char *what, int key) {
+        if (failures.fetch_add(1) < 10) std::fprintf(stderr, "self-test %s: %s (key %d)\n", name, what, key);
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kWriters; ++t) {
+        threads.emplace_back([&, t] {
+            for (int key = t; key < kKeys; key += kWriters) {
+                if (!map.insert(key, 2 * key)) fail("insert of a new key returned false", key);
+                if (map.insert(key, -1)) fail("insert of an existing key returned true", key);
+            }
+            for (int key = t; key < kKeys; key += kWriters) {
+                if (key % 3 == 0 && !map.erase(key)) fail("erase of a present key returned false", key);
+            }
+            for (int key = t; key < kKeys; key += kWriters) {
+                if (key % 5 == 0) map.put(key, 2 * key + 1);
+            }
+            // Only this thread writes these keys, so it must see its own writes.
+            for (int key = t; key < kKeys; key += kWriters) {
+                const std::optional<QVariant> value = map.get(key);
+                if (value.has_value() != expectedPresent(key)) fail("writer sees wrong presence", key);
+                else if (value && value->toInt() != expectedValue(key)) fail("writer sees wrong value", key);
+            }
+            writersLeft.fetch_sub(1);
+        });
+    }
+    for (int t = 0; t < kReaders; ++t) {
+        threads.emplace_back([&, t] {
+            std::mt19937_64 rng(static_cast<uint64_t>(t) + 1);
+            std::uniform_int_distribution<int> keyDist(0, kKeys - 1);
+            while (writersLeft.load() > 0) {
+                const int key = keyDist(rng);
+                // A concurrent reader may see any of the values a key ever held.
+                const std::optional<QVariant> value = map.get(key);
+                if (value && value->toInt() != 2 * key && value->toInt() != 2 * key + 1)
+                    fail("reader sees a value never stored", key);
+                // Keys that are never erased stay once they are seen.
+                if (value && key % 3 != 0 && !map.contains(key)) fail("a key that is never erased vanished", key);
+            }
+        });
+    }
+    for (std::thread &thread : threads) thread.join();
+
+    int expectedSize = 0;
+    for (int key = 0; key < kKeys; ++key) {
+        expectedSize += expectedPresent(key);
+        const std::optional<QVariant> value = map.get(key);
+        if (value.has_value() != expectedPresent(key)) fail("wrong presence after join", key);
+        else if (value && value->toInt() != expectedValue(key)) fail("wrong value after join", key);
+    }
+    if (map.size() != expectedSize) fail("size() disagrees with the contents", map.size());
+    const QVector<int> shardSizes = map.shardSizes();
+    if (std::accumulate(shardSizes.begin(), shardSizes.end(), 0) != expectedSize)
+        fail("shard sizes don't add up", expectedSize);
+
+    std::fprintf(stderr, "self-test %-8s %s\n", name, failures.load() ? "FAILED" : "ok");
+    return failures.load() == 0;
+}
+
+int runSelfTest() {
+    bool ok = true;
+    ok &= selfTestBackend(HashMap::CHAINING, "chaining");
+    ok &= selfTestBackend(HashMap::SWISS_TABLE, "swiss");
+    ok &= selfTestBackend(HashMap::CUCKOO, "cuckoo");
+    ok &= selfTestBackend(HashMap::COMPACT, "compact");
+    return ok ? 0 : 1;
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (std::strcmp(arg, "--self-test") == 0) {
+            options.selfTest = true;
+            continue;
+        }
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value) {
+            std::fprintf(stderr, "missing value for %s\n", arg);
+            return false;
+        }
+        if (std::strcmp(arg, "--max-threads") == 0) options.maxThreads = std::max(1, std::atoi(value));
+        else if (std::strcmp(arg, "--shards") == 0) options.shards = std::max(1, std::atoi(value));
+        else if (std::strcmp(arg, "--keys") == 0) options.keys = std::max(1, std::atoi(value));
+        else if (std::strcmp(arg, "--ops") == 0) options.ops = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(arg, "--read-percent") == 0) options.readPercent = std::min(100, std::max(0, std::atoi(value)));
+        else if (std::strcmp(arg, "--seed") == 0) options.seed = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(arg, "--out") == 0) options.out = QString::fromLocal8Bit(value);
+        else {
+            std::fprintf(stderr, "unknown option %s\n", arg);
+            return false;
+        }
+        ++i;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) return 2;
+    if (options.selfTest) return runSelfTest();
+
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < options.maxThreads; threads *= 2) threadCounts.push_back(threads);
+    threadCounts.push_back(options.maxThreads);
+
+    QJsonArray results;
+    for (int threads : threadCounts) {
+        {
+            ConcurrentHashMap map(HashMap::INTEGER, HashMap::INTEGER, options.shards);
+            prefill(map, options);
+            results.append(measure("ConcurrentHashMap", threads, runThreads(map, threads, options), options));
+        }
+        {
+            GlobalLockHashMap map;
+            prefill(map, options);
+            results.append(measure("HashMap+mutex", threads, runThreads(map, threads, options), options));
+        }
+    }
+
+    QJsonObject root;
+    root["benchmark"] = QStringLiteral("advds_bench_concurrent_hashmap");
+    root["seed"] = static_cast<double>(options.seed);
+    root["shards"] = options.shards;
+    root["keys"] = options.keys;
+    root["read_percent"] = options.readPercent;
+    root["hardware_threads"] = static_cast<int>(std::thread::hardware_concurrency());
+    root["results"] = results;
+    const QByteArray json = QJsonDocument(root).toJson();
+
+    if (options.out.isEmpty()) {
+        std::fwrite(json.constData(), 1, static_cast<size_t>(json.size()), stdout);
+    } else {
+        QFile file(options.out);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size()) {
+            std::fprintf(stderr, "cannot write %s\n", qPrintable(options.out));
+            return 1;
+        }
+    }
+    std::fprintf(stderr, "checksum %llu\n", static_cast<unsigned long long>(sink.load()));
+    return 0;
+}
@@ -0,0 +1,519 @@
+#pragma once
+
+#include "hashmaphash.h"
+#include "hashmapnodepool.h"
+#include "redblacktreeops.h"
+
+#include <QString>
+#include <QChar>
+#include <algorithm>
+#include <cstddef>
+#include <forward_list>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+// Cache prefetch hint used by the batch operations; a no-op where the
+// compiler offers no intrinsic.
+inline void hashMapPrefetch(const void *address) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#else
+    (void)address;
+#endif
+}
+
+// Typed separate-chaining hash table. Keys and values are stored natively,
+// so lookups never box, convert or dispatch on a runtime type.
+//
+// The chain-walking methods take a visitor called as visit(node, matched)
+// for every node compared, which is how HashMap produces its step trace.
+// SwissHashMapCore (swisshashmapcore.h) implements the same interface.
+//
+// Growth can be incremental (Redis style): startIncrementalRehash() keeps
+// the old bucket array next to the new one and rehashStep() migrates a few
+// old buckets at a time. Until the migration finishes, lookups and erases
+// check the key's old bucket as well as its new one; inserts go to the new
+// table. bucketCount() and the bucket accessors always describe the new
+// table.
+//
+// Chain nodes come from a per-map HashMapNodePool, so inserts, erases and
+// rehashes reuse pooled blocks instead of calling malloc/free per node, and
+// clear() returns the slabs in bulk.
+//
+// Under heavy collisions a bucket is treeified (Java 8 style): an insert
+// that would make its chain longer than kTreeifyThreshold moves the bucket
+// into a red-black tree ordered by (hash, key), and an erase that shrinks
+// the tree to kUntreeifyThreshold entries turns it back into a chain.
+// Lookups in a tree bucket visit only the nodes on the search path.
+template<typename K, typename V,
+         typename Hash = HashMapHash<K>,
+         typename Eq = std::equal_to<>,
+         typename Less = std::less<>>
+class HashMapCore {
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using hasher = Hash;
+
+    // The full hash is cached so rehash never recomputes it and chain walks
+    // skip the key compare for nodes whose hash differs.
+    struct Node {
+        K key;
+        V value;
+        size_t hash;
+    };
+    using Chain = std::forward_list<Node, HashMapNodeAllocator<Node>>;
+
+    static constexpr int kTreeifyThreshold = 8;
+    static constexpr int kUntreeifyThreshold = 6;
+    // One bucket per key (see CuckooHashMapCore).
+    static constexpr bool kCuckoo = false;
+    // Entries hang off their buckets (see CompactHashMapCore).
+    static constexpr bool kDenseEntries = false;
+    // The bucket is hash % bucketCount, nothing mixed in between.
+    static constexpr bool kPlainModulo = true;
+
+    explicit HashMapCore(int initialBucketCount = 16, float maxLoadFactor = 0.75f,
+                         const Hash &hash = Hash(), const Eq &eq = Eq())
+        : buckets_(static_cast<size_t>(std::max(1, initialBucketCount)), emptyChain()),
+        maxLoadFactor_(maxLoadFactor),
+        hash_(hash),
+        eq_(eq) {}
+
+    ~HashMapCore() { destroyTrees(); }
+
+    // Chains point at pool_, so the core can't be copied.
+    HashMapCore(const HashMapCore &) = delete;
+    HashMapCore &operator=(const HashMapCore &) = delete;
+
+    int size() const { return numElements_; }
+    int bucketCount() const { return static_cast<int>(buckets_.size()); }
+    float maxLoadFactor() const { return maxLoadFactor_; }
+    void setMaxLoadFactor(float maxLoadFactor) { maxLoadFactor_ = maxLoadFactor; }
+
+    float loadFactor() const {
+        if (buckets_.empty()) return 0.0f;
+        return static_cast<float>(numElements_) / static_cast<float>(buckets_.size());
+    }
+
+    // Lookups take K or any type Hash, Eq and Less accept alongside it
+    // (QStringView for QString keys).
+    template<typename Q>
+    size_t hashOf(const Q &key) const { return hash_(key); }
+    const Hash &hashFunction() const { return hash_; }
+
+    // bucket_index = hash(key) % bucketCount
+    int bucketForHash(size_t hash, int bucketCount) const {
+        return static_cast<int>(hash % static_cast<size_t>(bucketCount));
+    }
+    int bucketForHash(size_t hash) const { return bucketForHash(hash, bucketCount()); }
+    int bucketFor(const K &key, int bucketCount) const { return bucketForHash(hash_(key), bucketCount); }
+    int bucketFor(const K &key) const { return bucketFor(key, bucketCount()); }
+    // Bucket a live node is reported under (pending nodes included).
+    int bucketOf(const Node &node) const { return bucketForHash(node.hash); }
+
+    // True when one more element would push the load factor past the limit.
+    bool needsGrow() const {
+        const float projected = (static_cast<float>(numElements_) + 1.0f)
+        / static_cast<float>(buckets_.empty() ? 1 : buckets_.size());
+        return projected > maxLoadFactor_;
+    }
+
+    int grownBucketCount() const { return std::max(2, bucketCount() * 2); }
+
+    // Key compares a successful lookup makes under a uniform hash: half the
+    // chain ahead of it, plus itself (Knuth).
+    double expectedHitCompares() const { return 1.0 + loadFactor() / 2.0; }
+
+    // Bucket count that holds expectedElements at the given load factor.
+    int bucketCountFor(int expectedElements, float load) const {
+        return std::max(1, static_cast<int>(expectedElements / load));
+    }
+
+    template<typename Q, typename Visit>
+    Node *find(const Q &key, size_t hash, Visit &&visit) {
+        if (isRehashing()) {
+            if (Node *node = findInChain(oldBuckets_[oldBucketForHash(hash)], key, hash, visit)) return node;
+        }
+        const int index = bucketForHash(hash);
+        if (Tree *tree = treeAt(index)) {
+            TreeNode *t = findInTree(*tree, key, hash, visit);
+            return t ? &t->node : nullptr;
+        }
+        return findInChain(buckets_[static_cast<size_t>(index)], key, hash, visit);
+    }
+
+    Node *find(const K &key) {
+        return find(key, hash_(key), [](const Node &, bool) {});
+    }
+
+    // Pulls in the bucket heads a later find/insert/erase of hash will read.
+    void prefetch(size_t hash) const {
+        hashMapPrefetch(&buckets_[static_cast<size_t>(bucketForHash(hash))]);
+        if (isRehashing()) hashMapPrefetch(&oldBuckets_[oldBucketForHash(hash)]);
+    }
+
+    // Links a new node at the head of its bucket, or into its tree. The key
+    // must be absent.
+    Node &insertUnique(size_t hash, K key, V value) {
+        const int index = bucketForHash(hash);
+        ++numElements_;
+        if (Tree *tree = treeAt(index)) return insertIntoTree(*tree, Node{std::move(key), std::move(value), hash});
+        auto &chain = buckets_[static_cast<size_t>(index)];
+        if (chainReaches(chain, kTreeifyThreshold)) {
+            return insertIntoTree(treeify(index), Node{std::move(key), std::move(value), hash});
+        }
+        chain.push_front(Node{std::move(key), std::move(value), hash});
+        return chain.front();
+    }
+
+    template<typename Q, typename Visit>
+    bool erase(const Q &key, size_t hash, Visit &&visit) {
+        if (isRehashing() && eraseFromChain(oldBuckets_[oldBucketForHash(hash)], key, hash, visit)) return true;
+        const int index = bucketForHash(hash);
+        if (Tree *tree = treeAt(index)) {
+            TreeNode *t = findInTree(*tree, key, hash, visit);
+            if (!t) return false;
+            rbtree::erase(tree->root, t);
+            delete t;
+            --tree->size;
+            --treeEntries_;
+            --numElements_;
+            if (tree->size <= kUntreeifyThreshold) untreeify(index);
+            return true;
+        }
+        return eraseFromChain(buckets_[static_cast<size_t>(index)], key, hash, visit);
+    }
+
+    // Redistributes every node at once, finishing any incremental rehash
+    // in progress; onMove(node, newIndex) runs once per node. If any bucket
+    // was a tree, chains still too long afterwards are treeified again.
+    template<typename OnMove>
+    void rehash(int newBucketCount, OnMove &&onMove) {
+        if (newBucketCount < 1) newBucketCount = 1;
+        const bool hadTrees = treeBuckets_ > 0;
+        untreeifyAll();
+        std::vector<Chain> newBuckets(static_cast<size_t>(newBucketCount), emptyChain());
+        for (auto &chain : oldBuckets_) moveChain(chain, newBuckets, onMove);
+        for (auto &chain : buckets_) moveChain(chain, newBuckets, onMove);
+        buckets_.swap(newBuckets);
+        finishRehash();
+        if (hadTrees) treeifyLongChains();
+    }
+
+    void rehash(int newBucketCount) {
+        rehash(newBucketCount, [](const Node &, int) {});
+    }
+
+    static constexpr bool kIncrementalRehash = true;
+
+    // Switches inserts to a new bucket array without moving anything yet.
+    // A migration still in progress is completed first, and trees become
+    // chains again so the old table is chains only.
+    template<typename OnMove>
+    void startIncrementalRehash(int newBucketCount, OnMove &&onMove) {
+        if (newBucketCount < 1) newBucketCount = 1;
+        if (isRehashing()) rehashStep(static_cast<int>(oldBuckets_.size()), onMove);
+        untreeifyAll();
+        oldBuckets_.swap(buckets_);
+        buckets_.assign(static_cast<size_t>(newBucketCount), emptyChain());
+        migratedBuckets_ = 0;
+    }
+
+    // Migrates up to maxBuckets old buckets. Empty buckets count a tenth
+    // as much, so a sparse table doesn't take forever to drain.
+    // Returns true while a migration is still in progress.
+    template<typename OnMove>
+    bool rehashStep(int maxBuckets, OnMove &&onMove) {
+        if (!isRehashing()) return false;
+        long long emptyVisits = static_cast<long long>(maxBuckets) * 10;
+        const int oldCount = static_cast<int>(oldBuckets_.size());
+        while (maxBuckets > 0 && migratedBuckets_ < oldCount) {
+            auto &chain = oldBuckets_[static_cast<size_t>(migratedBuckets_)];
+            if (chain.empty()) {
+                ++migratedBuckets_;
+                if (--emptyVisits == 0) break;
+                continue;
+            }
+            moveChain(chain, buckets_, onMove);
+            ++migratedBuckets_;
+            --maxBuckets;
+        }
+        if (migratedBuckets_ < oldCount) return true;
+        finishRehash();
+        return false;
+    }
+
+    bool isRehashing() const { return !oldBuckets_.empty(); }
+    // Old bucket count and how many of those buckets have been migrated.
+    int rehashSourceBuckets() const { return static_cast<int>(oldBuckets_.size()); }
+    int rehashedBuckets() const { return migratedBuckets_; }
+
+    void clear() {
+        destroyTrees();
+        for (auto &chain : buckets_) {
+            chain.clear();
+        }
+        finishRehash();
+        numElements_ = 0;
+        pool_.release();
+    }
+
+    // Node allocator usage. Tree nodes are allocated one by one and count
+    // as both reserved and live.
+    size_t nodeBytesReserved() const { return pool_.bytesReserved() + treeBytes(); }
+    size_t nodeBytesLive() const { return pool_.bytesLive() + treeBytes(); }
+    int nodeSlabs() const { return pool_.slabCount(); }
+
+    bool isTreeBucket(int index) const {
+        return treeBuckets_ > 0 && trees_[static_cast<size_t>(index)].root != nullptr;
+    }
+    int treeBucketCount() const { return treeBuckets_; }
+
+    int bucketSize(int index) const {
+        int count = 0;
+        forEachInBucket(index, [&count](const Node &) { ++count; });
+        return count;
+    }
+
+    // While rehashing, nodes still waiting in the old table are reported
+    // under the new bucket they will move to.
+    template<typename F>
+    void forEachInBucket(int index, F &&f) const {
+        if (isTreeBucket(index)) {
+            forEachInTree(trees_[static_cast<size_t>(index)].root, f);
+        } else {
+            for (const auto &node : buckets_[static_cast<size_t>(index)]) f(node);
+        }
+        if (!isRehashing()) return;
+
+        const int oldCount = static_cast<int>(oldBuckets_.size());
+        if (bucketCount() % oldCount == 0) {
+            // Growing by a whole factor, only one old bucket feeds this one
+            forEachPending(index % oldCount, index, f);
+        } else {
+            for (int j = migratedBuckets_; j < oldCount; ++j) forEachPending(j, index, f);
+        }
+    }
+
+    template<typename F>
+    void forEach(F &&f) const {
+        for (const auto &chain : oldBuckets_) {
+            for (const auto &node : chain) f(node);
+        }
+        for (const auto &chain : buckets_) {
+            for (const auto &node : chain) f(node);
+        }
+        if (treeBuckets_ == 0) return;
+        for (const Tree &tree : trees_) forEachInTree(tree.root, f);
+    }
+
+private:
+    // A treeified bucket's node. Allocated one at a time: trees are rare and
+    // their nodes don't match the pool's block size.
+    struct TreeNode {
+        Node node;
+        TreeNode *left = nullptr;
+        TreeNode *right = nullptr;
+        TreeNode *parent = nullptr;
+        rbtree::Color color = rbtree::RED;
+    };
+
+    struct Tree {
+        TreeNode *root = nullptr;
+        int size = 0;
+    };
+
+    HashMapNodePool pool_;  // declared first: outlives every chain
+    std::vector<Chain> buckets_;
+    std::vector<Chain> oldBuckets_;  // non-empty only during an incremental rehash
+    int migratedBuckets_ = 0;        // old buckets below this index are empty
+    int numElements_ = 0;
+    float maxLoadFactor_ = 0.75f;
+    Hash hash_;
+    Eq eq_;
+    Less less_;
+    // Per bucket of buckets_ once any bucket is a tree, empty otherwise; a
+    // bucket is a tree while its root is set (its chain is then empty).
+    std::vector<Tree> trees_;
+    int treeBuckets_ = 0;
+    int treeEntries_ = 0;
+
+    Chain emptyChain() { return Chain(HashMapNodeAllocator<Node>(&pool_)); }
+
+    size_t oldBucketForHash(size_t hash) const { return hash % oldBuckets_.size(); }
+
+    template<typename Q, typename Visit>
+    Node *findInChain(Chain &chain, const Q &key, size_t hash, Visit &visit) {
+        for (auto &node : chain) {
+            const bool matched = node.hash == hash && eq_(node.key, key);
+            visit(static_cast<const Node &>(node), matched);
+            if (matched) return &node;
+        }
+        return nullptr;
+    }
+
+    template<typename Q, typename Visit>
+    bool eraseFromChain(Chain &chain, const Q &key, size_t hash, Visit &visit) {
+        auto before = chain.before_begin();
+        for (auto it = chain.begin(); it != chain.end(); ++it, ++before) {
+            const bool matched = it->hash == hash && eq_(it->key, key);
+            visit(static_cast<const Node &>(*it), matched);
+            if (matched) {
+                chain.erase_after(before);
+                --numElements_;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Nodes of unmigrated old bucket j that belong in new bucket index.
+    template<typename F>
+    void forEachPending(int j, int index, F &f) const {
+        if (j < migratedBuckets_) return;
+        for (const auto &node : oldBuckets_[static_cast<size_t>(j)]) {
+            if (bucketForHash(node.hash) == index) f(node);
+        }
+    }
+
+    // Splices every node of chain into its bucket in target. Only the live
+    // table can hold trees (while an incremental migration feeds it).
+    template<typename OnMove>
+    void moveChain(Chain &chain, std::vector<Chain> &target, OnMove &onMove) {
+        const int targetCount = static_cast<int>(target.size());
+        const bool live = &target == &buckets_;
+        while (!chain.empty()) {
+            const int newIndex = bucketForHash(chain.front().hash, targetCount);
+            onMove(static_cast<const Node &>(chain.front()), newIndex);
+            if (live && isTreeBucket(newIndex)) {
+                insertIntoTree(trees_[static_cast<size_t>(newIndex)], std::move(chain.front()));
+                chain.pop_front();
+                continue;
+            }
+            auto &dest = target[static_cast<size_t>(newIndex)];
+            dest.splice_after(dest.before_begin(), chain, chain.before_begin());
+        }
+    }
+
+    void finishRehash() {
+        std::vector<Chain>().swap(oldBuckets_);
+        migratedBuckets_ = 0;
+    }
+
+    Tree *treeAt(int index) {
+        if (treeBuckets_ == 0) return nullptr;
+        Tree &tree = trees_[static_cast<size_t>(index)];
+        return tree.root ? &tree : nullptr;
+    }
+
+    size_t treeBytes() const { return static_cast<size_t>(treeEntries_) * sizeof(TreeNode); }
+
+    // True when chain has at least length nodes; walks no further.
+    static bool chainReaches(const Chain &chain, int length) {
+        for (auto it = chain.begin(); it != chain.end(); ++it) {
+            if (--length == 0) return true;
+        }
+        return length <= 0;
+    }
+
+    // Tree order: by hash, then by key.
+    template<typename Q>
+    int compare(const Q &key, size_t hash, const Node &node) const {
+        if (hash != node.hash) return hash < node.hash ? -1 : 1;
+        if (less_(key, node.key)) return -1;
+        if (less_(node.key, key)) return 1;
+        return 0;
+    }
+
+    // Keys that compare equal without being equal (NaN) go right, so the
+    // search continues there and never matches, as in a chain.
+    template<typename Q, typename Visit>
+    TreeNode *findInTree(Tree &tree, const Q &key, size_t hash, Visit &visit) {
+        TreeNode *t = tree.root;
+        while (t) {
+            const int order = compare(key, hash, t->node);
+            const bool matched = order == 0 && eq_(t->node.key, key);
+            visit(static_cast<const Node &>(t->node), matched);
+            if (matched) return t;
+            t = order < 0 ? t->left : t->right;
+        }
+        return nullptr;
+    }
+
+    Node &insertIntoTree(Tree &tree, Node &&node) {
+        TreeNode *parent = nullptr;
+        TreeNode **link = &tree.root;
+        while (*link) {
+            parent = *link;
+            link = compare(node.key, node.hash, parent->node) < 0 ? &parent->left : &parent->right;
+        }
+        TreeNode *t = new TreeNode{std::move(node)};
+        t->parent = parent;
+        *link = t;
+        rbtree::insertFixup(tree.root, t);
+        ++tree.size;
+        ++treeEntries_;
+        return t->node;
+    }
+
+    // Moves bucket index's chain into a new tree and returns it.
+    Tree &treeify(int index) {
+        if (trees_.empty()) trees_.resize(buckets_.size());
+        Tree &tree = trees_[static_cast<size_t>(index)];
+        Chain &chain = buckets_[static_cast<size_t>(index)];
+        ++treeBuckets_;
+        while (!chain.empty()) {
+            insertIntoTree(tree, std::move(chain.front()));
+            chain.pop_front();
+        }
+        return tree;
+    }
+
+    void untreeify(int index) {
+        Tree &tree = trees_[static_cast<size_t>(index)];
+        Chain &chain = buckets_[static_cast<size_t>(index)];
+        drainTree(tree.root, [&chain](Node &&node) { chain.push_front(std::move(node)); });
+        tree = Tree();
+        if (--treeBuckets_ == 0) std::vector<Tree>().swap(trees_);
+    }
+
+    void untreeifyAll() {
+        for (int i = 0; treeBuckets_ > 0 && i < static_cast<int>(trees_.size()); ++i) {
+            if (trees_[static_cast<size_t>(i)].root) untreeify(i);
+        }
+    }
+
+    void treeifyLongChains() {
+        for (int i = 0; i < bucketCount(); ++i) {
+            if (chainReaches(buckets_[static_cast<size_t>(i)], kTreeifyThreshold + 1)) treeify(i);
+        }
+    }
+
+    void destroyTrees() {
+        for (Tree &tree : trees_) drainTree(tree.root, [](Node &&) {});
+        std::vector<Tree>().swap(trees_);
+        treeBuckets_ = 0;
+    }
+
+    // Hands each node to take() and frees the tree.
+    template<typename Take>
+    void drainTree(TreeNode *t, Take &&take) {
+        if (!t) return;
+        drainTree(t->left, take);
+        drainTree(t->right, take);
+        take(std::move(t->node));
+        delete t;
+        --treeEntries_;
+    }
+
+    template<typename F>
+    static void forEachInTree(const TreeNode *t, F &f) {
+        if (!t) return;
+        forEachInTree(t->left, f);
+        f(static_cast<const Node &>(t->node));
+        forEachInTree(t->right, f);
+    }
+};
@@ -0,0 +1,1239 @@
+#pragma once
+
+#include "hashmap.h"
+#include "compacthashmapcore.h"
+#include "cuckoohashmapcore.h"
+#include "hashmapbloomfilter.h"
+#include "hashmapcore.h"
+#include "hashmapkeyview.h"
+#include "hashmaploadcontroller.h"
+#include "hashmapsnapshot.h"
+#include "swisshashmapcore.h"
+#include "hashmapstats.h"
+#include "hashmapstring.h"
+#include "hashmaptrace.h"
+#include "hashmapvalueindex.h"
+
+#include <QChar>
+#include <QPair>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+// QVariant <-> native conversions for the HashMap data types. Only the
+// QVariant facade uses these; the typed core never sees a QVariant.
+//
+// fromView turns a HashMapKeyView into a lookup key without allocating,
+// calling use() with either a native key or a view the core hashes and
+// compares like one (QStringView for HashMapString).
+template<typename T>
+struct HashMapTypeTraits;
+
+// STRING is stored as HashMapString; QString only exists at this boundary.
+template<>
+struct HashMapTypeTraits<HashMapString> {
+    static bool fromVariant(const QVariant &var, HashMapString &out) {
+        if (!var.canConvert<QString>()) return false;
+        out = HashMapString(var.toString());
+        return true;
+    }
+    static QVariant toVariant(const HashMapString &v) { return QVariant(v.toString()); }
+
+    // UTF-8 longer than this many UTF-16 units goes through a QString.
+    static constexpr int kUtf8Inline = 256;
+
+    template<typename Use>
+    static HashMapKeyView::Resolution fromView(const HashMapKeyView &view, Use &&use) {
+        if (view.kind() == HashMapKeyView::TEXT) {
+            use(view.text());
+            return HashMapKeyView::RESOLVED;
+        }
+        if (view.kind() != HashMapKeyView::UTF8) return HashMapKeyView::WRONG_KIND;
+        QChar buffer[kUtf8Inline];
+        const int length = hashMapUtf8ToUtf16(view.utf8(), buffer, kUtf8Inline);
+        if (length >= 0) {
+            use(QStringView(buffer, length));
+        } else {
+            const QString decoded = QString::fromUtf8(view.utf8().data(), static_cast<int>(view.utf8().size()));
+            use(QStringView(decoded));
+        }
+        return HashMapKeyView::RESOLVED;
+    }
+};
+
+template<>
+struct HashMapTypeTraits<int> {
+    static bool fromVariant(const QVariant &var, int &out) {
+        if (!var.canConvert<int>()) return false;
+        out = var.toInt();
+        return true;
+    }
+    static QVariant toVariant(int v) { return QVariant(v); }
+
+    template<typename Use>
+    static HashMapKeyView::Resolution fromView(const HashMapKeyView &view, Use &&use) {
+        if (view.isText()) return HashMapKeyView::WRONG_KIND;
+        int key = 0;
+        if (!view.toInt(key)) return HashMapKeyView::NOT_REPRESENTABLE;
+        use(key);
+        return HashMapKeyView::RESOLVED;
+    }
+};
+
+template<>
+struct HashMapTypeTraits<double> {
+    static bool fromVariant(const QVariant &var, double &out) {
+        if (!var.canConvert<double>()) return false;
+        out = var.toDouble();
+        return true;
+    }
+    static QVariant toVariant(double v) { return QVariant(v); }
+
+    template<typename Use>
+    static HashMapKeyView::Resolution fromView(const HashMapKeyView &view, Use &&use) {
+        if (view.isText()) return HashMapKeyView::WRONG_KIND;
+        double key = 0.0;
+        if (!view.toDouble(key)) return HashMapKeyView::NOT_REPRESENTABLE;
+        use(key);
+        return HashMapKeyView::RESOLVED;
+    }
+};
+
+template<>
+struct HashMapTypeTraits<float> {
+    static bool fromVariant(const QVariant &var, float &out) {
+        if (!var.canConvert<float>()) return false;
+        out = var.toFloat();
+        return true;
+    }
+    static QVariant toVariant(float v) { return QVariant(v); }
+
+    template<typename Use>
+    static HashMapKeyView::Resolution fromView(const HashMapKeyView &view, Use &&use) {
+        if (view.isText()) return HashMapKeyView::WRONG_KIND;
+        float key = 0.0f;
+        if (!view.toFloat(key)) return HashMapKeyView::NOT_REPRESENTABLE;
+        use(key);
+        return HashMapKeyView::RESOLVED;
+    }
+};
+
+template<>
+struct HashMapTypeTraits<QChar> {
+    static bool fromVariant(const QVariant &var, QChar &out) {
+        if (!var.canConvert<QChar>()) return false;
+        out = var.toChar();
+        return true;
+    }
+    static QVariant toVariant(QChar v) { return QVariant(v); }
+
+    // Only text of exactly one UTF-16 unit can equal a QChar key.
+    template<typename Use>
+    static HashMapKeyView::Resolution fromView(const HashMapKeyView &view, Use &&use) {
+        if (view.kind() == HashMapKeyView::TEXT) {
+            if (view.text().size() != 1) return HashMapKeyView::NOT_REPRESENTABLE;
+            use(view.text().at(0));
+            return HashMapKeyView::RESOLVED;
+        }
+        if (view.kind() != HashMapKeyView::UTF8) return HashMapKeyView::WRONG_KIND;
+        QChar buffer[2];
+        int length = hashMapUtf8ToUtf16(view.utf8(), buffer, 2);
+        if (length < 0 && view.utf8().size() <= 4) {
+            const QString decoded = QString::fromUtf8(view.utf8().data(), static_cast<int>(view.utf8().size()));
+            length = static_cast<int>(decoded.size());
+            if (length == 1) buffer[0] = decoded.at(0);
+        }
+        if (length != 1) return HashMapKeyView::NOT_REPRESENTABLE;
+        use(buffer[0]);
+        return HashMapKeyView::RESOLVED;
+    }
+};
+
+// Runtime-dispatch interface HashMap forwards to. One implementation is
+// instantiated per (key type, value type, backend), so the only
+// per-operation dispatch left is a single virtual call.
+class HashMapEngine {
+public:
+    virtual ~HashMapEngine() = default;
+
+    virtual bool emplaceOrAssign(const QVariant &key, const QVariant &value, bool assignIfExists) = 0;
+    virtual std::optional<QVariant> get(const QVariant &key) = 0;
+    virtual bool erase(const QVariant &key) = 0;
+    // Heterogeneous forms: the key is matched as it is (see hashmapkeyview.h).
+    virtual std::optional<QVariant> get(const HashMapKeyView &key) = 0;
+    virtual bool erase(const HashMapKeyView &key) = 0;
+    virtual std::optional<QVariant> findByValue(const QVariant &value) = 0;
+
+    // Batch forms: returns the number inserted / erased.
+    virtual int emplaceOrAssignBatch(const QVector<QVariant> &keys, const QVector<QVariant> &values,
+                                     bool assignIfExists) = 0;
+    virtual QVector<std::optional<QVariant>> getBatch(const QVector<QVariant> &keys) = 0;
+    virtual int eraseBatch(const QVector<QVariant> &keys) = 0;
+    virtual void maybeGrow() = 0;
+    virtual void clear() = 0;
+
+    virtual int size() const = 0;
+    virtual int bucketCount() const = 0;
+    virtual float loadFactor() const = 0;
+
+    virtual void rehash(int newBucketCount) = 0;
+    virtual void reserve(int expectedElements) = 0;
+    virtual void setIncrementalRehash(bool enabled) = 0;
+    // Erases shrink the table below minLoadFactor (0 = never), down to at
+    // most minBucketCount buckets.
+    virtual void setMinLoadFactor(float minLoadFactor, int minBucketCount) = 0;
+    virtual void shrinkToFit() = 0;
+    virtual void setValueIndexEnabled(bool enabled) = 0;
+    virtual void setBloomFilter(bool enabled, float falsePositiveRate) = 0;
+    // Lets the measured lookup cost move the maximum load factor within
+    // [minLoad, maxLoad]; disabling restores fixedLoad.
+    virtual void setAdaptiveLoadFactor(bool enabled, float minLoad, float maxLoad, float fixedLoad) = 0;
+    virtual HashMapStats stats() const = 0;
+    // Off, lookups write nothing to the stats (no lookup counters, no
+    // latency samples), so several readers may call get() and
+    // findByValue() at once under a shared lock.
+    virtual void setLookupStats(bool enabled) = 0;
+    // Resizes started so far; cheaper than stats() for a before/after check.
+    virtual int resizeCount() const = 0;
+
+    virtual int indexFor(const QVariant &key, int bucketCount) const = 0;
+    // Bucket of the live table the view hashes to; -1 when no key of the
+    // key type equals it.
+    virtual int indexFor(const HashMapKeyView &key) const = 0;
+    // Full hash of the key (0 if it isn't of the key type).
+    virtual size_t hashFor(const QVariant &key) const = 0;
+    virtual QVector<int> bucketSizes() const = 0;
+    // True for a chaining bucket that has been converted to a red-black tree.
+    virtual bool isTreeBucket(int bucket) const = 0;
+    virtual QVector<QVector<QPair<QVariant, QVariant>>> getBucketContents() const = 0;
+    // Visits buckets [first, last) in place, without building containers.
+    virtual void forEachInBuckets(int first, int last, const HashMap::BucketEntryVisitor &visitor) const = 0;
+    // Every entry, in the core's own order (insertion order for COMPACT).
+    virtual void forEachEntry(const HashMap::EntryVisitor &visitor) const = 0;
+
+    // Every change stamps the bucket it touched with a new epoch; resizes
+    // and clear() stamp all of them.
+    virtual quint64 modificationEpoch() const = 0;
+    virtual quint64 bucketVersion(int bucket) const = 0;
+    virtual QVector<int> bucketsChangedSince(quint64 epoch) const = 0;
+    // Continues numbering from epoch, with every bucket marked changed
+    // (used when HashMap swaps in a new engine).
+    virtual void restartVersionsAt(quint64 epoch) = 0;
+
+    // Snapshots. header carries the facade's settings; the engine fills in
+    // the rest. An attached snapshot is moved into the live table one
+    // snapshot bucket at a time, when an operation first touches it.
+    virtual bool writeSnapshot(const QString &path, HashMapSnapshotHeader header, QString *error) = 0;
+    virtual void attachSnapshot(std::shared_ptr<const HashMapSnapshot> snapshot) = 0;
+    virtual int pendingSnapshotEntries() const = 0;
+    // Moves every pending snapshot entry into the live table now; the
+    // const accessors only ever see the live table.
+    virtual void materializeSnapshot() = 0;
+};
+
+// Core is HashMapCore<K, V>, SwissHashMapCore<K, V>, CuckooHashMapCore<K, V>
+// or CompactHashMapCore<K, V>. Every trace call is
+// guarded by the trace level, so with tracing OFF no operand is boxed and
+// no string is built on the hot path.
+template<typename Core>
+class TypedHashMapEngine : public HashMapEngine {
+public:
+    using K = typename Core::key_type;
+    using V = typename Core::mapped_type;
+    using Node = typename Core::Node;
+
+    TypedHashMapEngine(int initialBucketCount, float maxLoadFactor, HashMapTrace &trace,
+                       HashMapHashing hashing = HashMapHashing())
+        : core_(initialBucketCount, maxLoadFactor, typename Core::hasher(hashing)),
+        trace_(trace) {
+        touchAllBuckets();
+    }
+
+    bool emplaceOrAssign(const QVariant &key, const QVariant &value, bool assignIfExists) override {
+        const HashMapStatsRecorder::LatencySample sample(stats_);
+        advanceRehash();
+        K nativeKey{};
+        V nativeValue{};
+        if (!KeyTraits::fromVariant(key, nativeKey) || !ValueTraits::fromVariant(value, nativeValue)) {
+            traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::TYPE_MISMATCH});
+            return false;
+        }
+
+        const size_t hash = core_.hashOf(nativeKey);
+        materializeFor(hash);
+        const int index = core_.bucketForHash(hash);
+        const qint32 keyOperand = traceLookupStart(nativeKey, index, false);
+
+        qint32 ordinal = 0;
+        Node *existing = core_.find(nativeKey, hash, [&](const Node &node, bool matched) {
+            traceCompare(node, keyOperand, ordinal++, matched);
+        });
+        stats_.recordLookup(existing != nullptr, ordinal);
+        if (existing) {
+            if (assignIfExists) {
+                if (trace_.wants(HashMapTrace::SUMMARY)) {
+                    const qint32 oldValue = trace_.addOperand(ValueTraits::toVariant(existing->value));
+                    const qint32 newValue = trace_.addOperand(ValueTraits::toVariant(nativeValue));
+                    trace_.record({HashMapTrace::UPDATE, 0, index, 0, oldValue, newValue});
+                }
+                assignValue(*existing, std::move(nativeValue));
+                touchBucket(core_.bucketOf(*existing));
+            } else {
+                traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::DUPLICATE, 0, index});
+            }
+            return false; // not a new insertion
+        }
+
+        traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::APPEND, 0, index});
+        if (valueIndex_) valueIndex_->add(nativeValue, nativeKey);
+        const bool wasTree = core_.isTreeBucket(index);
+        entryAdded(core_.bucketOf(insertNode(hash, std::move(nativeKey), std::move(nativeValue), true)));
+        if (!wasTree && core_.isTreeBucket(index)) {
+            traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::TREEIFY, 0, index, 0, core_.bucketSize(index)});
+        }
+        traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::SIZE, 0, index, 0, core_.size(), 0, core_.loadFactor()});
+        return true;
+    }
+
+    std::optional<QVariant> get(const QVariant &key) override {
+        const HashMapStatsRecorder::LatencySample sample(stats_);
+        advanceRehash();
+        K nativeKey{};
+        if (!KeyTraits::fromVariant(key, nativeKey)) {
+            traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::TYPE_MISMATCH});
+            return std::nullopt;
+        }
+        return getKey(nativeKey);
+    }
+
+    std::optional<QVariant> get(const HashMapKeyView &key) override {
+        const HashMapStatsRecorder::LatencySample sample(stats_);
+        advanceRehash();
+        std::optional<QVariant> result;
+        resolveView(key, [&](const auto &lookupKey) { result = getKey(lookupKey); });
+        return result;
+    }
+
+    bool erase(const QVariant &key) override {
+        const HashMapStatsRecorder::LatencySample sample(stats_);
+        advanceRehash();
+        K nativeKey{};
+        if (!KeyTraits::fromVariant(key, nativeKey)) {
+            traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::TYPE_MISMATCH});
+            return false;
+        }
+        return eraseKey(nativeKey);
+    }
+
+    bool erase(const HashMapKeyView &key) override {
+        const HashMapStatsRecorder::LatencySample sample(stats_);
+        advanceRehash();
+        bool erased = false;
+        resolveView(key, [&](const auto &lookupKey) { erased = eraseKey(lookupKey); });
+        return erased;
+    }
+
+    // Lookup and erase proper, for K or a view of one (see fromView).
+    template<typename Q>
+    std::optional<QVariant> getKey(const Q &key) {
+        const size_t hash = core_.hashOf(key);
+        materializeFor(hash);
+        const int index = core_.bucketForHash(hash);
+        if (bloomRejects(key, hash, index)) return std::nullopt;
+        const qint32 keyOperand = traceLookupStart(key, index, true);
+
+        qint32 ordinal = 0;
+        const Node *node = core_.find(key, hash, [&](const Node &n, bool matched) {
+            traceCompare(n, keyOperand, ordinal++, matched);
+        });
+        stats_.recordLookup(node != nullptr, ordinal);
+        if (bloom_) stats_.recordBloomPass(node != nullptr);
+        if (node) {
+            if (trace_.wants(HashMapTrace::SUMMARY)) {
+                trace_.record({HashMapTrace::FOUND, 1, index, ordinal,
+                               trace_.addOperand(ValueTraits::toVariant(node->value))});
+            }
+            return ValueTraits::toVariant(node->value);
+        }
+        traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::NOT_FOUND, 0, index, ordinal});
+        return std::nullopt;
+    }
+
+    template<typename Q>
+    bool eraseKey(const Q &key) {
+        const size_t hash = core_.hashOf(key);
+        materializeFor(hash);
+        const int index = core_.bucketForHash(hash);
+        if (bloomRejects(key, hash, index)) return false;
+        const qint32 keyOperand = traceLookupStart(key, index, false);
+
+        qint32 ordinal = 0;
+        int erasedFrom = -1;
+        const bool wasTree = core_.isTreeBucket(index);
+        const bool erased = core_.erase(key, hash, [&](const Node &node, bool matched) {
+            traceCompare(node, keyOperand, ordinal++, matched);
+            if (!matched) return;
+            erasedFrom = core_.bucketOf(node);
+            if (valueIndex_) valueIndex_->remove(node.value, node.key);
+        });
+        stats_.recordLookup(erased, ordinal);
+        if (bloom_) stats_.recordBloomPass(erased);
+        if (erased) {
+            entryRemoved(erasedFrom);
+            if (wasTree && !core_.isTreeBucket(index)) {
+                traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::TREEIFY, 1, index, 0, core_.bucketSize(index)});
+            }
+            traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::SIZE, 1, index, ordinal, core_.size(), 0, core_.loadFactor()});
+            maybeShrink();
+            return true;
+        }
+        traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::NOT_FOUND, 1, index, ordinal});
+        return false;
+    }
+
+    std::optional<QVariant> findByValue(const QVariant &value) override {
+        V nativeValue{};
+        if (!ValueTraits::fromVariant(value, nativeValue)) {
+            traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::TYPE_MISMATCH});
+            return std::nullopt;
+        }
+        materializeAll();
+        const bool summary = trace_.wants(HashMapTrace::SUMMARY);
+        const qint32 target = summary ? trace_.addOperand(ValueTraits::toVariant(nativeValue)) : 0;
+        const quint8 algorithm = valueIndex_ ? 1 : Core::kDenseEntries ? 2 : 0;
+        if (summary) trace_.record({HashMapTrace::VALUE_TARGET, algorithm, -1, 0, target});
+
+        if (valueIndex_) {
+            if (const K *key = valueIndex_->firstKeyFor(nativeValue)) {
+                if (summary) {
+                    trace_.record({HashMapTrace::VALUE_FOUND, 2, core_.bucketFor(*key),
+                                   valueIndex_->keyCount(nativeValue), target,
+                                   trace_.addOperand(KeyTraits::toVariant(*key))});
+                }
+                return KeyTraits::toVariant(*key);
+            }
+            if (summary) trace_.record({HashMapTrace::VALUE_NOT_FOUND, 1, -1, 0, target});
+            return std::nullopt;
+        }
+
+        int totalChecked = 0;
+        const Node *found = nullptr;
+        int foundBucket = -1;
+        if constexpr (Core::kDenseEntries) {
+            // One pass over the contiguous entries instead of every bucket
+            found = core_.findEntry([&](const Node &node) {
+                ++totalChecked;
+                if (trace_.wantsDetail()) {
+                    const qint32 keyOperand = trace_.addOperand(KeyTraits::toVariant(node.key));
+                    trace_.addOperand(ValueTraits::toVariant(node.value));
+                    trace_.record({HashMapTrace::VALUE_COMPARE, 0, core_.bucketOf(node), totalChecked - 1,
+                                   keyOperand, target});
+                }
+                return node.value == nativeValue;
+            });
+            if (found) foundBucket = core_.bucketOf(*found);
+        }
+        // Search through all buckets
+        for (int i = 0; !Core::kDenseEntries && i < core_.bucketCount() && !found; ++i) {
+            if (trace_.wantsDetail()) trace_.record({HashMapTrace::VALUE_BUCKET, 0, i});
+
+            int itemsInBucket = 0;
+            core_.forEachInBucket(i, [&](const Node &node) {
+                if (found) return;
+                itemsInBucket++;
+                totalChecked++;
+                if (trace_.wantsDetail()) {
+                    const qint32 keyOperand = trace_.addOperand(KeyTraits::toVariant(node.key));
+                    trace_.addOperand(ValueTraits::toVariant(node.value));
+                    trace_.record({HashMapTrace::VALUE_COMPARE, 0, i, itemsInBucket - 1, keyOperand, target});
+                }
+                if (node.value == nativeValue) {
+                    found = &node;
+                    foundBucket = i;
+                }
+            });
+
+            if (itemsInBucket == 0 && trace_.wantsDetail()) {
+                trace_.record({HashMapTrace::VALUE_BUCKET, 1, i});
+            }
+        }
+
+        if (found) {
+            if (summary) {
+                trace_.record({HashMapTrace::VALUE_FOUND, 1, foundBucket, totalChecked, target,
+                               trace_.addOperand(KeyTraits::toVariant(found->key))});
+            }
+            return KeyTraits::toVariant(found->key); // Return the key associated with this value
+        }
+        if (summary) {
+            trace_.record({HashMapTrace::VALUE_NOT_FOUND, 0, -1, totalChecked, target, core_.bucketCount()});
+        }
+        return std::nullopt;
+    }
+
+    // The batch operations convert and hash every key first, then resolve
+    // them in order while prefetching the bucket kPrefetchDistance keys
+    // ahead, so the cache misses of independent keys overlap. They record
+    // one summary line instead of a per-key trace.
+    int emplaceOrAssignBatch(const QVector<QVariant> &keys, const QVector<QVariant> &values,
+                             bool assignIfExists) override {
+        const int count = std::min(keys.size(), values.size());
+        std::vector<K> nativeKeys;
+        std::vector<V> nativeValues;
+        nativeKeys.reserve(static_cast<size_t>(count));
+        nativeValues.reserve(static_cast<size_t>(count));
+        int rejected = 0;
+        for (int i = 0; i < count; ++i) {
+            K nativeKey{};
+            V nativeValue{};
+            if (!KeyTraits::fromVariant(keys[i], nativeKey) || !ValueTraits::fromVariant(values[i], nativeValue)) {
+                ++rejected;
+                continue;
+            }
+            nativeKeys.push_back(std::move(nativeKey));
+            nativeValues.push_back(std::move(nativeValue));
+        }
+
+        // One resize up front rather than growing part way through
+        const int n = static_cast<int>(nativeKeys.size());
+        const int expected = core_.size() + n;
+        if (core_.bucketCountFor(expected, core_.maxLoadFactor()) > core_.bucketCount()) {
+            reserve(expected);
+        } else {
+            advanceRehash(n);
+        }
+        const std::vector<size_t> hashes = hashAll(nativeKeys);
+
+        int inserted = 0;
+        for (int i = 0; i < n; ++i) {
+            prefetchAhead(hashes, i);
+            materializeFor(hashes[i]);
+            int compares = 0;
+            Node *existing = core_.find(nativeKeys[i], hashes[i], [&compares](const Node &, bool) { ++compares; });
+            stats_.recordLookup(existing != nullptr, compares);
+            if (existing) {
+                if (assignIfExists) {
+                    assignValue(*existing, std::move(nativeValues[i]));
+                    touchBucket(core_.bucketOf(*existing));
+                }
+                continue;
+            }
+            maybeGrow(); // only if the max load factor is below reserve()'s target
+            if (valueIndex_) valueIndex_->add(nativeValues[i], nativeKeys[i]);
+            entryAdded(core_.bucketOf(insertNode(hashes[i], std::move(nativeKeys[i]),
+                                                 std::move(nativeValues[i]), false)));
+            ++inserted;
+        }
+
+        traceBatch(assignIfExists ? HashMapTrace::BATCH_PUT_OP : HashMapTrace::BATCH_INSERT_OP,
+                   n, inserted, rejected);
+        if (inserted > 0) {
+            traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::SIZE, 0, -1, 0, core_.size(), 0, core_.loadFactor()});
+        }
+        return inserted;
+    }
+
+    QVector<std::optional<QVariant>> getBatch(const QVector<QVariant> &keys) override {
+        QVector<std::optional<QVariant>> results(keys.size());
+        std::vector<K> nativeKeys;
+        std::vector<int> positions;
+        const int rejected = convertKeys(keys, nativeKeys, positions);
+
+        const int n = static_cast<int>(nativeKeys.size());
+        advanceRehash(n);
+        const std::vector<size_t> hashes = hashAll(nativeKeys);
+
+        int found = 0;
+        for (int i = 0; i < n; ++i) {
+            prefetchAhead(hashes, i);
+            materializeFor(hashes[i]);
+            if (bloomRejects(hashes[i])) continue;
+            int compares = 0;
+            const Node *node = core_.find(nativeKeys[i], hashes[i], [&compares](const Node &, bool) { ++compares; });
+            stats_.recordLookup(node != nullptr, compares);
+            if (bloom_) stats_.recordBloomPass(node != nullptr);
+            if (node) {
+                results[positions[i]] = ValueTraits::toVariant(node->value);
+                ++found;
+            }
+        }
+        traceBatch(HashMapTrace::BATCH_GET_OP, n, found, rejected);
+        return results;
+    }
+
+    int eraseBatch(const QVector<QVariant> &keys) override {
+        std::vector<K> nativeKeys;
+        std::vector<int> positions;
+        const int rejected = convertKeys(keys, nativeKeys, positions);
+
+        const int n = static_cast<int>(nativeKeys.size());
+        advanceRehash(n);
+        const std::vector<size_t> hashes = hashAll(nativeKeys);
+
+        int erased = 0;
+        for (int i = 0; i < n; ++i) {
+            prefetchAhead(hashes, i);
+            materializeFor(hashes[i]);
+            if (bloomRejects(hashes[i])) continue;
+            int compares = 0;
+            const bool hit = core_.erase(nativeKeys[i], hashes[i], [this, &compares](const Node &node, bool matched) {
+                ++compares;
+                if (!matched) return;
+                entryRemoved(core_.bucketOf(node));
+                if (valueIndex_) valueIndex_->remove(node.value, node.key);
+            });
+            stats_.recordLookup(hit, compares);
+            if (bloom_) stats_.recordBloomPass(hit);
+            erased += hit;
+        }
+        traceBatch(HashMapTrace::BATCH_ERASE_OP, n, erased, rejected);
+        if (erased > 0) {
+            traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::SIZE, 1, -1, 0, core_.size(), 0, core_.loadFactor()});
+            maybeShrink();
+        }
+        return erased;
+    }
+
+    void maybeGrow() override {
+        adaptLoadFactor();
+        if (core_.needsGrow()) {
+            const int newCount = core_.grownBucketCount();
+            quint8 stashFull = 0;
+            qint32 stashed = 0;
+            if constexpr (Core::kCuckoo) {
+                stashFull = core_.stashFull();
+                stashed = core_.stashSize();
+            }
+            traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::GROW, stashFull, -1, 0, newCount, stashed,
+                                               core_.loadFactor(), core_.maxLoadFactor()});
+            resize(newCount);
+        }
+    }
+
+    // Runs after erases. The target load is halfway between the limits;
+    // capping the minimum at a quarter of the maximum keeps both a
+    // doubled table and a shrunk one clear of the opposite limit. The load
+    // of a table still migrating or with snapshot entries pending isn't
+    // the whole story, so those wait.
+    void maybeShrink() {
+        if (minLoadFactor_ <= 0.0f || core_.isRehashing() || snapshot_) return;
+        const float minLoad = std::min(minLoadFactor_, core_.maxLoadFactor() / 4.0f);
+        if (core_.loadFactor() >= minLoad || core_.bucketCount() <= minBucketCount_) return;
+        const float target = (minLoad + core_.maxLoadFactor()) / 2.0f;
+        const int newCount = std::max(minBucketCount_, core_.bucketCountFor(core_.size(), target));
+        if (newCount >= core_.bucketCount()) return;
+        traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::SHRINK, 0, -1, 0, newCount, 0,
+                                           core_.loadFactor(), minLoad});
+        stats_.recordShrink();
+        resize(newCount);
+    }
+
+    void clear() override {
+        dropSnapshot();
+        core_.clear();
+        if (valueIndex_) valueIndex_->clear();
+        if (bloom_) bloom_->reset(0);
+        touchAllBuckets();
+    }
+
+    // Pending snapshot entries count towards size() but not loadFactor(),
+    // which describes the live table.
+    int size() const override { return core_.size() + pendingEntries_; }
+    int bucketCount() const override { return core_.bucketCount(); }
+    float loadFactor() const override { return core_.loadFactor(); }
+
+    void rehash(int newBucketCount) override {
+        if (newBucketCount < 1) newBucketCount = 1;
+        traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::REHASH, 0, -1, 0, newBucketCount});
+        stats_.recordRehashStart();
+        const qint64 start = HashMapStatsRecorder::nowNanos();
+        if (trace_.wants(HashMapTrace::FULL)) {
+            core_.rehash(newBucketCount, traceMove());
+        } else {
+            core_.rehash(newBucketCount);
+        }
+        stats_.recordRehashTime(HashMapStatsRecorder::nowNanos() - start);
+        touchAllBuckets();
+        rebuildBloom();
+    }
+
+    void reserve(int expectedElements) override {
+        if (expectedElements <= 0) return;
+        const float desiredLoad = kReserveHeadroom * core_.maxLoadFactor();
+        const int requiredBuckets = core_.bucketCountFor(expectedElements, desiredLoad);
+        if (requiredBuckets > core_.bucketCount()) {
+            traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::RESERVE, 0, -1, 0, expectedElements, requiredBuckets});
+            rehash(requiredBuckets);
+        }
+    }
+
+    void setMinLoadFactor(float minLoadFactor, int minBucketCount) override {
+        minLoadFactor_ = minLoadFactor;
+        minBucketCount_ = std::max(1, minBucketCount);
+    }
+
+    // Ignores the minimum bucket count; one more insert still fits.
+    void shrinkToFit() override {
+        materializeAll();
+        const int newCount = core_.bucketCountFor(core_.size() + 1, core_.maxLoadFactor());
+        if (newCount >= core_.bucketCount()) return;
+        traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::SHRINK, 1, -1, 0, newCount, 0, core_.loadFactor()});
+        stats_.recordShrink();
+        rehash(newCount);
+    }
+
+    // Turning it off finishes a migration in progress.
+    void setIncrementalRehash(bool enabled) override {
+        incrementalRehash_ = enabled;
+        if (!enabled && core_.isRehashing()) {
+            const qint64 start = HashMapStatsRecorder::nowNanos();
+            core_.rehashStep(core_.rehashSourceBuckets(), migrateMove());
+            stats_.recordRehashTime(HashMapStatsRecorder::nowNanos() - start);
+        }
+    }
+
+    // Builds the index from the current contents, or drops it.
+    void setValueIndexEnabled(bool enabled) override {
+        if (!enabled) {
+            valueIndex_.reset();
+            return;
+        }
+        if (valueIndex_) return;
+        materializeAll();
+        valueIndex_ = std::make_unique<HashMapValueIndex<K, V>>();
+        core_.forEach([this](const Node &node) { valueIndex_->add(node.value, node.key); });
+    }
+
+    // Built from the current contents; snapshot entries still pending are
+    // added as they materialize.
+    void setBloomFilter(bool enabled, float falsePositiveRate) override {
+        if (!enabled) {
+            bloom_.reset();
+            return;
+        }
+        if (!bloom_) bloom_ = std::make_unique<HashMapBloomFilter>();
+        bloom_->setFalsePositiveRate(falsePositiveRate);
+        rebuildBloom();
+    }
+
+    // The open backends cap the limit at their own kMaxLoadFactor.
+    void setAdaptiveLoadFactor(bool enabled, float minLoad, float maxLoad, float fixedLoad) override {
+        if (!enabled) {
+            loadController_.reset();
+            core_.setMaxLoadFactor(fixedLoad);
+            return;
+        }
+        if (!loadController_) {
+            loadController_ = std::make_unique<HashMapLoadController>();
+            loadController_->restartWindow(stats_.lookups(), stats_.hits(), stats_.hitCompares());
+        }
+        loadController_->configure(minLoad, maxLoad);
+        core_.setMaxLoadFactor(loadController_->clamp(core_.maxLoadFactor()));
+    }
+
+    HashMapStats stats() const override {
+        HashMapStats stats;
+        stats.size = size();
+        stats.bucketCount = core_.bucketCount();
+        stats.loadFactor = core_.loadFactor();
+        stats.rehashing = core_.isRehashing();
+        stats.rehashSourceBuckets = core_.rehashSourceBuckets();
+        stats.rehashedBuckets = core_.rehashedBuckets();
+        stats.nodeBytesReserved = core_.nodeBytesReserved();
+        stats.nodeBytesLive = core_.nodeBytesLive();
+        stats.nodeSlabs = core_.nodeSlabs();
+        stats.treeBuckets = core_.treeBucketCount();
+        if constexpr (Core::kCuckoo) stats.stashEntries = core_.stashSize();
+        stats.maxLoadFactor = core_.maxLoadFactor();
+        stats.adaptiveLoadFactor = loadController_ != nullptr;
+        if (loadController_) stats.loadSkew = loadController_->lastSkew();
+        if (bloom_) {
+            stats.bloomBytes = bloom_->bytes();
+            stats.bloomHashes = bloom_->hashCount();
+        }
+        stats_.fill(stats);
+        return stats;
+    }
+
+    void setLookupStats(bool enabled) override { stats_.setLookupCounting(enabled); }
+
+    int resizeCount() const override { return stats_.rehashCount(); }
+
+    int indexFor(const QVariant &key, int bucketCount) const override {
+        K nativeKey{};
+        if (!KeyTraits::fromVariant(key, nativeKey)) return 0;
+        return core_.bucketFor(nativeKey, bucketCount);
+    }
+
+    int indexFor(const HashMapKeyView &key) const override {
+        int index = -1;
+        KeyTraits::fromView(key, [&](const auto &lookupKey) { index = core_.bucketForHash(core_.hashOf(lookupKey)); });
+        return index;
+    }
+
+    size_t hashFor(const QVariant &key) const override {
+        K nativeKey{};
+        if (!KeyTraits::fromVariant(key, nativeKey)) return 0;
+        return core_.hashOf(nativeKey);
+    }
+
+    bool isTreeBucket(int bucket) const override {
+        if (bucket < 0 || bucket >= core_.bucketCount()) return false;
+        return core_.isTreeBucket(bucket);
+    }
+
+    QVector<int> bucketSizes() const override {
+        QVector<int> sizes;
+        sizes.reserve(core_.bucketCount());
+        for (int i = 0; i < core_.bucketCount(); ++i) {
+            sizes.push_back(core_.bucketSize(i));
+        }
+        return sizes;
+    }
+
+    QVector<QVector<QPair<QVariant, QVariant>>> getBucketContents() const override {
+        QVector<QVector<QPair<QVariant, QVariant>>> contents;
+        contents.reserve(core_.bucketCount());
+        for (int i = 0; i < core_.bucketCount(); ++i) {
+            QVector<QPair<QVariant, QVariant>> bucketItems;
+            core_.forEachInBucket(i, [&](const Node &node) {
+                bucketItems.push_back(QPair<QVariant, QVariant>(KeyTraits::toVariant(node.key),
+                                                                ValueTraits::toVariant(node.value)));
+            });
+            contents.push_back(bucketItems);
+        }
+        return contents;
+    }
+
+    void forEachInBuckets(int first, int last, const HashMap::BucketEntryVisitor &visitor) const override {
+        first = std::max(0, first);
+        last = std::min(last, core_.bucketCount());
+        for (int i = first; i < last; ++i) {
+            core_.forEachInBucket(i, [&](const Node &node) {
+                visitor(i, KeyTraits::toVariant(node.key), ValueTraits::toVariant(node.value));
+            });
+        }
+    }
+
+    void forEachEntry(const HashMap::EntryVisitor &visitor) const override {
+        core_.forEach([&](const Node &node) {
+            visitor(KeyTraits::toVariant(node.key), ValueTraits::toVariant(node.value));
+        });
+    }
+
+    quint64 modificationEpoch() const override { return epoch_; }
+
+    quint64 bucketVersion(int bucket) const override {
+        if (bucket < 0 || bucket >= static_cast<int>(bucketVersions_.size())) return layoutEpoch_;
+        return bucketVersions_[static_cast<size_t>(bucket)];
+    }
+
+    QVector<int> bucketsChangedSince(quint64 epoch) const override {
+        QVector<int> changed;
+        const int count = static_cast<int>(bucketVersions_.size());
+        if (epoch < layoutEpoch_) {
+            changed.reserve(count);
+            for (int i = 0; i < count; ++i) changed.push_back(i);
+            return changed;
+        }
+        for (int i = 0; i < count; ++i) {
+            if (bucketVersions_[static_cast<size_t>(i)] > epoch) changed.push_back(i);
+        }
+        return changed;
+    }
+
+    void restartVersionsAt(quint64 epoch) override {
+        epoch_ = std::max(epoch_, epoch);
+        touchAllBuckets();
+    }
+
+    bool writeSnapshot(const QString &path, HashMapSnapshotHeader header, QString *error) override {
+        materializeAll();
+        HashMapSnapshotStrings strings;
+        std::vector<HashMapSnapshotEntry> entries;
+        entries.reserve(static_cast<size_t>(core_.size()));
+        core_.forEach([&](const Node &node) {
+            entries.push_back({KeyCodec::encode(node.key, strings), ValueCodec::encode(node.value, strings),
+                               core_.hashOf(node.key)});
+        });
+        header.bucketCount = core_.bucketCount();
+        header.hashCheck = core_.hashOf(KeyCodec::probe());
+        return HashMapSnapshot::write(path, header, entries, strings, error);
+    }
+
+    // Expects an empty engine. If the key hash changed since the snapshot
+    // was written, its buckets and stored hashes are useless and every
+    // entry is rehashed now.
+    void attachSnapshot(std::shared_ptr<const HashMapSnapshot> snapshot) override {
+        dropSnapshot();
+        snapshot_ = std::move(snapshot);
+        pendingEntries_ = static_cast<int>(snapshot_->entryCount());
+        pendingBuckets_.assign(static_cast<size_t>(snapshot_->bucketCount()), true);
+        snapshotHashes_ = snapshot_->header().hashCheck == core_.hashOf(KeyCodec::probe());
+        traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::SNAPSHOT, static_cast<quint8>(snapshotHashes_ ? 0 : 1),
+                                           -1, 0, pendingEntries_, snapshot_->bucketCount()});
+        if (!snapshotHashes_ || pendingEntries_ == 0) materializeAll();
+    }
+
+    int pendingSnapshotEntries() const override { return pendingEntries_; }
+
+    void materializeSnapshot() override { materializeAll(); }
+
+private:
+    using KeyTraits = HashMapTypeTraits<K>;
+    using ValueTraits = HashMapTypeTraits<V>;
+    using KeyCodec = HashMapSnapshotCodec<K>;
+    using ValueCodec = HashMapSnapshotCodec<V>;
+
+    // Old buckets migrated per operation during an incremental rehash.
+    // Enough to finish well before the next growth at any sane load factor.
+    static constexpr int kRehashBucketsPerStep = 4;
+    // How many keys ahead the batch operations prefetch.
+    static constexpr int kPrefetchDistance = 8;
+    // reserve() sizes for this fraction of the maximum load, leaving room
+    // to insert before the next growth.
+    static constexpr float kReserveHeadroom = 0.8f;
+
+    Core core_;
+    HashMapTrace &trace_;
+    bool incrementalRehash_ = false;
+    float minLoadFactor_ = 0.0f;          // 0 = never shrink
+    int minBucketCount_ = 1;
+    std::unique_ptr<HashMapValueIndex<K, V>> valueIndex_;  // null unless enabled
+    std::unique_ptr<HashMapBloomFilter> bloom_;            // null unless enabled
+    std::unique_ptr<HashMapLoadController> loadController_;  // null unless adaptive
+    std::vector<quint64> bucketVersions_;  // epoch of each bucket's last change
+    quint64 epoch_ = 0;
+    quint64 layoutEpoch_ = 0;              // last resize or clear
+    HashMapStatsRecorder stats_;
+
+    // Loaded snapshot; null once every bucket has been materialized.
+    std::shared_ptr<const HashMapSnapshot> snapshot_;
+    std::vector<bool> pendingBuckets_;     // per snapshot bucket
+    int pendingEntries_ = 0;
+    bool snapshotHashes_ = false;          // stored hashes match core_.hashOf()
+
+    // Lets the load controller move the growth threshold once a window of
+    // lookups has passed.
+    void adaptLoadFactor() {
+        if (!loadController_) return;
+        const float limit = core_.maxLoadFactor();
+        const auto decision = loadController_->observe(stats_.lookups(), stats_.hits(), stats_.hitCompares(),
+                                                       core_.expectedHitCompares(), stats_.chainDispersion(), limit);
+        if (!decision) return;
+        core_.setMaxLoadFactor(decision->limit);
+        const float applied = core_.maxLoadFactor();
+        if (applied == limit) return;
+        stats_.recordLoadAdjustment(applied > limit);
+        traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::LOAD_ADAPT, static_cast<quint8>(applied > limit), -1, 0,
+                                           0, 0, applied, static_cast<float>(decision->skew)});
+    }
+
+    // Grow or shrink, incrementally when enabled and supported.
+    void resize(int newCount) {
+        if constexpr (Core::kIncrementalRehash) {
+            if (incrementalRehash_) {
+                traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::REHASH, 1, -1, 0, newCount});
+                stats_.recordRehashStart();
+                const qint64 start = HashMapStatsRecorder::nowNanos();
+                core_.startIncrementalRehash(newCount, traceMove());
+                stats_.recordRehashTime(HashMapStatsRecorder::nowNanos() - start);
+                touchAllBuckets();
+                rebuildBloom();
+                return;
+            }
+        }
+        rehash(newCount);
+    }
+
+    void materializeFor(size_t hash) {
+        if (!snapshot_) return;
+        const int bucket = snapshot_->bucketForHash(hash);
+        if (pendingBuckets_[static_cast<size_t>(bucket)]) materializeBucket(bucket);
+    }
+
+    // Reserves for the whole snapshot first, so at most one resize.
+    void materializeAll() {
+        if (!snapshot_) return;
+        reserve(core_.size() + pendingEntries_);
+        for (int b = 0; snapshot_ && b < snapshot_->bucketCount(); ++b) {
+            if (pendingBuckets_[static_cast<size_t>(b)]) materializeBucket(b, /*traced=*/false);
+        }
+        dropSnapshot();
+    }
+
+    // Inserts the entries of one snapshot bucket without tracing each; none
+    // of their keys can be live yet, since every keyed operation
+    // materializes its bucket first.
+    void materializeBucket(int bucket, bool traced = true) {
+        const quint32 end = snapshot_->bucketEnd(bucket);
+        const quint32 begin = snapshot_->bucketBegin(bucket);
+        for (quint32 i = begin; i < end; ++i) {
+            const HashMapSnapshotEntry &entry = snapshot_->entry(i);
+            K key = KeyCodec::decode(entry.key, *snapshot_);
+            V value = ValueCodec::decode(entry.value, *snapshot_);
+            const size_t hash = snapshotHashes_ ? static_cast<size_t>(entry.hash) : core_.hashOf(key);
+            maybeGrow();
+            if (valueIndex_) valueIndex_->add(value, key);
+            countEntry(core_.bucketOf(insertNode(hash, std::move(key), std::move(value), false)));
+        }
+        pendingBuckets_[static_cast<size_t>(bucket)] = false;
+        pendingEntries_ -= static_cast<int>(end - begin);
+        if (traced) traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::SNAPSHOT, 2, bucket, 0, static_cast<qint32>(end - begin)});
+        if (pendingEntries_ == 0) dropSnapshot();
+    }
+
+    void dropSnapshot() {
+        if (!snapshot_) return;
+        if (pendingEntries_ == 0) traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::SNAPSHOT, 3});
+        snapshot_.reset();
+        std::vector<bool>().swap(pendingBuckets_);
+        pendingEntries_ = 0;
+    }
+
+    void touchBucket(int bucket) {
+        // The swiss core can rebuild itself inside insertUnique()
+        if (static_cast<int>(bucketVersions_.size()) != core_.bucketCount()) {
+            touchAllBuckets();
+            return;
+        }
+        bucketVersions_[static_cast<size_t>(bucket)] = ++epoch_;
+    }
+
+    // Also recounts the chain lengths, which a layout change reshuffles.
+    void touchAllBuckets() {
+        layoutEpoch_ = ++epoch_;
+        bucketVersions_.assign(static_cast<size_t>(core_.bucketCount()), layoutEpoch_);
+        recountChains();
+    }
+
+    void recountChains() {
+        stats_.resetChains(core_.bucketCount());
+        core_.forEach([this](const Node &node) { stats_.addToChain(core_.bucketOf(node)); });
+    }
+
+    // Chain bookkeeping for a node just linked into bucket. A swiss core
+    // that rebuilt itself on the way has been counted afresh instead.
+    void countEntry(int bucket) {
+        if (stats_.chainBuckets() != core_.bucketCount()) {
+            recountChains();
+            return;
+        }
+        stats_.addToChain(bucket);
+    }
+
+    void entryAdded(int bucket) {
+        countEntry(bucket);
+        touchBucket(bucket);
+    }
+
+    void entryRemoved(int bucket) {
+        stats_.removeFromChain(bucket);
+        touchBucket(bucket);
+        if (bloom_) bloom_->noteErase();
+    }
+
+    // True when the Bloom filter rules the key out. A filter gone stale is
+    // rebuilt here rather than inside the insert or erase that outgrew it,
+    // which may still be walking the table.
+    bool bloomRejects(size_t hash) {
+        if (!bloom_) return false;
+        if (bloom_->needsRebuild()) rebuildBloom();
+        if (bloom_->mayContain(hash)) return false;
+        stats_.recordBloomReject();
+        stats_.recordLookup(false, 0);
+        return true;
+    }
+
+    template<typename Q>
+    bool bloomRejects(const Q &key, size_t hash, int index) {
+        if (!bloomRejects(hash)) return false;
+        if (trace_.wants(HashMapTrace::SUMMARY)) {
+            trace_.record({HashMapTrace::BLOOM_REJECT, 0, index, 0, trace_.addOperand(lookupVariant(key))});
+        }
+        return true;
+    }
+
+    void rebuildBloom() {
+        if (!bloom_) return;
+        bloom_->reset(core_.size() + pendingEntries_);
+        core_.forEach([this](const Node &node) { bloom_->add(core_.hashOf(node.key)); });
+        stats_.recordBloomRebuild();
+    }
+
+    // insertUnique plus the Bloom filter, and the bookkeeping for entries
+    // a cuckoo insert moves out of the way: each kick-out is counted,
+    // re-homes its entry in the chain stats and, when traced, becomes an
+    // EVICT step.
+    Node &insertNode(size_t hash, K key, V value, bool traced) {
+        if (bloom_) bloom_->add(hash);
+        if constexpr (Core::kCuckoo) {
+            qint32 kick = 0;
+            return core_.insertUnique(hash, std::move(key), std::move(value),
+                                      [&](const Node &node, int from, int to, bool stashed) {
+                stats_.recordEviction();
+                stats_.removeFromChain(from);
+                stats_.addToChain(to);
+                touchBucket(from);
+                touchBucket(to);
+                if (traced && trace_.wants(HashMapTrace::SUMMARY)) {
+                    trace_.record({HashMapTrace::EVICT, static_cast<quint8>(stashed), from, kick,
+                                   trace_.addOperand(KeyTraits::toVariant(node.key)), to});
+                }
+                ++kick;
+            });
+        } else {
+            return core_.insertUnique(hash, std::move(key), std::move(value));
+        }
+    }
+
+    // Migration work owed by `operations` single-key operations.
+    void advanceRehash(int operations = 1) {
+        if (!core_.isRehashing() || operations <= 0) return;
+        const int source = core_.rehashSourceBuckets();
+        const int buckets = std::min(source, kRehashBucketsPerStep * std::min(operations, source));
+        const qint64 start = HashMapStatsRecorder::nowNanos();
+        const bool rehashing = core_.rehashStep(buckets, migrateMove());
+        stats_.recordRehashTime(HashMapStatsRecorder::nowNanos() - start);
+        traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::REHASH_STEP, static_cast<quint8>(!rehashing), -1, 0,
+                                           rehashing ? core_.rehashedBuckets() : source, source});
+    }
+
+    void assignValue(Node &node, V value) {
+        if (valueIndex_ && !(node.value == value)) {
+            valueIndex_->remove(node.value, node.key);
+            valueIndex_->add(value, node.key);
+        }
+        node.value = std::move(value);
+    }
+
+    // Converts keys to native form, remembering each one's input position.
+    // Returns how many were rejected.
+    int convertKeys(const QVector<QVariant> &keys, std::vector<K> &nativeKeys, std::vector<int> &positions) const {
+        nativeKeys.reserve(static_cast<size_t>(keys.size()));
+        positions.reserve(static_cast<size_t>(keys.size()));
+        for (int i = 0; i < keys.size(); ++i) {
+            K nativeKey{};
+            if (!KeyTraits::fromVariant(keys[i], nativeKey)) continue;
+            nativeKeys.push_back(std::move(nativeKey));
+            positions.push_back(i);
+        }
+        return keys.size() - static_cast<int>(nativeKeys.size());
+    }
+
+    std::vector<size_t> hashAll(const std::vector<K> &nativeKeys) const {
+        std::vector<size_t> hashes;
+        hashes.reserve(nativeKeys.size());
+        for (const K &key : nativeKeys) hashes.push_back(core_.hashOf(key));
+        // Warm the first buckets before the resolve loop starts
+        for (size_t i = 0; i < hashes.size() && i < static_cast<size_t>(kPrefetchDistance); ++i) {
+            core_.prefetch(hashes[i]);
+        }
+        return hashes;
+    }
+
+    void prefetchAhead(const std::vector<size_t> &hashes, int i) const {
+        const size_t ahead = static_cast<size_t>(i) + kPrefetchDistance;
+        if (ahead < hashes.size()) core_.prefetch(hashes[ahead]);
+    }
+
+    void traceBatch(HashMapTrace::OperationKind kind, int keys, int affected, int rejected) {
+        traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::BATCH, kind, -1, rejected, keys, affected});
+    }
+
+    // onMove callback for the core; records a MOVE step per node at FULL.
+    auto traceMove() {
+        return [this](const Node &node, int newIndex) {
+            if (!trace_.wantsDetail()) return;
+            const qint32 keyOperand = trace_.addOperand(KeyTraits::toVariant(node.key));
+            trace_.addOperand(ValueTraits::toVariant(node.value));
+            trace_.record({HashMapTrace::MOVE, 0, newIndex, 0, keyOperand});
+        };
+    }
+
+    // onMove for incremental migration: a moved node also reorders the
+    // bucket it is reported under.
+    auto migrateMove() {
+        return [this, trace = traceMove()](const Node &node, int newIndex) {
+            trace(node, newIndex);
+            touchBucket(newIndex);
+        };
+    }
+
+    // Resolves a key view and runs lookup on it, tracing the views that
+    // can't match anything.
+    template<typename Lookup>
+    void resolveView(const HashMapKeyView &key, Lookup &&lookup) {
+        switch (KeyTraits::fromView(key, lookup)) {
+        case HashMapKeyView::RESOLVED:
+            break;
+        case HashMapKeyView::WRONG_KIND:
+            traceEvent(HashMapTrace::SUMMARY, {HashMapTrace::TYPE_MISMATCH});
+            break;
+        case HashMapKeyView::NOT_REPRESENTABLE:
+            if (trace_.wants(HashMapTrace::SUMMARY)) {
+                trace_.record({HashMapTrace::NO_EXACT_KEY, 0, -1, 0, trace_.addOperand(key.toVariant())});
+            }
+            break;
+        }
+    }
+
+    // Trace operand for a lookup key; only built when the trace is on.
+    static QVariant lookupVariant(const K &key) { return KeyTraits::toVariant(key); }
+    static QVariant lookupVariant(QStringView key) { return QVariant(key.toString()); }
+
+    void traceEvent(HashMapTrace::Level level, const HashMapTraceEvent &event) {
+        if (trace_.wants(level)) trace_.record(event);
+    }
+
+    // Whether the HASH step may read "hash(k) = k" and "k % n": only when
+    // that is literally how the bucket was found. That takes an integer
+    // key under SIMPLE on a backend with kPlainModulo, and a non-negative
+    // one, since size_t(-5) % 8 isn't what "-5 % 8" reads as. Floating-point
+    // keys hash their bit pattern and never qualify.
+    template<typename Q>
+    bool plainModuloKey(const Q &key) const {
+        if constexpr (std::is_same<K, int>::value && std::is_same<Q, int>::value && Core::kPlainModulo) {
+            return core_.hashFunction().hashing.policy == HashMapHashing::SIMPLE && key >= 0;
+        } else {
+            Q_UNUSED(key);
+            return false;
+        }
+    }
+
+    // Records the hash and bucket steps; returns the key operand for the
+    // per-node compares that follow (or -1 when the trace is OFF).
+    template<typename Q>
+    qint32 traceLookupStart(const Q &key, int index, bool searchStyle) {
+        if (!trace_.wants(HashMapTrace::SUMMARY)) return -1;
+        const qint32 keyOperand = trace_.addOperand(lookupVariant(key));
+        const quint8 numericKey = plainModuloKey(key);
+        trace_.record({HashMapTrace::HASH, numericKey, index, 0, keyOperand, core_.bucketCount()});
+        if constexpr (Core::kCuckoo) {
+            trace_.record({HashMapTrace::CUCKOO_BUCKETS, 0, index, 0, core_.alternateBucketForHash(core_.hashOf(key))});
+        }
+        trace_.record({HashMapTrace::VISIT_BUCKET, static_cast<quint8>(searchStyle), index});
+        if (core_.isTreeBucket(index)) trace_.record({HashMapTrace::TREE_SEARCH, 0, index});
+        return keyOperand;
+    }
+
+    // flags bit 0 = matched, bit 1 = the node sits in a tree bucket.
+    void traceCompare(const Node &node, qint32 keyOperand, qint32 ordinal, bool matched) {
+        if (!trace_.wantsDetail()) return;
+        const qint32 nodeOperand = trace_.addOperand(KeyTraits::toVariant(node.key));
+        const quint8 tree = core_.isTreeBucket(core_.bucketOf(node)) ? 2 : 0;
+        trace_.record({HashMapTrace::COMPARE, static_cast<quint8>(matched | tree), -1, ordinal, nodeOperand, keyOperand});
+    }
+};
+
+// Builds the typed engine for a (key, value) DataType pair and backend
+// (defined in hashmap.cpp).
+std::unique_ptr<HashMapEngine> makeHashMapEngine(HashMap::DataType keyType, HashMap::DataType valueType,
+                                                 HashMap::Backend backend, int bucketCount,
+                                                 float maxLoadFactor, HashMapTrace &trace,
+                                                 HashMapHashing hashing = HashMapHashing());
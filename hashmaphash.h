@@ -0,0 +1,177 @@
+#pragma once
+
+#include <QChar>
+#include <QString>
+#include <QStringView>
+#include <QtGlobal>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+
+// Which hash function family a map uses, and its seed.
+//
+//   FAST   - wyhash over the key's bytes (QString: its UTF-16 buffer, read
+//            in place). Numeric keys keep std::hash unless seeded.
+//   SIMPLE - textbook functions for teaching: integers hash to themselves
+//            (negative ones as their two's-complement size_t), QChar to its
+//            code point, QString to sum(c * 31^i). Floating-point keys keep
+//            std::hash, a hash of the bit pattern, not the value. The seed
+//            is ignored.
+//
+// A non-zero seed makes FAST hashes differ per map (HashMap::randomHashSeed()).
+struct HashMapHashing {
+    enum Policy {
+        FAST,
+        SIMPLE
+    };
+
+    Policy policy = FAST;
+    quint64 seed = 0;
+
+    // True when numeric keys are hashed without the seeded mix.
+    bool plainNumbers() const { return policy == SIMPLE || seed == 0; }
+};
+
+// wyhash (final version 4, Wang Yi, public domain), reduced to what the
+// key types here need.
+namespace hashmap_detail {
+
+constexpr quint64 kWySecret[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+                                  0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+
+inline void wyMum(quint64 *a, quint64 *b) {
+#if defined(__SIZEOF_INT128__)
+    const __uint128_t r = static_cast<__uint128_t>(*a) * *b;
+    *a = static_cast<quint64>(r);
+    *b = static_cast<quint64>(r >> 64);
+#else
+    const quint64 ha = *a >> 32, hb = *b >> 32, la = static_cast<quint32>(*a), lb = static_cast<quint32>(*b);
+    const quint64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    const quint64 t = rl + (rm0 << 32);
+    quint64 c = t < rl;
+    const quint64 lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+inline quint64 wyMix(quint64 a, quint64 b) {
+    wyMum(&a, &b);
+    return a ^ b;
+}
+
+inline quint64 wyRead8(const unsigned char *p) {
+    quint64 v;
+    std::memcpy(&v, p, 8);
+    return v;
+}
+
+inline quint64 wyRead4(const unsigned char *p) {
+    quint32 v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+inline quint64 wyRead3(const unsigned char *p, size_t k) {
+    return (static_cast<quint64>(p[0]) << 16) | (static_cast<quint64>(p[k >> 1]) << 8) | p[k - 1];
+}
+
+} // namespace hashmap_detail
+
+inline quint64 hashMapHashBytes(const void *key, size_t len, quint64 seed) {
+    using namespace hashmap_detail;
+    const unsigned char *p = static_cast<const unsigned char *>(key);
+    seed ^= wyMix(seed ^ kWySecret[0], kWySecret[1]);
+    quint64 a, b;
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (wyRead4(p) << 32) | wyRead4(p + ((len >> 3) << 2));
+            b = (wyRead4(p + len - 4) << 32) | wyRead4(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = wyRead3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            quint64 see1 = seed, see2 = seed;
+            do {
+                seed = wyMix(wyRead8(p) ^ kWySecret[1], wyRead8(p + 8) ^ seed);
+                see1 = wyMix(wyRead8(p + 16) ^ kWySecret[2], wyRead8(p + 24) ^ see1);
+                see2 = wyMix(wyRead8(p + 32) ^ kWySecret[3], wyRead8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = wyMix(wyRead8(p) ^ kWySecret[1], wyRead8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = wyRead8(p + i - 16);
+        b = wyRead8(p + i - 8);
+    }
+    a ^= kWySecret[1];
+    b ^= seed;
+    wyMum(&a, &b);
+    return wyMix(a ^ kWySecret[0] ^ len, b ^ kWySecret[1]);
+}
+
+// Hash functors for the key types HashMap supports, parameterised by a
+// HashMapHashing. Default-constructed they are FAST and unseeded.
+template<typename K>
+struct HashMapHash {
+    HashMapHashing hashing;
+
+    HashMapHash() = default;
+    explicit HashMapHash(HashMapHashing hashing) : hashing(hashing) {}
+
+    size_t operator()(const K &key) const {
+        if constexpr (std::is_integral<K>::value) {
+            if (hashing.policy == HashMapHashing::SIMPLE) return static_cast<size_t>(key);
+        }
+        const size_t h = std::hash<K>{}(key);
+        if (hashing.plainNumbers()) return h;
+        return static_cast<size_t>(hashmap_detail::wyMix(h ^ hashing.seed, hashmap_detail::kWySecret[0]));
+    }
+};
+
+template<>
+struct HashMapHash<QString> {
+    HashMapHashing hashing;
+
+    HashMapHash() = default;
+    explicit HashMapHash(HashMapHashing hashing) : hashing(hashing) {}
+
+    size_t operator()(const QString &key) const { return utf16(key.constData(), static_cast<size_t>(key.size())); }
+    size_t operator()(QStringView key) const { return utf16(key.data(), static_cast<size_t>(key.size())); }
+
+    // Any UTF-16 view of the same text hashes alike.
+    size_t utf16(const QChar *data, size_t length) const {
+        if (hashing.policy == HashMapHashing::SIMPLE) {
+            size_t h = 0;
+            for (size_t i = 0; i < length; ++i) h = h * 31 + data[i].unicode();
+            return h;
+        }
+        return static_cast<size_t>(hashMapHashBytes(data, length * sizeof(QChar), hashing.seed));
+    }
+};
+
+template<>
+struct HashMapHash<QChar> {
+    HashMapHashing hashing;
+
+    HashMapHash() = default;
+    explicit HashMapHash(HashMapHashing hashing) : hashing(hashing) {}
+
+    size_t operator()(const QChar &key) const {
+        if (hashing.policy == HashMapHashing::SIMPLE) return key.unicode();
+        const ushort unit = key.unicode();
+        return static_cast<size_t>(hashMapHashBytes(&unit, sizeof unit, hashing.seed));
+    }
+};
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <QChar>
+#include <QString>
+#include <QStringView>
+#include <QVariant>
+#include <QtGlobal>
+#include <cmath>
+#include <limits>
+#include <string_view>
+#include <type_traits>
+
+// A lookup key handed to HashMap::get/contains/erase as it is, without
+// boxing it in a QVariant: UTF-16 text, UTF-8 text, or a number. The
+// engine matches it against the map's key type directly:
+//
+//   STRING        text of either encoding, hashed in place
+//   CHAR          text of exactly one UTF-16 unit
+//   INTEGER       integral or floating values equal to some int
+//   DOUBLE/FLOAT  integral or floating values the key type holds exactly
+//
+// A number no key of the map's type can equal (2.5 in an INTEGER map) is
+// simply not found; text against a numeric map, or a number against a
+// text map, is a type mismatch. The view doesn't own the text.
+class HashMapKeyView {
+public:
+    enum Kind {
+        TEXT,       // UTF-16
+        UTF8,
+        SIGNED,
+        UNSIGNED,
+        FLOATING
+    };
+
+    // How a view maps onto a map's key type.
+    enum Resolution {
+        RESOLVED,           // a lookup key was produced
+        WRONG_KIND,         // text vs numbers: a type mismatch
+        NOT_REPRESENTABLE   // right kind, but no key can equal it
+    };
+
+    // Types the HashMap lookup overloads take as a key view. Characters
+    // and bool are left to the QVariant overloads.
+    template<typename T>
+    static constexpr bool accepts =
+        std::is_same<T, QStringView>::value || std::is_same<T, std::string_view>::value
+        || (std::is_arithmetic<T>::value && !std::is_same<T, bool>::value && !std::is_same<T, char>::value
+            && !std::is_same<T, char16_t>::value && !std::is_same<T, char32_t>::value
+            && !std::is_same<T, wchar_t>::value);
+
+    HashMapKeyView(QStringView text) : kind_(TEXT), text_(text) {}
+    HashMapKeyView(std::string_view utf8) : kind_(UTF8), utf8_(utf8) {}
+
+    template<typename T, std::enable_if_t<std::is_integral<T>::value && std::is_signed<T>::value, int> = 0>
+    HashMapKeyView(T value) : kind_(SIGNED), signed_(value) {}
+    template<typename T, std::enable_if_t<std::is_integral<T>::value && std::is_unsigned<T>::value, int> = 0>
+    HashMapKeyView(T value) : kind_(UNSIGNED), unsigned_(value) {}
+    template<typename T, std::enable_if_t<std::is_floating_point<T>::value, int> = 0>
+    HashMapKeyView(T value) : kind_(FLOATING), floating_(static_cast<double>(value)) {}
+
+    Kind kind() const { return kind_; }
+    bool isText() const { return kind_ == TEXT || kind_ == UTF8; }
+    QStringView text() const { return text_; }
+    std::string_view utf8() const { return utf8_; }
+
+    // Boxed copy for the step trace.
+    QVariant toVariant() const {
+        switch (kind_) {
+        case TEXT:
+            return QVariant(text_.toString());
+        case UTF8:
+            return QVariant(QString::fromUtf8(utf8_.data(), static_cast<int>(utf8_.size())));
+        case SIGNED:
+            return QVariant(signed_);
+        case UNSIGNED:
+            return QVariant(unsigned_);
+        default:
+            return QVariant(floating_);
+        }
+    }
+
+    // Exact conversions to the numeric key types; false when the value has
+    // no exact counterpart there.
+    bool toInt(int &out) const {
+        switch (kind_) {
+        case SIGNED:
+            if (signed_ < std::numeric_limits<int>::min() || signed_ > std::numeric_limits<int>::max()) return false;
+            out = static_cast<int>(signed_);
+            return true;
+        case UNSIGNED:
+            if (unsigned_ > static_cast<quint64>(std::numeric_limits<int>::max())) return false;
+            out = static_cast<int>(unsigned_);
+            return true;
+        case FLOATING:
+            // NaN fails both range checks
+            if (!(floating_ >= std::numeric_limits<int>::min() && floating_ <= std::numeric_limits<int>::max())) return false;
+            out = static_cast<int>(floating_);
+            return static_cast<double>(out) == floating_;
+        default:
+            return false;
+        }
+    }
+
+    bool toDouble(double &out) const {
+        switch (kind_) {
+        case SIGNED:
+            out = static_cast<double>(signed_);
+            // 2^63 itself rounds up out of range, so bound before casting back
+            return out < 0x1p63 && static_cast<qint64>(out) == signed_;
+        case UNSIGNED:
+            out = static_cast<double>(unsigned_);
+            return out < 0x1p64 && static_cast<quint64>(out) == unsigned_;
+        case FLOATING:
+            out = floating_;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool toFloat(float &out) const {
+        double d = 0.0;
+        if (!toDouble(d)) return false;
+        if (std::isfinite(d) && std::abs(d) > std::numeric_limits<float>::max()) return false;
+        out = static_cast<float>(d);
+        return static_cast<double>(out) == d;  // NaN never equals a key anyway
+    }
+
+private:
+    Kind kind_;
+    QStringView text_;
+    std::string_view utf8_;
+    qint64 signed_ = 0;
+    quint64 unsigned_ = 0;
+    double floating_ = 0.0;
+};
+
+// Decodes UTF-8 into out without allocating. Returns the number of UTF-16
+// units written, or -1 when they wouldn't fit in capacity or the input
+// isn't strictly valid UTF-8 (or starts with a BOM); callers then fall back
+// to QString::fromUtf8 so odd input decodes exactly as Qt would.
+inline int hashMapUtf8ToUtf16(std::string_view in, QChar *out, int capacity) {
+    const auto *p = reinterpret_cast<const unsigned char *>(in.data());
+    const auto *end = p + in.size();
+    if (in.size() >= 3 && p[0] == 0xef && p[1] == 0xbb && p[2] == 0xbf) return -1;
+    int n = 0;
+    while (p < end) {
+        char32_t c = *p++;
+        int extra = 0;
+        char32_t min = 0;
+        if (c < 0x80) {
+            extra = 0;
+        } else if ((c & 0xe0) == 0xc0) {
+            extra = 1;
+            min = 0x80;
+            c &= 0x1f;
+        } else if ((c & 0xf0) == 0xe0) {
+            extra = 2;
+            min = 0x800;
+            c &= 0x0f;
+        } else if ((c & 0xf8) == 0xf0) {
+            extra = 3;
+            min = 0x10000;
+            c &= 0x07;
+        } else {
+            return -1;
+        }
+        if (end - p < extra) return -1;
+        for (int i = 0; i < extra; ++i, ++p) {
+            if ((*p & 0xc0) != 0x80) return -1;
+            c = (c << 6) | (*p & 0x3f);
+        }
+        // Overlong forms, surrogates and values past U+10FFFF are invalid
+        if (c < min || (c >= 0xd800 && c <= 0xdfff) || c > 0x10ffff) return -1;
+        if (c >= 0x10000) {
+            if (n + 2 > capacity) return -1;
+            out[n++] = QChar::highSurrogate(c);
+            out[n++] = QChar::lowSurrogate(c);
+        } else {
+            if (n + 1 > capacity) return -1;
+            out[n++] = QChar(static_cast<char16_t>(c));
+        }
+    }
+    return n;
+}
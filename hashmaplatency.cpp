@@ -0,0 +1,40 @@
+#include "hashmaplatency.h"
+
+namespace {
+
+QJsonObject percentilesJson(const HashMapLatencyHistogram &histogram) {
+    QJsonObject json;
+    json["count"] = static_cast<double>(histogram.count());
+    json["mean_ns"] = histogram.meanNanos();
+    json["p50_ns"] = static_cast<double>(histogram.percentileNanos(0.50));
+    json["p90_ns"] = static_cast<double>(histogram.percentileNanos(0.90));
+    json["p99_ns"] = static_cast<double>(histogram.percentileNanos(0.99));
+    json["p99_9_ns"] = static_cast<double>(histogram.percentileNanos(0.999));
+    json["max_ns"] = static_cast<double>(histogram.maxNanos());
+    return json;
+}
+
+} // namespace
+
+QString HashMapLatencyProfile::operationName(Operation operation) {
+    switch (operation) {
+    case INSERT: return QStringLiteral("insert");
+    case PUT: return QStringLiteral("put");
+    case GET: return QStringLiteral("get");
+    case ERASE: return QStringLiteral("erase");
+    case FIND_BY_VALUE: return QStringLiteral("find_by_value");
+    case kOperationCount: break;
+    }
+    return QString();
+}
+
+QJsonObject HashMapLatencyProfile::toJson() const {
+    QJsonObject json;
+    for (int i = 0; i < kOperationCount; ++i) {
+        const Operation operation = static_cast<Operation>(i);
+        if (histogram(operation).count() == 0) continue;
+        json[operationName(operation)] = percentilesJson(histogram(operation));
+    }
+    if (resizing_.count() > 0) json["resizing"] = percentilesJson(resizing_);
+    return json;
+}
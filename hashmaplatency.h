@@ -0,0 +1,128 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QString>
+#include <QtAlgorithms>
+#include <QtGlobal>
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+// Log-linear latency histogram in nanoseconds. Each power of two is split
+// into kSubBuckets equal sub-buckets, so any recorded value is known to
+// within 1/kSubBuckets of itself (values below kSubBuckets exactly) from a
+// few kilobytes of counters. Recording is a bit scan, a shift and an
+// increment; histograms with the same layout merge by adding counters.
+class HashMapLatencyHistogram {
+public:
+    static constexpr int kSubBucketBits = 4;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+    // Values from 2^kMaxExponent ns (about 18 minutes) up land in the top bucket.
+    static constexpr int kMaxExponent = 40;
+    static constexpr int kBuckets = (kMaxExponent - kSubBucketBits + 1) * kSubBuckets;
+
+    void record(qint64 nanos) {
+        const quint64 value = static_cast<quint64>(std::max<qint64>(nanos, 0));
+        ++counts_[static_cast<size_t>(indexOf(value))];
+        if (count_ == 0 || value < min_) min_ = value;
+        max_ = std::max(max_, value);
+        sum_ += value;
+        ++count_;
+    }
+
+    void merge(const HashMapLatencyHistogram &other) {
+        if (other.count_ == 0) return;
+        for (size_t i = 0; i < counts_.size(); ++i) counts_[i] += other.counts_[i];
+        min_ = count_ ? std::min(min_, other.min_) : other.min_;
+        max_ = std::max(max_, other.max_);
+        sum_ += other.sum_;
+        count_ += other.count_;
+    }
+
+    void reset() { *this = HashMapLatencyHistogram(); }
+
+    quint64 count() const { return count_; }
+    qint64 minNanos() const { return static_cast<qint64>(min_); }
+    qint64 maxNanos() const { return static_cast<qint64>(max_); }
+    double meanNanos() const { return count_ ? static_cast<double>(sum_) / static_cast<double>(count_) : 0.0; }
+
+    // Highest value the bucket holding quantile q (0..1) can contain,
+    // capped at the largest value seen; 0 without samples.
+    qint64 percentileNanos(double q) const {
+        if (count_ == 0) return 0;
+        const double clamped = std::min(std::max(q, 0.0), 1.0);
+        const quint64 rank = std::max<quint64>(
+            1, static_cast<quint64>(std::ceil(clamped * static_cast<double>(count_))));
+        quint64 seen = 0;
+        for (int i = 0; i < kBuckets; ++i) {
+            seen += counts_[static_cast<size_t>(i)];
+            if (seen >= rank) return static_cast<qint64>(std::min(upperBoundOf(i), max_));
+        }
+        return static_cast<qint64>(max_);
+    }
+
+    // Bucket i holds [lowerBoundOf(i), upperBoundOf(i)].
+    static int indexOf(quint64 value) {
+        value = std::min(value, (quint64(1) << kMaxExponent) - 1);
+        if (value < static_cast<quint64>(kSubBuckets)) return static_cast<int>(value);
+        const int exponent = 63 - static_cast<int>(qCountLeadingZeroBits(value));
+        const int shift = exponent - kSubBucketBits;
+        return (shift + 1) * kSubBuckets + static_cast<int>(value >> shift) - kSubBuckets;
+    }
+    static quint64 lowerBoundOf(int index) {
+        if (index < kSubBuckets) return static_cast<quint64>(index);
+        const int shift = index / kSubBuckets - 1;
+        return static_cast<quint64>(kSubBuckets + index % kSubBuckets) << shift;
+    }
+    static quint64 upperBoundOf(int index) {
+        if (index < kSubBuckets) return static_cast<quint64>(index);
+        return lowerBoundOf(index) + (quint64(1) << (index / kSubBuckets - 1)) - 1;
+    }
+
+private:
+    std::array<quint64, kBuckets> counts_{};
+    quint64 count_ = 0;
+    quint64 min_ = 0;
+    quint64 max_ = 0;
+    quint64 sum_ = 0;
+};
+
+// Per-operation latency for HashMap::setLatencyTracking. Every timed
+// operation is recorded under its kind; those during which the table
+// started a resize are also recorded under resizing(), so growth spikes
+// show up as their own distribution instead of hiding in the tail.
+class HashMapLatencyProfile {
+public:
+    enum Operation { INSERT, PUT, GET, ERASE, FIND_BY_VALUE, kOperationCount };
+
+    void record(Operation operation, qint64 nanos, bool resized) {
+        operations_[static_cast<size_t>(operation)].record(nanos);
+        if (resized) resizing_.record(nanos);
+    }
+
+    // Adds other's samples, e.g. to combine several maps into one report.
+    void merge(const HashMapLatencyProfile &other) {
+        for (size_t i = 0; i < operations_.size(); ++i) operations_[i].merge(other.operations_[i]);
+        resizing_.merge(other.resizing_);
+    }
+
+    void reset() {
+        for (HashMapLatencyHistogram &histogram : operations_) histogram.reset();
+        resizing_.reset();
+    }
+
+    const HashMapLatencyHistogram &histogram(Operation operation) const {
+        return operations_[static_cast<size_t>(operation)];
+    }
+    const HashMapLatencyHistogram &resizing() const { return resizing_; }
+
+    static QString operationName(Operation operation);
+
+    // {"insert": {"count", "mean_ns", "p50_ns", "p90_ns", "p99_ns",
+    // "p99_9_ns", "max_ns"}, ...} for each operation seen, plus "resizing".
+    QJsonObject toJson() const;
+
+private:
+    std::array<HashMapLatencyHistogram, kOperationCount> operations_;
+    HashMapLatencyHistogram resizing_;
+};
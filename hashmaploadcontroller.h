@@ -0,0 +1,92 @@
+#pragma once
+
+#include <QtGlobal>
+#include <algorithm>
+#include <optional>
+
+// Adaptive growth threshold (HashMap::setAdaptiveLoadFactor). Every
+// kWindow keyed operations it compares what lookups actually cost with
+// what the same table would cost under a uniform hash:
+//
+//   compare ratio - key compares per successful lookup in the window,
+//                   over the backend's expectation at the current load
+//   dispersion    - variance over mean of the bucket sizes; 1 for the
+//                   Poisson spread of a uniform hash into chains, below 1
+//                   for the fixed-size buckets of the open backends
+//
+// The larger of the two is the skew. A skew above kSkewHigh lowers the
+// maximum load factor by kStep, so a clustered key set grows early; one
+// below kSkewLow raises it, so a well-spread key set packs denser. In
+// between it holds, which keeps noise from flipping it back and forth.
+// The limit never leaves [minLoad, maxLoad].
+//
+// The engine only asks when it checks for growth, the one place the limit
+// is used, so lookups pay nothing for it.
+class HashMapLoadController {
+public:
+    static constexpr int kWindow = 256;
+    // Fewer successful lookups than this leave the compare ratio out.
+    static constexpr int kMinHits = 32;
+    static constexpr float kStep = 0.05f;
+    static constexpr double kSkewHigh = 1.5;
+    static constexpr double kSkewLow = 1.15;
+
+    struct Decision {
+        float limit;           // new maximum load factor
+        double skew;
+        double compareRatio;   // 0 when the window had too few hits
+        double dispersion;
+    };
+
+    void configure(float minLoad, float maxLoad) {
+        minLoad_ = std::max(0.05f, std::min(minLoad, maxLoad));
+        maxLoad_ = std::max(minLoad_, maxLoad);
+    }
+    float minLoad() const { return minLoad_; }
+    float maxLoad() const { return maxLoad_; }
+    float clamp(float limit) const { return std::min(maxLoad_, std::max(minLoad_, limit)); }
+
+    double lastSkew() const { return lastSkew_; }
+
+    // Opens a window at the current totals.
+    void restartWindow(quint64 lookups, quint64 hits, quint64 hitCompares) {
+        windowLookups_ = lookups;
+        windowHits_ = hits;
+        windowHitCompares_ = hitCompares;
+    }
+
+    // Takes the engine's running lookup totals. Returns a decision when a
+    // window has closed and the limit should move, otherwise nothing.
+    std::optional<Decision> observe(quint64 lookups, quint64 hits, quint64 hitCompares,
+                                    double expectedHitCompares, double dispersion, float limit) {
+        if (lookups - windowLookups_ < static_cast<quint64>(kWindow)) return std::nullopt;
+        const quint64 windowHits = hits - windowHits_;
+        const quint64 windowCompares = hitCompares - windowHitCompares_;
+        restartWindow(lookups, hits, hitCompares);
+
+        double compareRatio = 0.0;
+        if (windowHits >= static_cast<quint64>(kMinHits) && expectedHitCompares > 0.0) {
+            compareRatio = static_cast<double>(windowCompares) / static_cast<double>(windowHits)
+                           / expectedHitCompares;
+        }
+        lastSkew_ = std::max(compareRatio, dispersion);
+
+        float next = limit;
+        if (lastSkew_ > kSkewHigh) {
+            next = clamp(limit - kStep);
+        } else if (lastSkew_ < kSkewLow) {
+            next = clamp(limit + kStep);
+        }
+        if (next == limit) return std::nullopt;
+        return Decision{next, lastSkew_, compareRatio, dispersion};
+    }
+
+private:
+    float minLoad_ = 0.5f;
+    float maxLoad_ = 1.0f;
+    double lastSkew_ = 0.0;
+    // Totals when the current window opened.
+    quint64 windowLookups_ = 0;
+    quint64 windowHits_ = 0;
+    quint64 windowHitCompares_ = 0;
+};
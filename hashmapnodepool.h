@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+// Fixed-size block allocator for one map's chain nodes. Blocks are carved
+// from slabs that double in size (up to kMaxSlabBlocks); freed blocks go on
+// an intrusive free list and are reused before the slab is bumped further.
+// release() hands every slab back at once, which is how clear() avoids one
+// free() per node.
+//
+// The block size is fixed by the first allocation; anything of another size
+// (which a std::forward_list never asks for) goes straight to operator new.
+class HashMapNodePool {
+public:
+    static constexpr size_t kFirstSlabBlocks = 32;
+    static constexpr size_t kMaxSlabBlocks = 4096;
+
+    HashMapNodePool() = default;
+    HashMapNodePool(const HashMapNodePool &) = delete;
+    HashMapNodePool &operator=(const HashMapNodePool &) = delete;
+
+    void *allocate(size_t size) {
+        if (blockSize_ == 0) blockSize_ = roundUp(std::max(size, sizeof(FreeBlock)));
+        if (!fits(size)) return ::operator new(size);
+
+        ++liveBlocks_;
+        if (freeList_) {
+            FreeBlock *block = freeList_;
+            freeList_ = block->next;
+            return block;
+        }
+        if (cursor_ == slabEnd_) addSlab();
+        void *block = cursor_;
+        cursor_ += blockSize_;
+        return block;
+    }
+
+    void deallocate(void *p, size_t size) {
+        if (!fits(size)) {
+            ::operator delete(p);
+            return;
+        }
+        --liveBlocks_;
+        freeList_ = ::new (p) FreeBlock{freeList_};
+    }
+
+    // Frees every slab. Only valid once all blocks have been deallocated.
+    void release() {
+        slabs_.clear();
+        freeList_ = nullptr;
+        cursor_ = slabEnd_ = nullptr;
+        bytesReserved_ = 0;
+    }
+
+    size_t bytesReserved() const { return bytesReserved_; }
+    size_t bytesLive() const { return liveBlocks_ * blockSize_; }
+    int slabCount() const { return static_cast<int>(slabs_.size()); }
+
+private:
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    std::vector<std::unique_ptr<std::max_align_t[]>> slabs_;
+    FreeBlock *freeList_ = nullptr;
+    unsigned char *cursor_ = nullptr;   // bump pointer into the newest slab
+    unsigned char *slabEnd_ = nullptr;
+    size_t blockSize_ = 0;
+    size_t liveBlocks_ = 0;
+    size_t bytesReserved_ = 0;
+
+    static size_t roundUp(size_t size) {
+        const size_t align = alignof(std::max_align_t);
+        return (size + align - 1) / align * align;
+    }
+
+    bool fits(size_t size) const { return roundUp(std::max(size, sizeof(FreeBlock))) == blockSize_; }
+
+    void addSlab() {
+        const size_t blocks = std::min(kMaxSlabBlocks, kFirstSlabBlocks << std::min<size_t>(slabs_.size(), 16));
+        const size_t bytes = blocks * blockSize_;
+        slabs_.emplace_back(new std::max_align_t[bytes / sizeof(std::max_align_t)]);
+        cursor_ = reinterpret_cast<unsigned char *>(slabs_.back().get());
+        slabEnd_ = cursor_ + bytes;
+        bytesReserved_ += bytes;
+    }
+};
+
+// std allocator adaptor so std::forward_list allocates its nodes from a
+// HashMapNodePool. Copies (and rebinds) share the pool, so lists built on
+// the same pool compare equal and can splice nodes between each other.
+template<typename T>
+class HashMapNodeAllocator {
+public:
+    using value_type = T;
+
+    explicit HashMapNodeAllocator(HashMapNodePool *pool) : pool_(pool) {}
+    template<typename U>
+    HashMapNodeAllocator(const HashMapNodeAllocator<U> &other) : pool_(other.pool()) {}
+
+    T *allocate(size_t n) {
+        if (n != 1) return static_cast<T *>(::operator new(n * sizeof(T)));
+        return static_cast<T *>(pool_->allocate(sizeof(T)));
+    }
+
+    void deallocate(T *p, size_t n) {
+        if (n != 1) {
+            ::operator delete(p);
+            return;
+        }
+        pool_->deallocate(p, sizeof(T));
+    }
+
+    HashMapNodePool *pool() const { return pool_; }
+
+    template<typename U>
+    bool operator==(const HashMapNodeAllocator<U> &other) const { return pool_ == other.pool(); }
+    template<typename U>
+    bool operator!=(const HashMapNodeAllocator<U> &other) const { return pool_ != other.pool(); }
+
+private:
+    HashMapNodePool *pool_;
+};
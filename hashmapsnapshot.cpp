@@ -0,0 +1,154 @@
+#include "hashmapsnapshot.h"
+#include "hashmap.h"
+#include "hashmaphash.h"
+
+#include <algorithm>
+#include <limits>
+
+const char HashMapSnapshot::kMagic[8] = {'A', 'D', 'V', 'D', 'S', 'H', 'M', '\0'};
+
+namespace {
+
+// The directory is padded so the entries start 8-byte aligned.
+quint64 directoryBytes(quint64 bucketCount) {
+    return ((bucketCount + 1) * sizeof(quint32) + 7) / 8 * 8;
+}
+
+bool fail(QString *error, const QString &message) {
+    if (error) *error = message;
+    return false;
+}
+
+bool validDataType(quint8 type) {
+    return type <= HashMap::CHAR;
+}
+
+// Anything else would stop the table from growing, or make sizing for it
+// overflow; NaN fails too.
+bool validMaxLoadFactor(float maxLoadFactor) {
+    return maxLoadFactor > 0.0f && maxLoadFactor <= 16.0f;
+}
+
+} // namespace
+
+HashMapSnapshot::~HashMapSnapshot() = default;
+
+std::shared_ptr<const HashMapSnapshot> HashMapSnapshot::open(const QString &path, QString *error) {
+    std::shared_ptr<HashMapSnapshot> snapshot(new HashMapSnapshot());
+    QFile &file = snapshot->file_;
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        fail(error, QStringLiteral("Cannot open %1").arg(path));
+        return nullptr;
+    }
+    const qint64 size = file.size();
+    if (size < static_cast<qint64>(sizeof(HashMapSnapshotHeader))) {
+        fail(error, QStringLiteral("%1 is not a HashMap snapshot").arg(path));
+        return nullptr;
+    }
+    const uchar *data = file.map(0, size);
+    if (!data) {
+        fail(error, QStringLiteral("Cannot map %1").arg(path));
+        return nullptr;
+    }
+
+    const auto *header = reinterpret_cast<const HashMapSnapshotHeader *>(data);
+    if (std::memcmp(header->magic, kMagic, sizeof kMagic) != 0) {
+        fail(error, QStringLiteral("%1 is not a HashMap snapshot").arg(path));
+        return nullptr;
+    }
+    if (header->byteOrder != kByteOrder) {
+        fail(error, QStringLiteral("Snapshot was written on a machine with another byte order"));
+        return nullptr;
+    }
+    if (header->version != kVersion) {
+        fail(error, QStringLiteral("Unsupported snapshot version %1").arg(header->version));
+        return nullptr;
+    }
+    if (!validDataType(header->keyType) || !validDataType(header->valueType) || header->backend > HashMap::COMPACT
+        || header->hashPolicy > HashMapHashing::SIMPLE
+        || header->bucketCount < 1 || header->entryCount > static_cast<quint64>(std::numeric_limits<int>::max())
+        || !validMaxLoadFactor(header->maxLoadFactor)) {
+        fail(error, QStringLiteral("Corrupt snapshot header"));
+        return nullptr;
+    }
+
+    const quint64 buckets = static_cast<quint64>(header->bucketCount);
+    const quint64 entriesOffset = sizeof(HashMapSnapshotHeader) + directoryBytes(buckets);
+    const quint64 stringsOffset = entriesOffset + header->entryCount * sizeof(HashMapSnapshotEntry);
+    if (header->stringUnits > static_cast<quint64>(size)
+        || stringsOffset + header->stringUnits * sizeof(char16_t) != static_cast<quint64>(size)) {
+        fail(error, QStringLiteral("Snapshot size doesn't match its header"));
+        return nullptr;
+    }
+
+    // One pass over the directory (not the entries) so lookups can trust it
+    const auto *directory = reinterpret_cast<const quint32 *>(data + sizeof(HashMapSnapshotHeader));
+    if (directory[0] != 0 || directory[buckets] != header->entryCount) {
+        fail(error, QStringLiteral("Corrupt snapshot directory"));
+        return nullptr;
+    }
+    for (quint64 b = 0; b < buckets; ++b) {
+        if (directory[b] > directory[b + 1]) {
+            fail(error, QStringLiteral("Corrupt snapshot directory"));
+            return nullptr;
+        }
+    }
+
+    snapshot->header_ = header;
+    snapshot->directory_ = directory;
+    snapshot->entries_ = reinterpret_cast<const HashMapSnapshotEntry *>(data + entriesOffset);
+    snapshot->strings_ = reinterpret_cast<const char16_t *>(data + stringsOffset);
+    return snapshot;
+}
+
+bool HashMapSnapshot::write(const QString &path, HashMapSnapshotHeader header,
+                            const std::vector<HashMapSnapshotEntry> &entries,
+                            const HashMapSnapshotStrings &strings, QString *error) {
+    if (entries.size() > static_cast<size_t>(std::numeric_limits<int>::max())
+        || strings.units().size() > std::numeric_limits<quint32>::max()) {
+        return fail(error, QStringLiteral("Too many entries for the snapshot format"));
+    }
+    std::memcpy(header.magic, kMagic, sizeof kMagic);
+    header.version = kVersion;
+    header.byteOrder = kByteOrder;
+    header.bucketCount = std::max(1, header.bucketCount);
+    header.entryCount = entries.size();
+    header.stringUnits = strings.units().size();
+
+    // Counting sort by bucket
+    const size_t buckets = static_cast<size_t>(header.bucketCount);
+    std::vector<quint32> directory(buckets + 1, 0);
+    for (const HashMapSnapshotEntry &e : entries) ++directory[e.hash % buckets + 1];
+    for (size_t b = 0; b < buckets; ++b) directory[b + 1] += directory[b];
+    std::vector<HashMapSnapshotEntry> grouped(entries.size());
+    std::vector<quint32> next(directory.begin(), directory.end() - 1);
+    for (const HashMapSnapshotEntry &e : entries) grouped[next[e.hash % buckets]++] = e;
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return fail(error, QStringLiteral("Cannot write %1").arg(path));
+    }
+    auto put = [&file](const void *data, quint64 bytes) {
+        return file.write(static_cast<const char *>(data), static_cast<qint64>(bytes)) == static_cast<qint64>(bytes);
+    };
+    const quint64 padding = directoryBytes(buckets) - directory.size() * sizeof(quint32);
+    const quint64 zero = 0;
+    const bool ok = put(&header, sizeof header)
+                    && put(directory.data(), directory.size() * sizeof(quint32))
+                    && put(&zero, padding)
+                    && put(grouped.data(), grouped.size() * sizeof(HashMapSnapshotEntry))
+                    && put(strings.units().data(), strings.units().size() * sizeof(char16_t));
+    if (!ok) {
+        file.remove();
+        return fail(error, QStringLiteral("Cannot write %1").arg(path));
+    }
+    return true;
+}
+
+QStringView HashMapSnapshot::stringView(quint64 slot) const {
+    const quint64 offset = slot >> 32;
+    const quint64 length = slot & 0xffffffffu;
+    if (offset + length > header_->stringUnits) return QStringView();
+    return QStringView(strings_ + offset, static_cast<qsizetype>(length));
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "hashmapstring.h"
+
+#include <QChar>
+#include <QFile>
+#include <QString>
+#include <QStringView>
+#include <QtGlobal>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// On-disk HashMap snapshot, read through a memory mapping.
+//
+//   header      64 bytes (HashMapSnapshotHeader)
+//   directory   bucketCount + 1 quint32: entries of bucket b are
+//               [directory[b], directory[b + 1])
+//   entries     entryCount fixed-width records, grouped by bucket
+//   strings     UTF-16 pool holding STRING keys and values
+//
+// Buckets are hash % bucketCount over the raw key hash, independent of the
+// backend. Each record keeps that hash, so a loaded map can move one bucket's
+// entries into its live table on first use without rehashing them, as long
+// as hashCheck shows the hash function hasn't changed since the save.
+// Integers are stored in the writer's byte order; byteOrder detects a
+// mismatch.
+
+struct HashMapSnapshotHeader {
+    char magic[8];
+    quint32 version;
+    quint32 byteOrder;
+    quint8 keyType;          // HashMap::DataType
+    quint8 valueType;
+    quint8 backend;          // HashMap::Backend
+    quint8 hashPolicy;       // HashMapHashing::Policy
+    qint32 bucketCount;      // directory buckets = live bucket count at save
+    quint64 entryCount;
+    quint64 hashSeed;
+    quint64 hashCheck;       // hash of the key type's probe key
+    float maxLoadFactor;     // (0, 16]
+    quint32 reserved1;
+    quint64 stringUnits;     // UTF-16 code units in the pool
+};
+static_assert(sizeof(HashMapSnapshotHeader) == 64, "snapshot header layout");
+
+// Key and value slots: the value itself for numeric types and QChar,
+// (pool offset << 32 | length) for strings.
+struct HashMapSnapshotEntry {
+    quint64 key;
+    quint64 value;
+    quint64 hash;
+};
+static_assert(sizeof(HashMapSnapshotEntry) == 24, "snapshot entry layout");
+
+// String pool being built by a writer.
+class HashMapSnapshotStrings {
+public:
+    quint64 add(QStringView s) {
+        const quint64 offset = units_.size();
+        const char16_t *data = s.utf16();
+        units_.insert(units_.end(), data, data + s.size());
+        return offset << 32 | static_cast<quint32>(s.size());
+    }
+    const std::vector<char16_t> &units() const { return units_; }
+
+private:
+    std::vector<char16_t> units_;
+};
+
+class HashMapSnapshot {
+public:
+    static constexpr quint32 kVersion = 1;
+    static constexpr quint32 kByteOrder = 0x01020304;
+    static const char kMagic[8];
+
+    ~HashMapSnapshot();
+
+    // Null on failure, with the reason in *error.
+    static std::shared_ptr<const HashMapSnapshot> open(const QString &path, QString *error = nullptr);
+
+    // Groups entries by header.bucketCount and writes the file. Fills in
+    // magic, version, byte order and the counts.
+    static bool write(const QString &path, HashMapSnapshotHeader header,
+                      const std::vector<HashMapSnapshotEntry> &entries,
+                      const HashMapSnapshotStrings &strings, QString *error = nullptr);
+
+    const HashMapSnapshotHeader &header() const { return *header_; }
+    int bucketCount() const { return header_->bucketCount; }
+    quint64 entryCount() const { return header_->entryCount; }
+    int bucketForHash(size_t hash) const { return static_cast<int>(hash % static_cast<size_t>(bucketCount())); }
+
+    quint32 bucketBegin(int bucket) const { return directory_[bucket]; }
+    quint32 bucketEnd(int bucket) const { return directory_[bucket + 1]; }
+    const HashMapSnapshotEntry &entry(quint32 index) const { return entries_[index]; }
+
+    // Empty for a slot outside the pool. The view points into the mapping.
+    QString string(quint64 slot) const { return stringView(slot).toString(); }
+    QStringView stringView(quint64 slot) const;
+
+private:
+    HashMapSnapshot() = default;
+
+    QFile file_;
+    const HashMapSnapshotHeader *header_ = nullptr;
+    const quint32 *directory_ = nullptr;
+    const HashMapSnapshotEntry *entries_ = nullptr;
+    const char16_t *strings_ = nullptr;
+};
+
+// Native value <-> snapshot slot, plus the probe key behind hashCheck.
+template<typename T>
+struct HashMapSnapshotCodec;
+
+template<>
+struct HashMapSnapshotCodec<int> {
+    static quint64 encode(int v, HashMapSnapshotStrings &) { return static_cast<quint32>(v); }
+    static int decode(quint64 slot, const HashMapSnapshot &) { return static_cast<int>(static_cast<quint32>(slot)); }
+    static int probe() { return 0x5eed; }
+};
+
+template<>
+struct HashMapSnapshotCodec<double> {
+    static quint64 encode(double v, HashMapSnapshotStrings &) {
+        quint64 bits;
+        std::memcpy(&bits, &v, sizeof bits);
+        return bits;
+    }
+    static double decode(quint64 slot, const HashMapSnapshot &) {
+        double v;
+        std::memcpy(&v, &slot, sizeof v);
+        return v;
+    }
+    static double probe() { return 0.5; }
+};
+
+template<>
+struct HashMapSnapshotCodec<float> {
+    static quint64 encode(float v, HashMapSnapshotStrings &) {
+        quint32 bits;
+        std::memcpy(&bits, &v, sizeof bits);
+        return bits;
+    }
+    static float decode(quint64 slot, const HashMapSnapshot &) {
+        const quint32 bits = static_cast<quint32>(slot);
+        float v;
+        std::memcpy(&v, &bits, sizeof v);
+        return v;
+    }
+    static float probe() { return 0.5f; }
+};
+
+template<>
+struct HashMapSnapshotCodec<QChar> {
+    static quint64 encode(QChar v, HashMapSnapshotStrings &) { return v.unicode(); }
+    static QChar decode(quint64 slot, const HashMapSnapshot &) { return QChar(static_cast<ushort>(slot)); }
+    static QChar probe() { return QChar('A'); }
+};
+
+template<>
+struct HashMapSnapshotCodec<HashMapString> {
+    static quint64 encode(const HashMapString &v, HashMapSnapshotStrings &strings) { return strings.add(v.view()); }
+    static HashMapString decode(quint64 slot, const HashMapSnapshot &snapshot) {
+        return HashMapString(snapshot.stringView(slot));
+    }
+    static HashMapString probe() { return HashMapString(QStringView(u"advds")); }
+};
@@ -0,0 +1,83 @@
+#include "hashmapstats.h"
+
+#include <QJsonArray>
+
+qint64 HashMapStats::latencyPercentileNanos(double q) const {
+    if (latencySamples == 0) return 0;
+    const double target = std::min(std::max(q, 0.0), 1.0) * static_cast<double>(latencySamples);
+    quint64 seen = 0;
+    for (int i = 0; i < kLatencyBuckets; ++i) {
+        seen += latencyHistogram[static_cast<size_t>(i)];
+        if (seen > 0 && static_cast<double>(seen) >= target) return qint64(1) << (i + 1);
+    }
+    return qint64(1) << kLatencyBuckets;
+}
+
+QJsonObject HashMapStats::toJson() const {
+    QJsonObject json;
+    json["size"] = size;
+    json["bucket_count"] = bucketCount;
+    json["load_factor"] = static_cast<double>(loadFactor);
+    json["rehashing"] = rehashing;
+    json["rehash_progress"] = static_cast<double>(rehashProgress());
+    json["node_bytes_reserved"] = static_cast<double>(nodeBytesReserved);
+    json["node_bytes_live"] = static_cast<double>(nodeBytesLive);
+    json["node_slabs"] = nodeSlabs;
+
+    QJsonArray chains;
+    for (int buckets : chainLengthHistogram) chains.append(buckets);
+    json["max_chain_length"] = maxChainLength;
+    json["chain_length_histogram"] = chains;
+    json["tree_buckets"] = treeBuckets;
+    json["stash_entries"] = stashEntries;
+    json["evictions"] = static_cast<double>(evictions);
+
+    json["successful_lookups"] = static_cast<double>(successfulLookups);
+    json["unsuccessful_lookups"] = static_cast<double>(unsuccessfulLookups);
+    json["avg_compares_successful"] = averageSuccessfulCompares();
+    json["avg_compares_unsuccessful"] = averageUnsuccessfulCompares();
+
+    json["max_load_factor"] = static_cast<double>(maxLoadFactor);
+    if (adaptiveLoadFactor) {
+        json["load_skew"] = loadSkew;
+        json["load_factor_raises"] = loadFactorRaises;
+        json["load_factor_lowers"] = loadFactorLowers;
+    }
+
+    json["rehash_count"] = rehashCount;
+    json["shrink_count"] = shrinkCount;
+    json["rehash_ms"] = static_cast<double>(rehashNanos) / 1e6;
+
+    if (bloomBytes > 0) {
+        json["bloom_bytes"] = static_cast<double>(bloomBytes);
+        json["bloom_hashes"] = bloomHashes;
+        json["bloom_rejected"] = static_cast<double>(bloomRejected);
+        json["bloom_passed_hits"] = static_cast<double>(bloomPassedHits);
+        json["bloom_false_positives"] = static_cast<double>(bloomFalsePositives);
+        json["bloom_false_positive_rate"] = bloomFalsePositiveRate();
+        json["bloom_rebuilds"] = bloomRebuilds;
+    }
+
+    // Only the populated range of the latency buckets, keyed by upper bound
+    QJsonArray latency;
+    int first = kLatencyBuckets, last = -1;
+    for (int i = 0; i < kLatencyBuckets; ++i) {
+        if (latencyHistogram[static_cast<size_t>(i)] == 0) continue;
+        first = std::min(first, i);
+        last = i;
+    }
+    for (int i = first; i <= last; ++i) {
+        QJsonObject bucket;
+        bucket["le_ns"] = static_cast<double>(qint64(1) << (i + 1));
+        bucket["count"] = static_cast<double>(latencyHistogram[static_cast<size_t>(i)]);
+        latency.append(bucket);
+    }
+    QJsonObject sampled;
+    sampled["sample_interval"] = latencySampleInterval;
+    sampled["samples"] = static_cast<double>(latencySamples);
+    sampled["p50_ns"] = static_cast<double>(latencyPercentileNanos(0.50));
+    sampled["p99_ns"] = static_cast<double>(latencyPercentileNanos(0.99));
+    sampled["histogram"] = latency;
+    json["latency"] = sampled;
+    return json;
+}
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QtGlobal>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+// Snapshot of a HashMap's shape, cheap enough to take after every operation.
+struct HashMapStats {
+    // Sampled latencies are bucketed by powers of two of nanoseconds.
+    static constexpr int kLatencyBuckets = 32;
+
+    int size = 0;
+    int bucketCount = 0;
+    float loadFactor = 0.0f;
+
+    // Incremental rehash (HashMap::setIncrementalRehash). While rehashing,
+    // bucketCount is the new table; rehashSourceBuckets old buckets are
+    // being migrated into it, rehashedBuckets of them already done.
+    bool rehashing = false;
+    int rehashSourceBuckets = 0;
+    int rehashedBuckets = 0;
+
+    // Node storage: bytes reserved from the allocator, bytes holding live
+    // entries, and how many slabs (separate allocations) back them.
+    size_t nodeBytesReserved = 0;
+    size_t nodeBytesLive = 0;
+    int nodeSlabs = 0;
+
+    // Chain lengths as bucketSizes() would report them, kept up to date on
+    // every change: chainLengthHistogram[n] is the number of buckets
+    // holding n entries. Snapshot entries not yet loaded aren't counted.
+    int maxChainLength = 0;
+    std::vector<int> chainLengthHistogram;
+    // Buckets currently stored as red-black trees (chaining backend).
+    int treeBuckets = 0;
+    // Cuckoo backend: entries parked in the overflow stash, and how many
+    // times an insert kicked an entry over to its other bucket.
+    int stashEntries = 0;
+    quint64 evictions = 0;
+
+    // Key compares made by lookups (get, insert/put and erase, single and
+    // batch) that found their key and that didn't. The Swiss backend only
+    // compares keys whose 7-bit tag matched.
+    quint64 successfulLookups = 0;
+    quint64 successfulLookupCompares = 0;
+    quint64 unsuccessfulLookups = 0;
+    quint64 unsuccessfulLookupCompares = 0;
+
+    // Growth threshold in force, and whether HashMap::setAdaptiveLoadFactor
+    // is steering it. The controller's last measured skew (1 = as a
+    // uniform hash would do) and how often it raised and lowered the limit.
+    float maxLoadFactor = 0.0f;
+    bool adaptiveLoadFactor = false;
+    double loadSkew = 0.0;
+    int loadFactorRaises = 0;
+    int loadFactorLowers = 0;
+
+    // Resizes (full or incremental) and the time spent moving entries,
+    // incremental migration steps included. shrinkCount of the resizes
+    // made the table smaller.
+    int rehashCount = 0;
+    int shrinkCount = 0;
+    qint64 rehashNanos = 0;
+
+    // Bloom filter (HashMap::setBloomFilterEnabled). Lookups and erases it
+    // turned away without visiting a bucket, and those it let through that
+    // found their key or didn't; the last are its false positives.
+    size_t bloomBytes = 0;
+    int bloomHashes = 0;
+    quint64 bloomRejected = 0;
+    quint64 bloomPassedHits = 0;
+    quint64 bloomFalsePositives = 0;
+    int bloomRebuilds = 0;
+
+    // One single-key operation in latencySampleInterval is timed;
+    // latencyHistogram[i] counts samples that took [2^i, 2^(i+1)) ns.
+    int latencySampleInterval = 0;
+    quint64 latencySamples = 0;
+    std::array<quint64, kLatencyBuckets> latencyHistogram{};
+
+    float rehashProgress() const {
+        if (!rehashing || rehashSourceBuckets == 0) return 1.0f;
+        return static_cast<float>(rehashedBuckets) / static_cast<float>(rehashSourceBuckets);
+    }
+
+    double averageSuccessfulCompares() const {
+        return successfulLookups ? static_cast<double>(successfulLookupCompares) / successfulLookups : 0.0;
+    }
+    double averageUnsuccessfulCompares() const {
+        return unsuccessfulLookups ? static_cast<double>(unsuccessfulLookupCompares) / unsuccessfulLookups : 0.0;
+    }
+    // Share of absent keys the filter failed to turn away.
+    double bloomFalsePositiveRate() const {
+        const quint64 absent = bloomRejected + bloomFalsePositives;
+        return absent ? static_cast<double>(bloomFalsePositives) / absent : 0.0;
+    }
+
+    // Upper bound of the histogram bucket holding quantile q (0..1), or 0
+    // without samples.
+    qint64 latencyPercentileNanos(double q) const;
+
+    QJsonObject toJson() const;
+};
+
+// Counters behind the instrumentation part of HashMapStats, updated by the
+// engine as it works. Every update is O(1).
+class HashMapStatsRecorder {
+public:
+    static constexpr int kLatencySampleInterval = 64;
+
+    static qint64 nowNanos() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Times one operation if it is due for sampling.
+    class LatencySample {
+    public:
+        explicit LatencySample(HashMapStatsRecorder &recorder)
+            : recorder_(recorder.countLookups_ && --recorder.untilNextSample_ == 0 ? &recorder : nullptr),
+            start_(recorder_ ? nowNanos() : 0) {}
+        ~LatencySample() {
+            if (recorder_) recorder_->recordLatency(nowNanos() - start_);
+        }
+        LatencySample(const LatencySample &) = delete;
+        LatencySample &operator=(const LatencySample &) = delete;
+
+    private:
+        HashMapStatsRecorder *recorder_;
+        qint64 start_;
+    };
+
+    // Starts the chain counts over for a table of bucketCount empty buckets.
+    void resetChains(int bucketCount) {
+        chainLengths_.assign(static_cast<size_t>(bucketCount), 0);
+        chainHistogram_.assign(1, bucketCount);
+        maxChain_ = 0;
+    }
+    int chainBuckets() const { return static_cast<int>(chainLengths_.size()); }
+
+    void addToChain(int bucket) {
+        int &length = chainLengths_[static_cast<size_t>(bucket)];
+        --chainHistogram_[static_cast<size_t>(length)];
+        if (++length == static_cast<int>(chainHistogram_.size())) chainHistogram_.push_back(0);
+        ++chainHistogram_[static_cast<size_t>(length)];
+        if (length > maxChain_) maxChain_ = length;
+    }
+
+    void removeFromChain(int bucket) {
+        int &length = chainLengths_[static_cast<size_t>(bucket)];
+        if (length == 0) return;
+        --chainHistogram_[static_cast<size_t>(length)];
+        ++chainHistogram_[static_cast<size_t>(length - 1)];
+        if (length == maxChain_ && chainHistogram_[static_cast<size_t>(length)] == 0) --maxChain_;
+        --length;
+    }
+
+    // Off, lookups leave the recorder untouched: lookup and latency
+    // counters stay at zero and concurrent readers share it safely.
+    // Changes (chains, resizes) are still counted.
+    void setLookupCounting(bool enabled) { countLookups_ = enabled; }
+
+    void recordLookup(bool found, int compares) {
+        if (!countLookups_) return;
+        if (found) {
+            ++hits_;
+            hitCompares_ += static_cast<quint64>(compares);
+        } else {
+            ++misses_;
+            missCompares_ += static_cast<quint64>(compares);
+        }
+    }
+
+    void recordEviction() { ++evictions_; }
+    void recordRehashStart() { ++rehashCount_; }
+    void recordShrink() { ++shrinkCount_; }
+    void recordRehashTime(qint64 nanos) { rehashNanos_ += nanos; }
+
+    void recordBloomReject() {
+        if (countLookups_) ++bloomRejected_;
+    }
+    void recordBloomPass(bool found) {
+        if (countLookups_) ++(found ? bloomPassedHits_ : bloomFalsePositives_);
+    }
+    void recordBloomRebuild() { ++bloomRebuilds_; }
+    void recordLoadAdjustment(bool raised) { ++(raised ? loadRaises_ : loadLowers_); }
+
+    // Running totals the adaptive load controller windows over.
+    quint64 lookups() const { return hits_ + misses_; }
+    quint64 hits() const { return hits_; }
+    quint64 hitCompares() const { return hitCompares_; }
+    int rehashCount() const { return rehashCount_; }
+
+    // Variance over mean of the bucket sizes (0 for an empty table).
+    double chainDispersion() const {
+        double entries = 0.0, squares = 0.0;
+        for (size_t n = 1; n < chainHistogram_.size(); ++n) {
+            const double buckets = chainHistogram_[n];
+            entries += buckets * static_cast<double>(n);
+            squares += buckets * static_cast<double>(n) * static_cast<double>(n);
+        }
+        if (entries == 0.0 || chainLengths_.empty()) return 0.0;
+        const double count = static_cast<double>(chainLengths_.size());
+        const double mean = entries / count;
+        return (squares / count - mean * mean) / mean;
+    }
+
+    void recordLatency(qint64 nanos) {
+        untilNextSample_ = kLatencySampleInterval;
+        int bucket = 0;
+        for (quint64 v = static_cast<quint64>(std::max<qint64>(nanos, 1)); v > 1; v >>= 1) ++bucket;
+        ++latency_[static_cast<size_t>(std::min(bucket, HashMapStats::kLatencyBuckets - 1))];
+        ++latencySamples_;
+    }
+
+    void fill(HashMapStats &stats) const {
+        stats.maxChainLength = maxChain_;
+        // Trailing zeros past the longest chain are left off
+        stats.chainLengthHistogram.assign(chainHistogram_.begin(),
+                                          chainHistogram_.begin() + std::min(chainHistogram_.size(),
+                                                                             static_cast<size_t>(maxChain_) + 1));
+        stats.successfulLookups = hits_;
+        stats.successfulLookupCompares = hitCompares_;
+        stats.unsuccessfulLookups = misses_;
+        stats.unsuccessfulLookupCompares = missCompares_;
+        stats.evictions = evictions_;
+        stats.rehashCount = rehashCount_;
+        stats.shrinkCount = shrinkCount_;
+        stats.bloomRejected = bloomRejected_;
+        stats.bloomPassedHits = bloomPassedHits_;
+        stats.bloomFalsePositives = bloomFalsePositives_;
+        stats.bloomRebuilds = bloomRebuilds_;
+        stats.loadFactorRaises = loadRaises_;
+        stats.loadFactorLowers = loadLowers_;
+        stats.rehashNanos = rehashNanos_;
+        stats.latencySampleInterval = kLatencySampleInterval;
+        stats.latencySamples = latencySamples_;
+        stats.latencyHistogram = latency_;
+    }
+
+private:
+    std::vector<int> chainLengths_;    // per bucket
+    std::vector<int> chainHistogram_;  // buckets per chain length
+    int maxChain_ = 0;
+    quint64 hits_ = 0;
+    quint64 hitCompares_ = 0;
+    quint64 misses_ = 0;
+    quint64 missCompares_ = 0;
+    quint64 evictions_ = 0;
+    int rehashCount_ = 0;
+    int shrinkCount_ = 0;
+    quint64 bloomRejected_ = 0;
+    quint64 bloomPassedHits_ = 0;
+    quint64 bloomFalsePositives_ = 0;
+    int bloomRebuilds_ = 0;
+    int loadRaises_ = 0;
+    int loadLowers_ = 0;
+    qint64 rehashNanos_ = 0;
+    bool countLookups_ = true;
+    int untilNextSample_ = kLatencySampleInterval;
+    quint64 latencySamples_ = 0;
+    std::array<quint64, HashMapStats::kLatencyBuckets> latency_{};
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "hashmaphash.h"
+
+#include <QChar>
+#include <QString>
+#include <QStringView>
+#include <QtGlobal>
+#include <algorithm>
+#include <utility>
+
+// String storage for STRING keys and values. Up to kInlineUnits UTF-16
+// units live inside the object itself; longer text gets one exact-size
+// heap block, without QString's shared header or spare capacity. Short
+// identifiers, the common case, therefore cost no allocation and no
+// pointer chase, and a node holds its text where the hash and compare
+// read it.
+//
+// It is converted to and from QString only at the QVariant boundary;
+// lookups hash and compare it as a QStringView, so it matches any UTF-16
+// view of the same text.
+class HashMapString {
+public:
+    static constexpr int kInlineUnits = 11;
+
+    HashMapString() noexcept { small_.tag = 0; }
+
+    explicit HashMapString(QStringView text) { assign(text.utf16(), static_cast<int>(text.size())); }
+    explicit HashMapString(const QString &text) : HashMapString(QStringView(text)) {}
+
+    HashMapString(const HashMapString &other) { assign(other.units(), other.size()); }
+
+    HashMapString(HashMapString &&other) noexcept { moveFrom(other); }
+
+    HashMapString &operator=(const HashMapString &other) {
+        if (this != &other) {
+            HashMapString copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    HashMapString &operator=(HashMapString &&other) noexcept {
+        HashMapString moved(std::move(other));
+        swap(moved);
+        return *this;
+    }
+
+    ~HashMapString() {
+        if (isHeap()) delete[] large_.data;
+    }
+
+    void swap(HashMapString &other) noexcept {
+        HashMapString tmp(std::move(other));
+        other.moveFrom(*this);
+        moveFrom(tmp);
+    }
+
+    int size() const { return isHeap() ? large_.size : small_.tag; }
+    bool isEmpty() const { return size() == 0; }
+    bool isInline() const { return !isHeap(); }
+    QStringView view() const { return QStringView(units(), size()); }
+    QString toString() const { return view().toString(); }
+
+    friend bool operator==(const HashMapString &a, const HashMapString &b) { return a.view() == b.view(); }
+    friend bool operator!=(const HashMapString &a, const HashMapString &b) { return !(a == b); }
+    friend bool operator<(const HashMapString &a, const HashMapString &b) { return a.view() < b.view(); }
+    friend bool operator==(const HashMapString &a, QStringView b) { return a.view() == b; }
+    friend bool operator==(QStringView a, const HashMapString &b) { return a == b.view(); }
+    friend bool operator<(const HashMapString &a, QStringView b) { return a.view() < b; }
+    friend bool operator<(QStringView a, const HashMapString &b) { return a < b.view(); }
+
+private:
+    static constexpr quint8 kHeap = 0xFF;
+
+    // Both layouts begin with the tag: the inline length, or kHeap.
+    struct Small {
+        quint8 tag;
+        char16_t units[kInlineUnits];
+    };
+    struct Large {
+        quint8 tag;
+        qint32 size;
+        char16_t *data;
+    };
+    union {
+        Small small_;
+        Large large_;
+    };
+
+    bool isHeap() const { return small_.tag == kHeap; }
+    const char16_t *units() const { return isHeap() ? large_.data : small_.units; }
+
+    // Takes over other's text; this must hold nothing.
+    void moveFrom(HashMapString &other) noexcept {
+        if (other.isHeap()) {
+            large_ = other.large_;
+        } else {
+            small_ = other.small_;
+        }
+        other.small_.tag = 0;
+    }
+
+    void assign(const char16_t *text, int length) {
+        if (length <= kInlineUnits) {
+            small_.tag = static_cast<quint8>(length);
+            std::copy(text, text + length, small_.units);
+        } else {
+            large_.tag = kHeap;
+            large_.size = length;
+            large_.data = new char16_t[static_cast<size_t>(length)];
+            std::copy(text, text + length, large_.data);
+        }
+    }
+};
+
+static_assert(sizeof(HashMapString) == 24, "HashMapString should stay three words");
+
+template<>
+struct HashMapHash<HashMapString> {
+    HashMapHashing hashing;
+
+    HashMapHash() = default;
+    explicit HashMapHash(HashMapHashing hashing) : hashing(hashing) {}
+
+    // Same hash as the QString it was made from.
+    size_t operator()(const HashMapString &key) const { return (*this)(key.view()); }
+    size_t operator()(QStringView key) const { return HashMapHash<QString>(hashing)(key); }
+};
@@ -0,0 +1,404 @@
+#include "hashmaptrace.h"
+#include "hashmap.h"
+
+#include <algorithm>
+#include <limits>
+
+HashMapTrace::HashMapTrace() = default;
+
+HashMapTrace::~HashMapTrace() = default;
+
+void HashMapTrace::addText(const QString &text) {
+    if (level_ == OFF) return;
+    texts_.append(text);
+    HashMapTraceEvent event;
+    event.opcode = TEXT;
+    event.a = static_cast<qint32>(texts_.size() - 1);
+    events_.append(event);
+}
+
+void HashMapTrace::setCapacity(int lines) {
+    lines = std::max(4, lines);
+    if (lines == capacity_) return;
+    const QVector<QString> window = steps();
+    capacity_ = lines;
+    ring_.clear();
+    // Re-append under the new capacity; overflow is evicted as usual.
+    endLine_ = firstInMemory_;
+    for (const QString &line : window) appendLine(line);
+}
+
+bool HashMapTrace::setSpillFile(const QString &path) {
+    // Lines spilled to the old file go with it
+    if (!spillSegments_.isEmpty()) firstAvailable_ = std::max(firstAvailable_, firstInMemory_);
+    spill_.reset();
+    spillSegments_.clear();
+    spillSize_ = 0;
+    spillPath_ = path;
+    if (path.isEmpty()) return true;
+
+    auto file = std::make_unique<QFile>(path);
+    if (!file->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        spillPath_.clear();
+        return false;
+    }
+    spill_ = std::move(file);
+    return true;
+}
+
+qint64 HashMapTrace::firstLine() const {
+    formatPending();
+    return firstAvailable_;
+}
+
+qint64 HashMapTrace::endLine() const {
+    formatPending();
+    return endLine_;
+}
+
+QVector<QString> HashMapTrace::readSteps(qint64 cursor, int maxCount) const {
+    formatPending();
+    QVector<QString> lines;
+    cursor = std::max(cursor, firstAvailable_);
+    const qint64 end = std::min(endLine_, cursor + std::max(0, maxCount));
+    if (cursor >= end) return lines;
+    lines.reserve(static_cast<int>(end - cursor));
+
+    if (cursor < firstInMemory_) {
+        lines = readSpilled(cursor, std::min(end, firstInMemory_));
+        cursor = firstInMemory_;
+    }
+    for (qint64 line = cursor; line < end; ++line) {
+        lines.append(ring_[static_cast<int>(line % capacity_)]);
+    }
+    return lines;
+}
+
+QVector<QString> HashMapTrace::steps() const {
+    formatPending();
+    return readSteps(firstInMemory_, capacity_);
+}
+
+void HashMapTrace::reset() {
+    events_.clear();
+    operands_.clear();
+    texts_.clear();
+    detailSteps_ = 0;
+    elidedSteps_ = 0;
+    ring_.clear();
+    firstInMemory_ = endLine_;
+    firstAvailable_ = endLine_;
+    ++epoch_;
+    if (spill_) {
+        spill_->resize(0);
+        spill_->seek(0);
+        spillSegments_.clear();
+        spillSize_ = 0;
+    }
+}
+
+void HashMapTrace::appendLine(const QString &line) const {
+    if (ring_.size() != capacity_) ring_.resize(capacity_);
+    if (endLine_ - firstInMemory_ >= capacity_) evictSegment();
+    ring_[static_cast<int>(endLine_ % capacity_)] = line;
+    ++endLine_;
+}
+
+void HashMapTrace::evictSegment() const {
+    const qint64 count = std::max(1, capacity_ / 4);
+    QByteArray bytes;
+    for (qint64 line = firstInMemory_; line < firstInMemory_ + count; ++line) {
+        QString &slot = ring_[static_cast<int>(line % capacity_)];
+        if (spill_) {
+            // One step per line in the spill file
+            bytes.append(QString(slot).replace(QChar('\n'), QChar(' ')).toUtf8());
+            bytes.append('\n');
+        }
+        slot = QString();
+    }
+    if (!spill_) {
+        firstAvailable_ = firstInMemory_ + count;
+    } else if (spill_->write(bytes) == bytes.size()) {
+        spillSegments_.append(qMakePair(firstInMemory_, spillSize_));
+        spillSize_ += bytes.size();
+    } else {
+        // Drop whatever part of the segment made it out, so the offsets
+        // of the segments before and after stay right; failing that, go
+        // on from wherever the file ended up. The segment itself is lost
+        // and reads back as placeholders, its neighbours stay readable.
+        if (!spill_->resize(spillSize_) || !spill_->seek(spillSize_)) spillSize_ = spill_->pos();
+        spillSegments_.append(qMakePair(firstInMemory_, qint64(-1)));
+    }
+    firstInMemory_ += count;
+}
+
+// Always returns to - from lines: any the file can't give back come out
+// as placeholders, so callers' cursors stay in step.
+QVector<QString> HashMapTrace::readSpilled(qint64 from, qint64 to) const {
+    const QString lost = QStringLiteral("(step lost: the spill file could not be written or read)");
+    QVector<QString> lines;
+    lines.reserve(static_cast<int>(to - from));
+    if (!spillSegments_.isEmpty()) {
+        if (spill_) spill_->flush();
+
+        // Last segment starting at or before `from`
+        auto segment = std::upper_bound(spillSegments_.cbegin(), spillSegments_.cend(), from,
+                                        [](qint64 line, const QPair<qint64, qint64> &s) { return line < s.first; });
+        if (segment != spillSegments_.cbegin()) --segment;
+
+        QFile reader(spillPath_);
+        const bool readable = reader.open(QIODevice::ReadOnly);
+        for (; segment != spillSegments_.cend() && from < to; ++segment) {
+            for (; from < std::min(segment->first, to); ++from) lines.append(lost);
+            const auto next = segment + 1;
+            const qint64 segmentEnd = std::min(to, next != spillSegments_.cend() ? next->first : firstInMemory_);
+            if (segment->second >= 0 && readable && reader.seek(segment->second)) {
+                for (qint64 line = segment->first; line < segmentEnd && !reader.atEnd(); ++line) {
+                    QByteArray bytes = reader.readLine();
+                    if (line < from) continue;
+                    if (bytes.endsWith('\n')) bytes.chop(1);
+                    lines.append(QString::fromUtf8(bytes));
+                    ++from;
+                }
+            }
+            for (; from < segmentEnd; ++from) lines.append(lost);
+        }
+    }
+    for (; from < to; ++from) lines.append(lost);
+    return lines;
+}
+
+void HashMapTrace::recordElided() const {
+    if (elidedSteps_ == 0) return;
+    HashMapTraceEvent event;
+    event.opcode = STEPS_ELIDED;
+    event.a = static_cast<qint32>(std::min<qint64>(elidedSteps_, std::numeric_limits<qint32>::max()));
+    events_.append(event);
+    elidedSteps_ = 0;
+}
+
+void HashMapTrace::formatPending() const {
+    recordElided();
+    if (events_.isEmpty()) return;
+    for (const HashMapTraceEvent &event : events_) {
+        format(event);
+    }
+    events_.clear();
+    operands_.clear();
+    texts_.clear();
+}
+
+QString HashMapTrace::operandText(qint32 index) const {
+    return HashMap::variantToDisplayString(operands_[index]);
+}
+
+void HashMapTrace::format(const HashMapTraceEvent &e) const {
+    switch (e.opcode) {
+    case OP_BEGIN:
+        switch (e.flags) {
+        case INSERT_OP: appendLine(QStringLiteral("=== INSERT OPERATION ===")); break;
+        case PUT_OP: appendLine(QStringLiteral("=== PUT OPERATION ===")); break;
+        case SEARCH_OP: appendLine(QStringLiteral("=== SEARCH OPERATION ===")); break;
+        case DELETE_OP: appendLine(QStringLiteral("=== DELETE OPERATION ===")); break;
+        case VALUE_SEARCH_OP: appendLine("🔍 === SEARCH BY VALUE OPERATION ==="); break;
+        case BATCH_INSERT_OP: appendLine(QStringLiteral("=== BATCH INSERT OPERATION ===")); break;
+        case BATCH_PUT_OP: appendLine(QStringLiteral("=== BATCH PUT OPERATION ===")); break;
+        case BATCH_GET_OP: appendLine(QStringLiteral("=== BATCH SEARCH OPERATION ===")); break;
+        case BATCH_ERASE_OP: appendLine(QStringLiteral("=== BATCH DELETE OPERATION ===")); break;
+        case RESIZE_OP: appendLine(QStringLiteral("=== RESIZE OPERATION ===")); break;
+        }
+        break;
+    case OP_END:
+        appendLine("--- Operation Complete ---");
+        break;
+    case TEXT:
+        appendLine(texts_[e.a]);
+        break;
+    case TYPE_MISMATCH:
+        appendLine(QStringLiteral("Type validation failed"));
+        break;
+    case HASH: {
+        // Show hash calculation based on type
+        const QString keyStr = operandText(e.a);
+        if (e.flags) {
+            appendLine(QString("📊 Compute: hash(%1) = %1").arg(keyStr));
+            appendLine(QString("📐 Calculate: %1 % %2 = %3").arg(keyStr).arg(e.b).arg(e.bucket));
+        } else {
+            appendLine(QString("📊 Compute hash for: \"%1\"").arg(keyStr));
+            appendLine(QString("📐 Index = hash % %1 = %2").arg(e.b).arg(e.bucket));
+        }
+        break;
+    }
+    case VISIT_BUCKET:
+        appendLine(e.flags ? QString("🎯 Visit bucket %1").arg(e.bucket)
+                           : QStringLiteral("Visit bucket %1").arg(e.bucket));
+        break;
+    case COMPARE:
+        appendLine(QStringLiteral("Compare keys: %1 == %2 ? %3")
+                       .arg(operandText(e.a), operandText(e.b),
+                            (e.flags & 1) ? QStringLiteral("Yes") : QStringLiteral("No")));
+        if (!(e.flags & 1)) {
+            appendLine((e.flags & 2) ? QStringLiteral("Descend to the next tree level")
+                                     : QStringLiteral("Traverse next in chain"));
+        }
+        break;
+    case UPDATE:
+        appendLine(QStringLiteral("Key exists → update value: %1 → %2").arg(operandText(e.a), operandText(e.b)));
+        break;
+    case DUPLICATE:
+        appendLine(QStringLiteral("Key exists → no insert (duplicate)"));
+        break;
+    case APPEND:
+        appendLine(QStringLiteral("Append new node to bucket %1").arg(e.bucket));
+        break;
+    case SIZE:
+        appendLine((e.flags ? QStringLiteral("Erased node. New size = %1, load factor = %2")
+                            : QStringLiteral("New size = %1, load factor = %2"))
+                       .arg(e.a)
+                       .arg(e.x, 0, 'f', 2));
+        break;
+    case FOUND:
+        appendLine(QStringLiteral("Found → return value %1").arg(operandText(e.a)));
+        break;
+    case NOT_FOUND:
+        appendLine(e.flags ? QStringLiteral("Reached end of chain → key not found")
+                           : QStringLiteral("Reached end of chain → not found"));
+        break;
+    case VALUE_TARGET:
+        appendLine(QString("🎯 Target value: %1").arg(operandText(e.a)));
+        appendLine(e.flags == 1 ? QString("📝 Algorithm: Reverse index lookup (value → keys)")
+                   : e.flags == 2 ? QString("📝 Algorithm: Linear scan of the entry array, in insertion order")
+                                  : QString("📝 Algorithm: Linear search through all buckets"));
+        break;
+    case VALUE_BUCKET:
+        appendLine(e.flags ? QString("   Bucket %1 is empty").arg(e.bucket)
+                           : QString("🔎 Checking bucket %1...").arg(e.bucket));
+        break;
+    case VALUE_COMPARE:
+        appendLine(QString("   Comparing: <%1,%2> value == %3?")
+                       .arg(operandText(e.a), operandText(e.a + 1), operandText(e.b)));
+        break;
+    case VALUE_FOUND:
+        appendLine(QString("✅ FOUND! Value '%1' at:").arg(operandText(e.a)));
+        appendLine(QString("   📍 Bucket: %1").arg(e.bucket));
+        appendLine(QString("   🔑 Key: %1").arg(operandText(e.b)));
+        appendLine(e.flags == 2
+                       ? QString("   📊 %1 keys hold this value; the first indexed is returned").arg(e.ordinal)
+                       : QString("   📊 Total items checked: %1").arg(e.ordinal));
+        break;
+    case VALUE_NOT_FOUND:
+        appendLine(QString("❌ NOT FOUND: Value '%1' not in any bucket").arg(operandText(e.a)));
+        appendLine(e.flags ? QString("📊 Value index has no entry for it")
+                           : QString("📊 Total items checked: %1 across %2 buckets").arg(e.ordinal).arg(e.b));
+        break;
+    case GROW:
+        if (e.flags) {
+            appendLine(QStringLiteral("Cuckoo stash full (%1 entries) → rehash to %2 buckets").arg(e.b).arg(e.a));
+            break;
+        }
+        appendLine(QStringLiteral("Load factor %1 exceeds %2 → rehash to %3 buckets")
+                       .arg(e.x, 0, 'f', 2)
+                       .arg(e.y, 0, 'f', 2)
+                       .arg(e.a));
+        break;
+    case LOAD_ADAPT:
+        appendLine(e.flags ? QStringLiteral("📐 Lookups cost %1× a uniform hash → raise max load factor to %2")
+                                 .arg(e.y, 0, 'f', 2).arg(e.x, 0, 'f', 2)
+                           : QStringLiteral("📐 Lookups cost %1× a uniform hash → lower max load factor to %2")
+                                 .arg(e.y, 0, 'f', 2).arg(e.x, 0, 'f', 2));
+        break;
+    case SHRINK:
+        appendLine(e.flags ? QStringLiteral("Shrink to fit %1 buckets").arg(e.a)
+                           : QStringLiteral("Load factor %1 below %2 → shrink to %3 buckets")
+                                 .arg(e.x, 0, 'f', 2)
+                                 .arg(e.y, 0, 'f', 2)
+                                 .arg(e.a));
+        break;
+    case REHASH:
+        appendLine((e.flags ? QStringLiteral("Incremental rehash to %1 buckets started")
+                            : QStringLiteral("Rehashing to %1 buckets"))
+                       .arg(e.a));
+        break;
+    case MOVE:
+        appendLine(QStringLiteral("Move (%1,%2) → bucket %3")
+                       .arg(operandText(e.a), operandText(e.a + 1))
+                       .arg(e.bucket));
+        break;
+    case REHASH_STEP:
+        appendLine(e.flags ? QStringLiteral("Incremental rehash complete (%1 old buckets migrated)").arg(e.b)
+                           : QStringLiteral("Incremental rehash: migrated %1/%2 old buckets").arg(e.a).arg(e.b));
+        break;
+    case RESERVE:
+        appendLine(QStringLiteral("Reserve(%1) → rehash to %2 buckets").arg(e.a).arg(e.b));
+        break;
+    case BATCH: {
+        appendLine(QStringLiteral("📊 Hashed %1 keys up front, resolved with bucket prefetch").arg(e.a));
+        const int others = e.a - e.b;
+        switch (e.flags) {
+        case BATCH_INSERT_OP:
+            appendLine(QStringLiteral("%1 inserted, %2 duplicates skipped").arg(e.b).arg(others));
+            break;
+        case BATCH_PUT_OP:
+            appendLine(QStringLiteral("%1 inserted, %2 updated").arg(e.b).arg(others));
+            break;
+        case BATCH_GET_OP:
+            appendLine(QStringLiteral("%1 found, %2 not found").arg(e.b).arg(others));
+            break;
+        case BATCH_ERASE_OP:
+            appendLine(QStringLiteral("%1 erased, %2 not found").arg(e.b).arg(others));
+            break;
+        }
+        if (e.ordinal > 0) appendLine(QStringLiteral("%1 keys rejected (type mismatch)").arg(e.ordinal));
+        break;
+    }
+    case SNAPSHOT:
+        switch (e.flags) {
+        case 0:
+            appendLine(QStringLiteral("Mapped snapshot: %1 entries in %2 buckets (materialized on first use)")
+                           .arg(e.a).arg(e.b));
+            break;
+        case 1:
+            appendLine(QStringLiteral("Mapped snapshot: %1 entries; hash function changed → rehashing every key")
+                           .arg(e.a));
+            break;
+        case 2:
+            appendLine(QStringLiteral("Materialized %1 snapshot entries for snapshot bucket %2").arg(e.a).arg(e.bucket));
+            break;
+        default:
+            appendLine(QStringLiteral("Snapshot fully materialized"));
+            break;
+        }
+        break;
+    case TREEIFY:
+        appendLine(e.flags ? QStringLiteral("🌳 Bucket %1 shrank to %2 entries → converted back to a chain")
+                                 .arg(e.bucket).arg(e.a)
+                           : QStringLiteral("🌳 Bucket %1 grew to %2 entries → converted to a red-black tree")
+                                 .arg(e.bucket).arg(e.a));
+        break;
+    case TREE_SEARCH:
+        appendLine(QStringLiteral("🌳 Bucket %1 is a red-black tree → binary search by (hash, key)").arg(e.bucket));
+        break;
+    case BLOOM_REJECT:
+        appendLine(QStringLiteral("🌸 Bloom filter: %1 is certainly absent → bucket %2 not visited")
+                       .arg(operandText(e.a)).arg(e.bucket));
+        break;
+    case CUCKOO_BUCKETS:
+        appendLine(QStringLiteral("🐦 Key can only be in bucket %1 or %2 (or the stash)").arg(e.bucket).arg(e.a));
+        break;
+    case EVICT:
+        appendLine(e.flags ? QStringLiteral("🐦 Kick %1: %2 evicted from bucket %3 → eviction path too long, parked in the stash")
+                                 .arg(e.ordinal + 1).arg(operandText(e.a)).arg(e.bucket)
+                           : QStringLiteral("🐦 Kick %1: %2 evicted from bucket %3 → moves to bucket %4")
+                                 .arg(e.ordinal + 1).arg(operandText(e.a)).arg(e.bucket).arg(e.b));
+        break;
+    case NO_EXACT_KEY:
+        appendLine(QStringLiteral("No key of this type equals %1 → not found").arg(operandText(e.a)));
+        break;
+    case CLEARED:
+        appendLine(QStringLiteral("Cleared all buckets"));
+        break;
+    case STEPS_ELIDED:
+        appendLine(QStringLiteral("… %1 more steps not recorded").arg(e.a));
+        break;
+    }
+}
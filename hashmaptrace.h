@@ -0,0 +1,188 @@
+#pragma once
+
+#include <QFile>
+#include <QPair>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+#include <QtGlobal>
+#include <memory>
+
+// One recorded HashMap step. Plain data: no strings are built while an
+// operation runs. Operand fields index into HashMapTrace's operand pool.
+struct HashMapTraceEvent {
+    quint8 opcode = 0;
+    quint8 flags = 0;    // result / message variant
+    qint32 bucket = -1;
+    qint32 ordinal = 0;  // node position within the chain walk
+    qint32 a = 0;
+    qint32 b = 0;
+    float x = 0.0f;
+    float y = 0.0f;
+};
+
+// Step trace shared by HashMap and its engine. Events are appended as POD
+// records and turned into the human-readable lines shown by the visualizer
+// only when the history is read.
+//
+//   OFF     - nothing is recorded
+//   SUMMARY - one line per decision (hash, bucket, result, resize)
+//   FULL    - additionally every key compare, node move and bucket scan
+//
+// FULL detail is budgeted per operation: once one operation has recorded
+// capacity() detail steps (a rehash moving every node, a value scan over
+// every entry) the rest are only counted and summed up in one line.
+//
+// Formatted lines live in a fixed-capacity ring. Every line gets a
+// monotonically increasing number, which readers use as a cursor. When the
+// ring is full the oldest quarter is evicted in one segment: appended to the
+// spill file if one is set (and paged back in by readSteps()), dropped
+// otherwise.
+class HashMapTrace {
+public:
+    enum Level {
+        OFF,
+        SUMMARY,
+        FULL
+    };
+
+    enum Opcode : quint8 {
+        OP_BEGIN,           // flags = OperationKind
+        OP_END,
+        TEXT,               // a = text index
+        TYPE_MISMATCH,
+        HASH,               // a = key, b = bucket count, flags = numeric key
+        VISIT_BUCKET,       // flags = 1 for the search-style line
+        COMPARE,            // a = node key, b = probe key, flags = matched | 2 in a tree bucket
+        UPDATE,             // a = old value, b = new value
+        DUPLICATE,
+        APPEND,
+        SIZE,               // a = size, x = load factor, flags = 1 after erase
+        FOUND,              // a = value
+        NOT_FOUND,          // flags = 1 for the erase wording
+        VALUE_TARGET,       // a = value, flags = 1 when using the value index, 2 for a dense entry scan
+        VALUE_BUCKET,       // flags = 1 when the bucket was empty
+        VALUE_COMPARE,      // a = key (value at a + 1), b = target
+        VALUE_FOUND,        // a = target, b = key, ordinal = items checked; flags = 2 from the value
+                            // index, ordinal = keys holding the value
+        VALUE_NOT_FOUND,    // a = target, ordinal = items checked, b = buckets, flags = indexed
+        GROW,               // a = new bucket count, x = load, y = max load; flags = 1 when a
+                            // full cuckoo stash (b entries) forced it
+        SHRINK,             // a = new bucket count, x = load, y = min load; flags = 1 for shrinkToFit()
+        LOAD_ADAPT,         // x = new max load, y = skew; flags = 1 when raised
+        REHASH,             // a = new bucket count, flags = 1 if incremental
+        MOVE,               // a = key (value at a + 1)
+        REHASH_STEP,        // a = old buckets migrated, b = old bucket count, flags = done
+        RESERVE,            // a = expected elements, b = bucket count
+        BATCH,              // flags = OperationKind, a = keys, b = inserted/found/erased, ordinal = rejected
+        SNAPSHOT,           // flags: 0 mapped (a = entries, b = buckets), 1 mapped + rehashed,
+                            //        2 bucket materialized (a = entries), 3 fully materialized
+        TREEIFY,            // a = entries, flags = 1 when converted back to a chain
+        TREE_SEARCH,        // the visited bucket is a red-black tree
+        NO_EXACT_KEY,       // a = lookup key with no exact counterpart in the key type
+        CUCKOO_BUCKETS,     // bucket = primary, a = alternate bucket
+        BLOOM_REJECT,       // a = key, bucket = its bucket (not visited)
+        EVICT,              // a = key kicked out of bucket into bucket b, ordinal = kick, flags = 1 if stashed
+        CLEARED,
+        STEPS_ELIDED        // a = detail steps over the operation's budget
+    };
+
+    enum OperationKind : quint8 {
+        INSERT_OP,
+        PUT_OP,
+        SEARCH_OP,
+        DELETE_OP,
+        VALUE_SEARCH_OP,
+        BATCH_INSERT_OP,
+        BATCH_PUT_OP,
+        BATCH_GET_OP,
+        BATCH_ERASE_OP,
+        RESIZE_OP           // rehash(), reserve(), shrinkToFit()
+    };
+
+    static constexpr int kDefaultCapacity = 4096;
+
+    HashMapTrace();
+    ~HashMapTrace();
+
+    void setLevel(Level level) { level_ = level; }
+    Level level() const { return level_; }
+    bool wants(Level level) const { return level_ >= level; }
+    // For one FULL detail step: false below FULL and, past the operation's
+    // budget, counts the step as elided instead. Ask before building its
+    // operands.
+    bool wantsDetail() {
+        if (level_ < FULL) return false;
+        if (detailSteps_ >= capacity_) {
+            ++elidedSteps_;
+            return false;
+        }
+        ++detailSteps_;
+        return true;
+    }
+
+    // Unread events are formatted at the next operation boundary once as
+    // many are pending as the ring holds, so a trace nobody reads stays
+    // bounded too. (Operand indices stay valid within an operation.)
+    void record(const HashMapTraceEvent &event) {
+        if (event.opcode == OP_BEGIN || event.opcode == OP_END) {
+            recordElided();
+            detailSteps_ = 0;
+        }
+        if (event.opcode == OP_BEGIN && events_.size() >= capacity_) formatPending();
+        events_.append(event);
+    }
+    qint32 addOperand(const QVariant &operand) {
+        operands_.append(operand);
+        return static_cast<qint32>(operands_.size() - 1);
+    }
+    void addText(const QString &text);
+
+    // History window
+    void setCapacity(int lines);
+    int capacity() const { return capacity_; }
+    // Empty path disables spilling. Returns false if the file can't be opened.
+    bool setSpillFile(const QString &path);
+    QString spillFile() const { return spillPath_; }
+
+    qint64 firstLine() const;       // oldest line still readable
+    qint64 endLine() const;         // one past the newest line
+    int epoch() const { return epoch_; }  // bumped by reset()
+
+    // Up to maxCount lines starting at cursor (clamped to firstLine()).
+    QVector<QString> readSteps(qint64 cursor, int maxCount) const;
+    // The lines currently held in memory, oldest first.
+    QVector<QString> steps() const;
+
+    // Drops all history, in memory and spilled. Line numbers keep counting.
+    void reset();
+
+private:
+    Level level_ = FULL;
+    // Pending until the next read formats and drops them.
+    mutable QVector<HashMapTraceEvent> events_;
+    mutable QVector<QVariant> operands_;
+    mutable QVector<QString> texts_;
+    int detailSteps_ = 0;             // in the current operation
+    mutable qint64 elidedSteps_ = 0;  // not yet reported by a STEPS_ELIDED event
+
+    int capacity_ = kDefaultCapacity;
+    mutable QVector<QString> ring_;  // line n lives at ring_[n % capacity_]
+    mutable qint64 firstInMemory_ = 0;
+    mutable qint64 firstAvailable_ = 0;
+    mutable qint64 endLine_ = 0;
+    int epoch_ = 0;
+
+    QString spillPath_;
+    mutable std::unique_ptr<QFile> spill_;
+    mutable QVector<QPair<qint64, qint64>> spillSegments_;  // (first line, byte offset or -1 if lost)
+    mutable qint64 spillSize_ = 0;
+
+    void recordElided() const;
+    void formatPending() const;
+    void format(const HashMapTraceEvent &event) const;
+    void appendLine(const QString &line) const;
+    void evictSegment() const;
+    QVector<QString> readSpilled(qint64 from, qint64 to) const;
+    QString operandText(qint32 index) const;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "hashmapcore.h"
+
+#include <QtGlobal>
+#include <functional>
+#include <map>
+#include <unordered_map>
+
+// Optional reverse index value -> keys holding it, so HashMap can answer
+// findByValue() without scanning every bucket. The engine keeps it in step
+// with every insert, update, erase and clear; rehashing doesn't change any
+// (key, value) pair, so it needs no maintenance there.
+//
+// Each value's keys are kept in the order they were indexed (a key whose
+// value is updated counts as indexed anew), so firstKeyFor() answers the
+// same way every time rather than with whichever key a hash set yields.
+template<typename K, typename V>
+class HashMapValueIndex {
+public:
+    void add(const V &value, const K &key) {
+        const quint64 order = nextOrder_++;
+        keysByValue_[value].emplace(order, key);
+        orderOf_[key] = order;
+    }
+
+    void remove(const V &value, const K &key) {
+        auto order = orderOf_.find(key);
+        if (order == orderOf_.end()) return;
+        auto it = keysByValue_.find(value);
+        if (it != keysByValue_.end()) {
+            it->second.erase(order->second);
+            if (it->second.empty()) keysByValue_.erase(it);
+        }
+        orderOf_.erase(order);
+    }
+
+    void clear() {
+        keysByValue_.clear();
+        orderOf_.clear();
+    }
+
+    // The earliest indexed key currently mapped to value, or nullptr.
+    const K *firstKeyFor(const V &value) const {
+        auto it = keysByValue_.find(value);
+        if (it == keysByValue_.end()) return nullptr;
+        return &it->second.begin()->second;
+    }
+
+    int keyCount(const V &value) const {
+        auto it = keysByValue_.find(value);
+        return it == keysByValue_.end() ? 0 : static_cast<int>(it->second.size());
+    }
+
+private:
+    std::unordered_map<V, std::map<quint64, K>, HashMapHash<V>> keysByValue_;
+    std::unordered_map<K, quint64, HashMapHash<K>> orderOf_;  // keys are unique in the map
+    quint64 nextOrder_ = 0;
+};
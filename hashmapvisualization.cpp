@@ -5,12 +5,50 @@
 #include <QFontDatabase>
 #include <QDebug>
 #include <QMessageBox>
+#include <QFileDialog>
 #include <QRandomGenerator>
 #include <QGraphicsDropShadowEffect>
 #include <QScrollBar>
 #include <QSplitterHandle>
+#include <algorithm>
 #include <memory>
 
+namespace {
+
+// 850 ns, 12.4 us, 3.10 ms
+QString formatNanos(qint64 nanos)
+{
+    if (nanos < 1000) return QString("%1 ns").arg(nanos);
+    if (nanos < 1000000) return QString("%1 us").arg(nanos / 1e3, 0, 'f', 1);
+    return QString("%1 ms").arg(nanos / 1e6, 0, 'f', 2);
+}
+
+// Fonts of the bucket drawing, built once instead of per item.
+struct BucketFonts {
+    QFont index{"Segoe UI", 14};
+    QFont entry{"Segoe UI", 8};
+    QFont arrow{"Segoe UI", 10};
+    QFont empty{"Segoe UI", 9};
+    QFont tree{"Segoe UI", 8};
+    QFont title{"Segoe UI", 16};
+
+    BucketFonts() {
+        index.setBold(true);
+        entry.setBold(true);
+        arrow.setBold(true);
+        empty.setItalic(true);
+        tree.setBold(true);
+        title.setBold(true);
+    }
+};
+
+const BucketFonts &bucketFonts()
+{
+    static const BucketFonts fonts;
+    return fonts;
+}
+
+} // namespace
 
 // Define static constants
 const int HashMapVisualization::BUCKET_WIDTH = 80;
@@ -18,10 +56,17 @@ const int HashMapVisualization::BUCKET_HEIGHT = 60;
 const int HashMapVisualization::BUCKET_SPACING = 10;
 const int HashMapVisualization::CHAIN_ITEM_HEIGHT = 25;
 const int HashMapVisualization::MAX_VISIBLE_BUCKETS = 12;
+const int HashMapVisualization::MAX_TRACE_ROWS = 1000;
 
 HashMapVisualization::HashMapVisualization(QWidget *parent)
     : QWidget(parent)
-    , hashMap(new HashMap(8, 10.0f))  // 8 buckets, high load factor to prevent rehashing
+    // 8 buckets, high load factor to prevent rehashing; textbook hashes so
+    // students can follow the bucket arithmetic
+    , hashMap(new HashMap(8, 10.0f, HashMap::CHAINING, HashMapHashing{HashMapHashing::SIMPLE, 0}))
+    , nextStepToShow(0)
+    , shownStepEpoch(0)
+    , vizTitle(nullptr)
+    , drawnEpoch(0)
     , animationTimer(new QTimer(this))
     , highlightRect(nullptr)
 {
@@ -177,6 +222,7 @@ void HashMapVisualization::setupStatsTopLeft()
     sizeLabel = new QLabel("Size: 0");
     bucketCountLabel = new QLabel(QString("Buckets: %1").arg(hashMap->bucketCount()));
     loadFactorLabel = new QLabel("Load Factor: 0.00");
+    chainStatsLabel = new QLabel("Max chain: 0");
     QString statsStyle = R"(
         QLabel {
             color: #34495e;
@@ -193,12 +239,19 @@ void HashMapVisualization::setupStatsTopLeft()
     sizeLabel->setStyleSheet(statsStyle);
     bucketCountLabel->setStyleSheet(statsStyle);
     loadFactorLabel->setStyleSheet(statsStyle);
+    chainStatsLabel->setStyleSheet(statsStyle);
 
     statsLayout->addWidget(sizeLabel);
     statsLayout->addWidget(bucketCountLabel);
     statsLayout->addWidget(loadFactorLabel);
+    statsLayout->addWidget(chainStatsLabel);
     statsLayout->addStretch();
     leftLayout->addLayout(statsLayout);
+
+    latencyLabel = new QLabel();
+    latencyLabel->setStyleSheet(statsStyle);
+    latencyLabel->setVisible(false);
+    leftLayout->addWidget(latencyLabel);
 }
 
 void HashMapVisualization::setupRightPanel()
@@ -528,6 +581,11 @@ void HashMapVisualization::setupControls()
     deleteButton = new QPushButton("Delete");
     clearButton = new QPushButton("Clear");
     randomizeButton = new QPushButton("Random");
+    saveButton = new QPushButton("Save");
+    loadButton = new QPushButton("Load");
+    latencyButton = new QPushButton("Latency");
+    latencyButton->setCheckable(true);
+    latencyButton->setToolTip("Time every operation and show live latency percentiles");
 
     QString buttonStyle = R"(
         QPushButton {
@@ -544,6 +602,10 @@ void HashMapVisualization::setupControls()
             background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
                 stop:0 #6c3cff, stop:1 #8b5fff);
         }
+        QPushButton:checked {
+            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
+                stop:0 #4a2bb8, stop:1 #6c3cff);
+        }
     )";
 
     insertButton->setStyleSheet(buttonStyle);
@@ -551,6 +613,9 @@ void HashMapVisualization::setupControls()
     deleteButton->setStyleSheet(buttonStyle);
     clearButton->setStyleSheet(buttonStyle);
     randomizeButton->setStyleSheet(buttonStyle);
+    saveButton->setStyleSheet(buttonStyle);
+    loadButton->setStyleSheet(buttonStyle);
+    latencyButton->setStyleSheet(buttonStyle);
 
     buttonLayout1->addWidget(insertButton);
     buttonLayout1->addWidget(searchButton);
@@ -558,6 +623,9 @@ void HashMapVisualization::setupControls()
 
     buttonLayout2->addWidget(clearButton);
     buttonLayout2->addWidget(randomizeButton);
+    buttonLayout2->addWidget(saveButton);
+    buttonLayout2->addWidget(loadButton);
+    buttonLayout2->addWidget(latencyButton);
 
     controlLayout->addLayout(buttonLayout1);
     controlLayout->addLayout(buttonLayout2);
@@ -568,6 +636,9 @@ void HashMapVisualization::setupControls()
     connect(deleteButton, &QPushButton::clicked, this, &HashMapVisualization::onDeleteClicked);
     connect(clearButton, &QPushButton::clicked, this, &HashMapVisualization::onClearClicked);
     connect(randomizeButton, &QPushButton::clicked, this, &HashMapVisualization::onRandomizeClicked);
+    connect(saveButton, &QPushButton::clicked, this, &HashMapVisualization::onSaveClicked);
+    connect(loadButton, &QPushButton::clicked, this, &HashMapVisualization::onLoadClicked);
+    connect(latencyButton, &QPushButton::toggled, this, &HashMapVisualization::onLatencyToggled);
 
     rightLayout->addWidget(controlGroup);
 }
@@ -597,6 +668,7 @@ void HashMapVisualization::setupStats()
     sizeLabel = new QLabel("Size: 0");
     bucketCountLabel = new QLabel(QString("Buckets: %1").arg(hashMap->bucketCount()));
     loadFactorLabel = new QLabel("Load: 0.00");
+    chainStatsLabel = new QLabel("Max chain: 0");
 
     QString statsStyle = R"(
         QLabel {
@@ -610,10 +682,12 @@ void HashMapVisualization::setupStats()
     sizeLabel->setStyleSheet(statsStyle);
     bucketCountLabel->setStyleSheet(statsStyle);
     loadFactorLabel->setStyleSheet(statsStyle);
+    chainStatsLabel->setStyleSheet(statsStyle);
 
     statsLayout->addWidget(sizeLabel);
     statsLayout->addWidget(bucketCountLabel);
     statsLayout->addWidget(loadFactorLabel);
+    statsLayout->addWidget(chainStatsLabel);
 
     rightLayout->addWidget(statsGroup);
 }
@@ -666,133 +740,195 @@ void HashMapVisualization::setupStepTrace()
 
 void HashMapVisualization::drawBuckets()
 {
-    // Clear existing visualization
-    scene->clear();
-    bucketRects.clear();
-    bucketTexts.clear();
-    chainTexts.clear();
+    // Draw the whole table, not just what operations have loaded so far.
+    // Materializing can resize, so do it before asking what changed.
+    if (hashMap->pendingSnapshotEntries() > 0) hashMap->materializeSnapshot();
 
     const int bucketCount = hashMap->bucketCount();
-    const QVector<int> bucketSizes = hashMap->bucketSizes();
-    const QVector<QVector<QPair<QVariant, QVariant>>> bucketContents = hashMap->getBucketContents();
-
-    // Calculate layout for all buckets in a single row
     const int totalWidth = bucketCount * (BUCKET_WIDTH + BUCKET_SPACING) - BUCKET_SPACING;
     const int startX = -totalWidth / 2;
 
-    bucketRects.resize(bucketCount);
-    bucketTexts.resize(bucketCount);
-    chainTexts.resize(bucketCount);
-
-    for (int i = 0; i < bucketCount; ++i) {
-        const int x = startX + i * (BUCKET_WIDTH + BUCKET_SPACING);
-        const int y = 0;
+    if (!vizTitle) {
+        vizTitle = scene->addText("Hash Table (Open Chaining)");
+        vizTitle->setFont(bucketFonts().title);
+        vizTitle->setDefaultTextColor(QColor(44, 62, 80));
+    }
 
-        // Calculate dynamic bucket height based on content
-        int bucketHeight = BUCKET_HEIGHT;
-        if (i < bucketContents.size() && !bucketContents[i].isEmpty()) {
-            bucketHeight = BUCKET_HEIGHT + (bucketContents[i].size() * 30); // 30px per item
+    if (bucketItems.size() != bucketCount) {
+        // New bucket count: every bucket moves and every entry was
+        // rehashed, so lay the row out again and refill all of it.
+        while (bucketItems.size() > bucketCount) {
+            recycleEntries(bucketItems.last());
+            delete bucketItems.last().frame;
+            bucketItems.removeLast();
+        }
+        while (bucketItems.size() < bucketCount) {
+            bucketItems.append(createBucketItems(static_cast<int>(bucketItems.size())));
+        }
+        for (int i = 0; i < bucketCount; ++i) {
+            bucketItems[i].frame->setPos(startX + i * (BUCKET_WIDTH + BUCKET_SPACING), 0);
+            refreshBucket(i);
+        }
+        vizTitle->setPos(startX, -120);
+    } else {
+        const QVector<int> changed = hashMap->bucketsChangedSince(drawnEpoch);
+        for (int bucket : changed) {
+            refreshBucket(bucket);
         }
+    }
+    drawnEpoch = hashMap->modificationEpoch();
 
-        // Create bucket with dynamic height
-        QGraphicsPathItem *bucketPath = new QGraphicsPathItem();
-        QPainterPath path;
-        path.addRoundedRect(QRectF(x, y, BUCKET_WIDTH, bucketHeight), 12, 12);
-        bucketPath->setPath(path);
+    // Keep no more spares than there are live entries, so clearing or
+    // shrinking a large table gives its items back instead of holding
+    // them for the life of the widget.
+    while (spareEntries.size() > hashMap->size()) {
+        delete spareEntries.takeLast().background;  // text and arrow are its children
+    }
 
-        // Set gradient brush for bucket
-        QLinearGradient bucketGradient(x, y, x, y + bucketHeight);
-        if (bucketSizes[i] > 0) {
-            // Filled bucket - purple gradient
-            bucketGradient.setColorAt(0.0, QColor(123, 79, 255, 15));
-            bucketGradient.setColorAt(1.0, QColor(123, 79, 255, 25));
-        } else {
-            // Empty bucket - light gradient
-            bucketGradient.setColorAt(0.0, QColor(255, 255, 255, 200));
-            bucketGradient.setColorAt(1.0, QColor(250, 248, 255, 200));
-        }
-        bucketPath->setBrush(QBrush(bucketGradient));
-        bucketPath->setPen(QPen(QColor(123, 79, 255, 120), 2.5));
-        scene->addItem(bucketPath);
-
-        // Bucket index label
-        QGraphicsTextItem *indexText = scene->addText(QString::number(i));
-        indexText->setPos(x + BUCKET_WIDTH/2 - 8, y - 35);
-        indexText->setDefaultTextColor(QColor(45, 27, 105));
-        QFont indexFont("Segoe UI", 14);
-        indexFont.setBold(true);
-        indexText->setFont(indexFont);
-
-        // Show data directly inside the bucket
-        QVector<QGraphicsTextItem*> chainItems;
-        if (i < bucketContents.size()) {
-            const auto &items = bucketContents[i];
-            for (int j = 0; j < items.size(); ++j) {
-                const int itemY = y + 10 + j * 30; // Items stacked vertically inside bucket
-
-                // Chain item background inside bucket
-                QGraphicsPathItem *itemBgPath = new QGraphicsPathItem();
-                QPainterPath itemPath;
-                itemPath.addRoundedRect(QRectF(x + 4, itemY, BUCKET_WIDTH - 8, 25), 6, 6);
-                itemBgPath->setPath(itemPath);
-                itemBgPath->setBrush(QBrush(QColor(255, 255, 255, 180)));
-                itemBgPath->setPen(QPen(QColor(123, 79, 255, 100), 1.5));
-                itemBgPath->setZValue(1);
-                scene->addItem(itemBgPath);
-
-                // Chain item text with actual key-value pair
-                const QVariant &key = items[j].first;
-                const QVariant &value = items[j].second;
-                QString keyStr = HashMap::variantToDisplayString(key);
-                QString valueStr = HashMap::variantToDisplayString(value);
-                QString displayText = QString("%1→%2").arg(keyStr.left(4), valueStr.left(4));
-
-                QGraphicsTextItem *chainItem = scene->addText(displayText);
-                chainItem->setPos(x + 6, itemY + 2);
-                chainItem->setDefaultTextColor(QColor(45, 27, 105));
-                QFont chainFont("Segoe UI", 8);
-                chainFont.setBold(true);
-                chainItem->setFont(chainFont);
-                chainItem->setZValue(2);
-                chainItems.append(chainItem);
-
-                // Add chain link arrow for multiple items
-                if (j > 0) {
-                    QGraphicsTextItem *arrow = scene->addText("↓");
-                    arrow->setPos(x + BUCKET_WIDTH/2 - 5, itemY - 15);
-                    arrow->setDefaultTextColor(QColor(123, 79, 255, 150));
-                    QFont arrowFont("Segoe UI", 10);
-                    arrowFont.setBold(true);
-                    arrow->setFont(arrowFont);
-                    arrow->setZValue(2);
-                }
-            }
-        }
-        chainTexts[i] = chainItems;
+    // Scene rect from the layout, with padding, rather than from the
+    // bounding rect of every item
+    int tallest = BUCKET_HEIGHT;
+    for (const BucketItems &items : bucketItems) {
+        tallest = std::max(tallest, items.height);
+    }
+    const qreal right = std::max<qreal>(startX + totalWidth, startX + vizTitle->boundingRect().width());
+    scene->setSceneRect(QRectF(QPointF(startX - 60, -120 - 100), QPointF(right + 60, tallest + 30 + 80)));
+}
 
-        // Empty bucket label
-        if (bucketSizes[i] == 0) {
-            QGraphicsTextItem *emptyText = scene->addText("empty");
-            emptyText->setPos(x + BUCKET_WIDTH/2 - 15, y + BUCKET_HEIGHT/2 - 10);
-            emptyText->setDefaultTextColor(QColor(150, 150, 150));
-            QFont emptyFont("Segoe UI", 9);
-            emptyFont.setItalic(true);
-            emptyText->setFont(emptyFont);
-            emptyText->setZValue(2);
-        }
+HashMapVisualization::BucketItems HashMapVisualization::createBucketItems(int bucket)
+{
+    const BucketFonts &fonts = bucketFonts();
+    BucketItems items;
+    items.frame = new QGraphicsPathItem();
+    scene->addItem(items.frame);
+
+    // Bucket index label
+    QGraphicsTextItem *indexText = new QGraphicsTextItem(QString::number(bucket), items.frame);
+    indexText->setPos(BUCKET_WIDTH/2 - 8, -35);
+    indexText->setDefaultTextColor(QColor(45, 27, 105));
+    indexText->setFont(fonts.index);
+
+    // Empty bucket label
+    items.emptyText = new QGraphicsTextItem("empty", items.frame);
+    items.emptyText->setPos(BUCKET_WIDTH/2 - 15, BUCKET_HEIGHT/2 - 10);
+    items.emptyText->setDefaultTextColor(QColor(150, 150, 150));
+    items.emptyText->setFont(fonts.empty);
+    items.emptyText->setZValue(2);
+
+    items.treeText = new QGraphicsTextItem("🌳 RB tree", items.frame);
+    items.treeText->setDefaultTextColor(QColor(39, 174, 96));
+    items.treeText->setFont(fonts.tree);
+    items.treeText->setToolTip("Chain passed 8 entries: stored as a red-black tree ordered by (hash, key), "
+                               "shown in sorted order. Turns back into a chain at 6 entries.");
+    return items;
+}
+
+// Redraws one bucket in place: its outline, labels and entries.
+void HashMapVisualization::refreshBucket(int bucket)
+{
+    BucketItems &items = bucketItems[bucket];
+    recycleEntries(items);
+
+    // Show data directly inside the bucket
+    const bool treeBucket = hashMap->isTreeBucket(bucket);
+    int j = 0;
+    hashMap->forEachInBucket(bucket, [&](const QVariant &key, const QVariant &value) {
+        EntryItems entry = takeEntryItems();
+        entry.background->setParentItem(items.frame);
+        entry.background->setPos(4, 10 + j * 30); // Items stacked vertically inside bucket
+
+        // Chain item text with actual key-value pair
+        QString keyStr = HashMap::variantToDisplayString(key);
+        QString valueStr = HashMap::variantToDisplayString(value);
+        entry.text->setPlainText(QString("%1→%2").arg(keyStr.left(4), valueStr.left(4)));
+
+        // Chain link arrow for multiple items (tree entries are listed in
+        // order, not linked)
+        entry.arrow->setVisible(j > 0 && !treeBucket);
+        items.entries.append(entry);
+        ++j;
+    });
+
+    // Dynamic bucket height based on content: 30px per item
+    const int bucketHeight = BUCKET_HEIGHT + j * 30;
+    items.height = bucketHeight;
+
+    QPainterPath path;
+    path.addRoundedRect(QRectF(0, 0, BUCKET_WIDTH, bucketHeight), 12, 12);
+    items.frame->setPath(path);
+
+    // Gradient brush for the bucket; treeified buckets are green
+    QLinearGradient bucketGradient(0, 0, 0, bucketHeight);
+    if (treeBucket) {
+        bucketGradient.setColorAt(0.0, QColor(39, 174, 96, 20));
+        bucketGradient.setColorAt(1.0, QColor(39, 174, 96, 45));
+    } else if (j > 0) {
+        // Filled bucket - purple gradient
+        bucketGradient.setColorAt(0.0, QColor(123, 79, 255, 15));
+        bucketGradient.setColorAt(1.0, QColor(123, 79, 255, 25));
+    } else {
+        // Empty bucket - light gradient
+        bucketGradient.setColorAt(0.0, QColor(255, 255, 255, 200));
+        bucketGradient.setColorAt(1.0, QColor(250, 248, 255, 200));
     }
+    items.frame->setBrush(QBrush(bucketGradient));
+    items.frame->setPen(treeBucket ? QPen(QColor(39, 174, 96), 3.0)
+                                   : QPen(QColor(123, 79, 255, 120), 2.5));
 
-    // Add title higher up
-    QGraphicsTextItem *vizTitle = scene->addText("Hash Table (Open Chaining)");
-    QFont titleFont("Segoe UI", 16);
-    titleFont.setBold(true);
-    vizTitle->setFont(titleFont);
-    vizTitle->setDefaultTextColor(QColor(44, 62, 80));
-    vizTitle->setPos(-totalWidth/2, -120);
+    items.emptyText->setVisible(j == 0);
+    items.treeText->setVisible(treeBucket);
+    items.treeText->setPos(BUCKET_WIDTH/2 - 30, bucketHeight + 4);
+}
 
+HashMapVisualization::EntryItems HashMapVisualization::takeEntryItems()
+{
+    if (!spareEntries.isEmpty()) {
+        EntryItems entry = spareEntries.takeLast();
+        entry.background->show();
+        return entry;
+    }
+
+    const BucketFonts &fonts = bucketFonts();
+    EntryItems entry;
+
+    // Chain item background inside bucket
+    entry.background = new QGraphicsPathItem();
+    QPainterPath itemPath;
+    itemPath.addRoundedRect(QRectF(0, 0, BUCKET_WIDTH - 8, 25), 6, 6);
+    entry.background->setPath(itemPath);
+    entry.background->setBrush(QBrush(QColor(255, 255, 255, 180)));
+    entry.background->setPen(QPen(QColor(123, 79, 255, 100), 1.5));
+    entry.background->setZValue(1);
+
+    entry.text = new QGraphicsTextItem(entry.background);
+    entry.text->setPos(2, 2);
+    entry.text->setDefaultTextColor(QColor(45, 27, 105));
+    entry.text->setFont(fonts.entry);
+
+    // Sits in the gap above the entry, pointing down at it
+    entry.arrow = new QGraphicsTextItem("↓", entry.background);
+    entry.arrow->setPos(BUCKET_WIDTH/2 - 9, -15);
+    entry.arrow->setDefaultTextColor(QColor(123, 79, 255, 150));
+    entry.arrow->setFont(fonts.arrow);
+    return entry;
+}
+
+// Detaches a bucket's entries and parks them, hidden, for reuse.
+void HashMapVisualization::recycleEntries(BucketItems &items)
+{
+    for (const EntryItems &entry : items.entries) {
+        entry.background->hide();
+        entry.background->setParentItem(nullptr);
+        spareEntries.append(entry);
+    }
+    items.entries.clear();
+}
 
-    // Adjust scene rect with padding
-    scene->setSceneRect(scene->itemsBoundingRect().adjusted(-60, -100, 60, 80));
+// Height refreshBucket last drew the bucket at.
+int HashMapVisualization::bucketHeightFor(int bucket) const
+{
+    if (bucket < 0 || bucket >= bucketItems.size()) return BUCKET_HEIGHT;
+    return bucketItems[bucket].height;
 }
 
 void HashMapVisualization::updateVisualization()
@@ -803,8 +939,16 @@ void HashMapVisualization::updateVisualization()
 
 void HashMapVisualization::updateStepTrace()
 {
-    stepsList->clear();
-    const QVector<QString> &steps = hashMap->lastSteps();
+    // Only append lines added since the last update; start over after a
+    // clear or when the history has moved past what is shown.
+    if (shownStepEpoch != hashMap->stepEpoch() || hashMap->firstStep() > nextStepToShow) {
+        stepsList->clear();
+        shownStepEpoch = hashMap->stepEpoch();
+        nextStepToShow = hashMap->firstStep();
+    }
+    nextStepToShow = std::max(nextStepToShow, hashMap->endStep() - MAX_TRACE_ROWS);
+    const QVector<QString> steps = hashMap->readSteps(nextStepToShow, MAX_TRACE_ROWS);
+    nextStepToShow += steps.size();
 
     for (int i = 0; i < steps.size(); ++i) {
         const QString &step = steps[i];
@@ -815,7 +959,7 @@ void HashMapVisualization::updateStepTrace()
         // Add spacing between different operations
         if (step.startsWith("🔍") || step.startsWith("➕") || step.startsWith("❌") || step.startsWith("🗑️")) {
             // This is a new operation - add some visual separation
-            if (i > 0) {
+            if (stepsList->count() > 0) {
                 QListWidgetItem *separator = new QListWidgetItem("────────────────────");
                 separator->setTextAlignment(Qt::AlignCenter);
                 separator->setFlags(Qt::NoItemFlags); // Make it non-selectable
@@ -840,6 +984,10 @@ void HashMapVisualization::updateStepTrace()
         stepsList->addItem(item);
     }
 
+    while (stepsList->count() > MAX_TRACE_ROWS) {
+        delete stepsList->takeItem(0);
+    }
+
     // Auto-scroll to bottom to show latest steps
     if (stepsList->count() > 0) {
         stepsList->scrollToBottom();
@@ -848,9 +996,62 @@ void HashMapVisualization::updateStepTrace()
 
 void HashMapVisualization::showStats()
 {
-    sizeLabel->setText(QString("Size: %1").arg(hashMap->size()));
-    bucketCountLabel->setText(QString("Buckets: %1").arg(hashMap->bucketCount()));
-    loadFactorLabel->setText(QString("Load Factor: %1").arg(hashMap->loadFactor(), 0, 'f', 2));
+    const HashMapStats stats = hashMap->stats();
+    sizeLabel->setText(QString("Size: %1").arg(stats.size));
+    if (stats.rehashing) {
+        bucketCountLabel->setText(QString("Buckets: %1 (rehash %2%)")
+                                      .arg(stats.bucketCount)
+                                      .arg(qRound(stats.rehashProgress() * 100)));
+    } else {
+        bucketCountLabel->setText(QString("Buckets: %1").arg(stats.bucketCount));
+    }
+    loadFactorLabel->setText(QString("Load Factor: %1").arg(stats.loadFactor, 0, 'f', 2));
+
+    chainStatsLabel->setText(QString("Max chain: %1 | Compares: hit %2, miss %3 | Rehashes: %4 (%5 ms)")
+                                 .arg(stats.maxChainLength)
+                                 .arg(stats.averageSuccessfulCompares(), 0, 'f', 2)
+                                 .arg(stats.averageUnsuccessfulCompares(), 0, 'f', 2)
+                                 .arg(stats.rehashCount)
+                                 .arg(stats.rehashNanos / 1e6, 0, 'f', 2));
+    QStringList histogram;
+    for (int length = 0; length < static_cast<int>(stats.chainLengthHistogram.size()); ++length) {
+        histogram << QString("%1: %2").arg(length).arg(stats.chainLengthHistogram[static_cast<size_t>(length)]);
+    }
+    chainStatsLabel->setToolTip(QString("Buckets by chain length\n%1\n\nSampled latency (1 op in %2, %3 samples)\n"
+                                        "p50 <= %4 ns, p99 <= %5 ns")
+                                    .arg(histogram.join("\n"))
+                                    .arg(stats.latencySampleInterval)
+                                    .arg(stats.latencySamples)
+                                    .arg(stats.latencyPercentileNanos(0.50))
+                                    .arg(stats.latencyPercentileNanos(0.99)));
+    showLatency();
+}
+
+void HashMapVisualization::showLatency()
+{
+    const HashMapLatencyProfile *profile = hashMap->latencyProfile();
+    if (!profile) return;
+
+    QStringList rows;
+    auto addRow = [&](const QString &name, const HashMapLatencyHistogram &histogram) {
+        if (histogram.count() == 0) return;
+        rows << QString("%1 (%2): p50 %3 | p90 %4 | p99 %5 | p99.9 %6 | max %7")
+                    .arg(name)
+                    .arg(histogram.count())
+                    .arg(formatNanos(histogram.percentileNanos(0.50)))
+                    .arg(formatNanos(histogram.percentileNanos(0.90)))
+                    .arg(formatNanos(histogram.percentileNanos(0.99)))
+                    .arg(formatNanos(histogram.percentileNanos(0.999)))
+                    .arg(formatNanos(histogram.maxNanos()));
+    };
+    for (int i = 0; i < HashMapLatencyProfile::kOperationCount; ++i) {
+        const auto operation = static_cast<HashMapLatencyProfile::Operation>(i);
+        addRow(HashMapLatencyProfile::operationName(operation), profile->histogram(operation));
+    }
+    // Operations that started a resize, also counted in their own row
+    addRow("resizing", profile->resizing());
+    latencyLabel->setText(rows.isEmpty() ? QString("Latency: no operations timed yet")
+                                         : rows.join("\n"));
 }
 
 void HashMapVisualization::animateOperation(const QString &operation)
@@ -915,6 +1116,38 @@ QVariant HashMapVisualization::convertStringToVariant(const QString &str, HashMa
     }
 }
 
+template<typename Lookup>
+bool HashMapVisualization::withKeyView(const QString &str, Lookup &&lookup)
+{
+    bool ok = true;
+    switch (hashMap->getKeyType()) {
+    case HashMap::STRING:
+        lookup(QStringView(str));
+        return true;
+    case HashMap::INTEGER: {
+        const int intVal = str.toInt(&ok);
+        if (ok) lookup(intVal);
+        return ok;
+    }
+    case HashMap::DOUBLE: {
+        const double doubleVal = str.toDouble(&ok);
+        if (ok) lookup(doubleVal);
+        return ok;
+    }
+    case HashMap::FLOAT: {
+        const float floatVal = str.toFloat(&ok);
+        if (ok) lookup(floatVal);
+        return ok;
+    }
+    case HashMap::CHAR:
+        if (str.isEmpty()) return false;
+        lookup(QStringView(str).left(1));
+        return true;
+    default:
+        return false;
+    }
+}
+
 void HashMapVisualization::onInsertClicked()
 {
     const QString keyStr = keyInput->text().trimmed();
@@ -974,9 +1207,12 @@ void HashMapVisualization::onSearchClicked()
 
     if (!keyStr.isEmpty()) {
         // Search by key (key field is filled)
-        QVariant key = convertStringToVariant(keyStr, hashMap->getKeyType());
-
-        if (!key.isValid()) {
+        std::optional<QVariant> result;
+        int bucketIndex = -1;
+        if (!withKeyView(keyStr, [this, &result, &bucketIndex](auto key) {
+                result = hashMap->get(key);
+                bucketIndex = hashMap->indexFor(key);
+            })) {
             keyInput->setStyleSheet(keyInput->styleSheet() + "border-color: #dc3545 !important;");
             QTimer::singleShot(2000, [this]() {
                 keyInput->setStyleSheet(keyInput->styleSheet().replace("border-color: #dc3545 !important;", ""));
@@ -984,8 +1220,6 @@ void HashMapVisualization::onSearchClicked()
             return;
         }
 
-        // Perform search by key
-        auto result = hashMap->get(key);
         animateOperation("Search");
         showAlgorithm("Search");
 
@@ -997,7 +1231,7 @@ void HashMapVisualization::onSearchClicked()
         }
 
         // Animate the search by highlighting the target bucket
-        animateSearchResult(keyStr, result.has_value());
+        animateSearchResult(keyStr, bucketIndex, result.has_value());
 
     } else {
         // Search by value (only value field is filled, key is empty)
@@ -1032,17 +1266,10 @@ void HashMapVisualization::animateSearchByValue(const QString &value, bool found
 
     // Find which bucket contains the value for detailed history
     if (found) {
-        const QVector<QVector<QPair<QVariant, QVariant>>> bucketContents = hashMap->getBucketContents();
-        for (int i = 0; i < bucketContents.size(); ++i) {
-            for (int j = 0; j < bucketContents[i].size(); ++j) {
-                QVariant convertedValue = convertStringToVariant(value, hashMap->getValueType());
-                if (bucketContents[i][j].second == convertedValue) {
-                    *foundBucket = i;
-                    break;
-                }
-            }
-            if (*foundBucket != -1) break;
-        }
+        const QVariant convertedValue = convertStringToVariant(value, hashMap->getValueType());
+        hashMap->forEachInBuckets(0, totalBuckets, [&](int bucket, const QVariant &, const QVariant &v) {
+            if (*foundBucket == -1 && v == convertedValue) *foundBucket = bucket;
+        });
     }
 
     // Create a timer for sequential animation
@@ -1057,19 +1284,19 @@ void HashMapVisualization::animateSearchByValue(const QString &value, bool found
 
             // Add detailed result to history
             if (found && *foundBucket != -1) {
-                const QVector<QVector<QPair<QVariant, QVariant>>> bucketContents = hashMap->getBucketContents();
                 int position = -1;
                 QVariant foundKey;
 
                 // Find position within the bucket
                 QVariant convertedValue = convertStringToVariant(value, hashMap->getValueType());
-                for (int j = 0; j < bucketContents[*foundBucket].size(); ++j) {
-                    if (bucketContents[*foundBucket][j].second == convertedValue) {
-                        position = j + 1; // 1-based position for user display
-                        foundKey = bucketContents[*foundBucket][j].first;
-                        break;
+                int j = 0;
+                hashMap->forEachInBucket(*foundBucket, [&](const QVariant &k, const QVariant &v) {
+                    ++j;
+                    if (position == -1 && v == convertedValue) {
+                        position = j; // 1-based position for user display
+                        foundKey = k;
                     }
-                }
+                });
 
                 hashMap->addStepToHistory(QString("✅ Value '%1' found at bucket %2, position %3 (key: %4)")
                                               .arg(value)
@@ -1104,11 +1331,7 @@ void HashMapVisualization::animateSearchByValue(const QString &value, bool found
         const int y = 0;
 
         // Calculate bucket height
-        const QVector<QVector<QPair<QVariant, QVariant>>> bucketContents = hashMap->getBucketContents();
-        int bucketHeight = BUCKET_HEIGHT;
-        if (*currentBucket < bucketContents.size() && !bucketContents[*currentBucket].isEmpty()) {
-            bucketHeight = BUCKET_HEIGHT + (bucketContents[*currentBucket].size() * 30);
-        }
+        const int bucketHeight = bucketHeightFor(*currentBucket);
 
         // Create highlight effect (blue for searching, green if this is the found bucket)
         QColor highlightColor = (*currentBucket == *foundBucket && found) ?
@@ -1141,14 +1364,9 @@ void HashMapVisualization::animateSearchByValue(const QString &value, bool found
     }
 }
 
-void HashMapVisualization::animateSearchResult(const QString &key, bool found)
+void HashMapVisualization::animateSearchResult(const QString &key, int bucketIndex, bool found)
 {
-    // Convert key to QVariant for proper hashing
-    QVariant keyVariant = convertStringToVariant(key, hashMap->getKeyType());
-    if (!keyVariant.isValid()) return;
-
-    // Calculate which bucket the key would be in using HashMap's indexFor method
-    const int bucketIndex = hashMap->indexFor(keyVariant, hashMap->bucketCount());
+    if (bucketIndex < 0) return;  // no key of the key type can match
 
     // Step 1: Show hash calculation (like Binary Tree's step-by-step approach)
     hashMap->addStepToHistory(QString("🔍 Searching for key: %1").arg(key));
@@ -1174,12 +1392,8 @@ void HashMapVisualization::animateSearchResult(const QString &key, bool found)
         const int x = startX + bucketIndex * (BUCKET_WIDTH + BUCKET_SPACING);
         const int y = 0;
 
-        // Calculate bucket height (same logic as drawBuckets)
-        const QVector<QVector<QPair<QVariant, QVariant>>> bucketContents = hashMap->getBucketContents();
-        int bucketHeight = BUCKET_HEIGHT;
-        if (bucketIndex < bucketContents.size() && !bucketContents[bucketIndex].isEmpty()) {
-            bucketHeight = BUCKET_HEIGHT + (bucketContents[bucketIndex].size() * 30);
-        }
+        // Height the bucket was last drawn at
+        const int bucketHeight = bucketHeightFor(bucketIndex);
 
         // Create highlight effect (like Binary Tree node highlighting)
         highlightRect = scene->addRect(x - 3, y - 3, BUCKET_WIDTH + 6, bucketHeight + 6,
@@ -1220,10 +1434,12 @@ void HashMapVisualization::onDeleteClicked()
         return;
     }
 
-    // Convert string to appropriate QVariant type
-    QVariant key = convertStringToVariant(keyStr, hashMap->getKeyType());
-
-    if (!key.isValid()) {
+    bool removed = false;
+    int bucketIndex = -1;
+    if (!withKeyView(keyStr, [this, &removed, &bucketIndex](auto key) {
+            removed = hashMap->erase(key);
+            bucketIndex = hashMap->indexFor(key);
+        })) {
         keyInput->setStyleSheet(keyInput->styleSheet() + "border-color: #dc3545 !important;");
         QTimer::singleShot(2000, [this]() {
             keyInput->setStyleSheet(keyInput->styleSheet().replace("border-color: #dc3545 !important;", ""));
@@ -1231,12 +1447,11 @@ void HashMapVisualization::onDeleteClicked()
         return;
     }
 
-    bool removed = hashMap->erase(key);
     animateOperation("Delete");
     showAlgorithm("Delete");
 
     // Animate the deletion result
-    animateSearchResult(keyStr, removed);
+    animateSearchResult(keyStr, bucketIndex, removed);
 
     keyInput->clear();
 }
@@ -1272,6 +1487,7 @@ void HashMapVisualization::onRandomizeClicked()
     HashMap::DataType keyType = hashMap->getKeyType();
     HashMap::DataType valueType = hashMap->getValueType();
 
+    QVector<QVariant> batchKeys, batchValues;
     for (int i = 0; i < 5; ++i) {
         QVariant key, value;
 
@@ -1323,8 +1539,10 @@ void HashMapVisualization::onRandomizeClicked()
         }
         }
 
-        hashMap->put(key, value);
+        batchKeys.append(key);
+        batchValues.append(value);
     }
+    hashMap->putBatch(batchKeys, batchValues);
 
     animateOperation("Randomize");
     showAlgorithm("Randomize");
@@ -1462,3 +1680,51 @@ void HashMapVisualization::paintEvent(QPaintEvent *event)
     bottomCircle.setColorAt(1.0, QColor(180, 150, 255, 0));
     painter.fillRect(rect(), bottomCircle);
 }
+
+void HashMapVisualization::onSaveClicked()
+{
+    const QString path = QFileDialog::getSaveFileName(this, "Save Hash Table", QString(),
+                                                      "HashMap snapshots (*.hmap)");
+    if (path.isEmpty()) return;
+
+    QString error;
+    if (!hashMap->saveSnapshot(path, &error)) {
+        QMessageBox::warning(this, "Save Failed", error);
+        return;
+    }
+    hashMap->addStepToHistory(QString("💾 Saved %1 entries to %2").arg(hashMap->size()).arg(path));
+    updateStepTrace();
+}
+
+void HashMapVisualization::onLatencyToggled(bool enabled)
+{
+    hashMap->setLatencyTracking(enabled);
+    latencyLabel->setVisible(enabled);
+    showLatency();
+}
+
+void HashMapVisualization::onLoadClicked()
+{
+    const QString path = QFileDialog::getOpenFileName(this, "Load Hash Table", QString(),
+                                                      "HashMap snapshots (*.hmap)");
+    if (path.isEmpty()) return;
+
+    QString error;
+    if (!hashMap->loadSnapshot(path, &error)) {
+        QMessageBox::warning(this, "Load Failed", error);
+        return;
+    }
+
+    // Follow the snapshot's types without onTypeChanged() clearing the map
+    keyTypeCombo->blockSignals(true);
+    valueTypeCombo->blockSignals(true);
+    keyTypeCombo->setCurrentIndex(hashMap->getKeyType());
+    valueTypeCombo->setCurrentIndex(hashMap->getValueType());
+    keyTypeCombo->blockSignals(false);
+    valueTypeCombo->blockSignals(false);
+    keyInput->setPlaceholderText(QString("Enter %1 key").arg(HashMap::dataTypeToString(hashMap->getKeyType()).toLower()));
+    valueInput->setPlaceholderText(QString("Enter %1 value").arg(HashMap::dataTypeToString(hashMap->getValueType()).toLower()));
+
+    updateVisualization();
+    updateStepTrace();
+}
@@ -47,11 +47,32 @@ private slots:
     void onDeleteClicked();
     void onClearClicked();
     void onRandomizeClicked();
+    void onSaveClicked();
+    void onLoadClicked();
+    void onLatencyToggled(bool enabled);
     void onTypeChanged();
     void updateVisualization();
     void updateStepTrace();
 
 private:
+    // Scene items of one drawn entry: a background with its text and
+    // incoming chain arrow as children.
+    struct EntryItems {
+        QGraphicsPathItem *background;
+        QGraphicsTextItem *text;
+        QGraphicsTextItem *arrow;
+    };
+    // Scene items of one bucket, kept across redraws. Everything hangs off
+    // frame in the bucket's own coordinates, so moving a bucket is one
+    // setPos and redrawing it touches only its own items.
+    struct BucketItems {
+        QGraphicsPathItem *frame = nullptr;
+        QGraphicsTextItem *emptyText = nullptr;
+        QGraphicsTextItem *treeText = nullptr;
+        QVector<EntryItems> entries;
+        int height = 0;
+    };
+
     void setupUI();
     void setupVisualizationArea();
     void setupRightPanel();
@@ -62,12 +83,26 @@ private:
     void setupStepTrace();
     void setupStepTraceTop();
     void drawBuckets();
+    // Incremental drawing: only buckets changed since drawnEpoch are
+    // rebuilt, from items recycled through spareEntries.
+    BucketItems createBucketItems(int bucket);
+    void refreshBucket(int bucket);
+    EntryItems takeEntryItems();
+    void recycleEntries(BucketItems &items);
+    int bucketHeightFor(int bucket) const;
     void animateOperation(const QString &operation);
-    void animateSearchResult(const QString &key, bool found);
+    // bucketIndex as found by HashMap::indexFor on the key view.
+    void animateSearchResult(const QString &key, int bucketIndex, bool found);
     void animateSearchByValue(const QString &value, bool found);
     void showAlgorithm(const QString &operation);
     void showStats();
+    void showLatency();
     QVariant convertStringToVariant(const QString &str, HashMap::DataType type);
+    // Calls lookup with the typed key as a HashMap key view, so searches
+    // and deletes don't box it; false if it isn't a valid key of the
+    // current key type.
+    template<typename Lookup>
+    bool withKeyView(const QString &str, Lookup &&lookup);
 
     // UI Components
     QSplitter *mainSplitter;
@@ -96,23 +131,32 @@ private:
     QPushButton *deleteButton;
     QPushButton *clearButton;
     QPushButton *randomizeButton;
+    QPushButton *saveButton;
+    QPushButton *loadButton;
+    QPushButton *latencyButton;   // checkable; turns on HashMap latency tracking
     // Stats
     QGroupBox *statsGroup;
     QLabel *sizeLabel;
     QLabel *bucketCountLabel;
     QLabel *loadFactorLabel;
+    QLabel *chainStatsLabel;   // chain, compare and rehash counters
+    QLabel *latencyLabel;      // live percentiles, shown while latencyButton is on
 
     // Step trace with tabs
     QGroupBox *traceGroup;
     QTabWidget *traceTabWidget;
     QListWidget *stepsList;
+    qint64 nextStepToShow;   // cursor into HashMap's step history
+    int shownStepEpoch;
     QListWidget *algorithmList;
 
     // Data and visualization
     HashMap *hashMap;
-    QVector<QGraphicsRectItem*> bucketRects;
-    QVector<QGraphicsTextItem*> bucketTexts;
-    QVector<QVector<QGraphicsTextItem*>> chainTexts;
+
+    QVector<BucketItems> bucketItems;
+    QVector<EntryItems> spareEntries;   // hidden, reused before creating more
+    QGraphicsTextItem *vizTitle;
+    quint64 drawnEpoch;                 // hashMap->modificationEpoch() at the last draw
 
     // Animation
     QTimer *animationTimer;
@@ -124,6 +168,7 @@ private:
     static const int BUCKET_SPACING;
     static const int CHAIN_ITEM_HEIGHT;
     static const int MAX_VISIBLE_BUCKETS;
+    static const int MAX_TRACE_ROWS;
 };
 
 #endif // HASHMAPVISUALIZATION_H
@@ -591,60 +591,7 @@ RBNode* RedBlackTree::BSTInsert(RBNode* root, RBNode* node)
 
 void RedBlackTree::fixInsert(RBNode* node)
 {
-    while (node->parent && node->parent->color == RED) {
-        // Check if parent->parent exists (parent is not root)
-        if (!node->parent->parent) {
-            break;  // Parent is root, no grandparent
-        }
-
-        if (node->parent == node->parent->parent->left) {
-            RBNode *uncle = node->parent->parent->right;
-
-            // Check if uncle exists and is RED (uncle could be NIL which is BLACK)
-            if (uncle && uncle != NIL && uncle->color == RED) {
-                // Case 1: Uncle is red
-                node->parent->color = BLACK;
-                uncle->color = BLACK;
-                node->parent->parent->color = RED;
-                node = node->parent->parent;
-            } else {
-                // Uncle is BLACK or NIL
-                if (node == node->parent->right) {
-                    // Case 2: Triangle - convert to line
-                    node = node->parent;
-                    rotateLeftSync(node);
-                }
-                // Case 3: Line
-                node->parent->color = BLACK;
-                if (node->parent->parent) {
-                    node->parent->parent->color = RED;
-                    rotateRightSync(node->parent->parent);
-                }
-            }
-        } else {
-            RBNode *uncle = node->parent->parent->left;
-
-            // Check if uncle exists and is RED
-            if (uncle && uncle != NIL && uncle->color == RED) {
-                node->parent->color = BLACK;
-                uncle->color = BLACK;
-                node->parent->parent->color = RED;
-                node = node->parent->parent;
-            } else {
-                // Uncle is BLACK or NIL
-                if (node == node->parent->left) {
-                    node = node->parent;
-                    rotateRightSync(node);
-                }
-                node->parent->color = BLACK;
-                if (node->parent->parent) {
-                    node->parent->parent->color = RED;
-                    rotateLeftSync(node->parent->parent);
-                }
-            }
-        }
-    }
-    root->color = BLACK;
+    rbtree::insertFixup(root, node, NIL);
 }
 
 void RedBlackTree::rotateLeft(RBNode* node)
@@ -664,27 +611,7 @@ void RedBlackTree::rotateLeft(RBNode* node)
 
 void RedBlackTree::rotateLeftSync(RBNode* node)
 {
-    if (!node || node->right == NIL) return;
-
-    RBNode *rightChild = node->right;
-    node->right = rightChild->left;
-
-    if (rightChild->left != NIL) {
-        rightChild->left->parent = node;
-    }
-
-    rightChild->parent = node->parent;
-
-    if (!node->parent) {
-        root = rightChild;
-    } else if (node == node->parent->left) {
-        node->parent->left = rightChild;
-    } else {
-        node->parent->right = rightChild;
-    }
-
-    rightChild->left = node;
-    node->parent = rightChild;
+    rbtree::rotateLeft(root, node, NIL);
 }
 
 void RedBlackTree::rotateRight(RBNode* node)
@@ -704,27 +631,7 @@ void RedBlackTree::rotateRight(RBNode* node)
 
 void RedBlackTree::rotateRightSync(RBNode* node)
 {
-    if (!node || node->left == NIL) return;
-
-    RBNode *leftChild = node->left;
-    node->left = leftChild->right;
-
-    if (leftChild->right != NIL) {
-        leftChild->right->parent = node;
-    }
-
-    leftChild->parent = node->parent;
-
-    if (!node->parent) {
-        root = leftChild;
-    } else if (node == node->parent->right) {
-        node->parent->right = leftChild;
-    } else {
-        node->parent->left = leftChild;
-    }
-
-    leftChild->right = node;
-    node->parent = leftChild;
+    rbtree::rotateRight(root, node, NIL);
 }
 
 void RedBlackTree::deleteNode(int value)
@@ -15,7 +15,11 @@
 #include <QStackedWidget>
 #include <QScrollArea>
 
-enum Color { RED, BLACK };
+#include "redblacktreeops.h"
+
+using rbtree::Color;
+using rbtree::RED;
+using rbtree::BLACK;
 
 struct RBNode {
     int value;
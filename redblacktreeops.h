@@ -0,0 +1,245 @@
+#pragma once
+
+// Red-black tree rebalancing, shared by the RedBlackTree widget and
+// HashMapCore's treeified buckets. Works on any node type with left, right,
+// parent and color members. Missing children are `nil` (a sentinel node or
+// nullptr); the root's parent is nullptr.
+namespace rbtree {
+
+enum Color { RED, BLACK };
+
+template<typename Node>
+bool isRed(const Node *node, const Node *nil = nullptr) {
+    return node && node != nil && node->color == RED;
+}
+
+template<typename Node>
+Node *minimum(Node *node, Node *nil = nullptr) {
+    while (node->left != nil) node = node->left;
+    return node;
+}
+
+template<typename Node>
+void rotateLeft(Node *&root, Node *node, Node *nil = nullptr) {
+    if (!node || node->right == nil) return;
+
+    Node *rightChild = node->right;
+    node->right = rightChild->left;
+
+    if (rightChild->left != nil) {
+        rightChild->left->parent = node;
+    }
+
+    rightChild->parent = node->parent;
+
+    if (!node->parent) {
+        root = rightChild;
+    } else if (node == node->parent->left) {
+        node->parent->left = rightChild;
+    } else {
+        node->parent->right = rightChild;
+    }
+
+    rightChild->left = node;
+    node->parent = rightChild;
+}
+
+template<typename Node>
+void rotateRight(Node *&root, Node *node, Node *nil = nullptr) {
+    if (!node || node->left == nil) return;
+
+    Node *leftChild = node->left;
+    node->left = leftChild->right;
+
+    if (leftChild->right != nil) {
+        leftChild->right->parent = node;
+    }
+
+    leftChild->parent = node->parent;
+
+    if (!node->parent) {
+        root = leftChild;
+    } else if (node == node->parent->right) {
+        node->parent->right = leftChild;
+    } else {
+        node->parent->left = leftChild;
+    }
+
+    leftChild->right = node;
+    node->parent = leftChild;
+}
+
+// Restores the red-black properties after a red node was linked in as a
+// leaf by an ordinary BST insert.
+template<typename Node>
+void insertFixup(Node *&root, Node *node, Node *nil = nullptr) {
+    while (node->parent && node->parent->color == RED) {
+        // Check if parent->parent exists (parent is not root)
+        if (!node->parent->parent) {
+            break;  // Parent is root, no grandparent
+        }
+
+        if (node->parent == node->parent->parent->left) {
+            Node *uncle = node->parent->parent->right;
+
+            if (isRed(uncle, nil)) {
+                // Case 1: Uncle is red
+                node->parent->color = BLACK;
+                uncle->color = BLACK;
+                node->parent->parent->color = RED;
+                node = node->parent->parent;
+            } else {
+                // Uncle is BLACK or NIL
+                if (node == node->parent->right) {
+                    // Case 2: Triangle - convert to line
+                    node = node->parent;
+                    rotateLeft(root, node, nil);
+                }
+                // Case 3: Line
+                node->parent->color = BLACK;
+                if (node->parent->parent) {
+                    node->parent->parent->color = RED;
+                    rotateRight(root, node->parent->parent, nil);
+                }
+            }
+        } else {
+            Node *uncle = node->parent->parent->left;
+
+            if (isRed(uncle, nil)) {
+                node->parent->color = BLACK;
+                uncle->color = BLACK;
+                node->parent->parent->color = RED;
+                node = node->parent->parent;
+            } else {
+                if (node == node->parent->left) {
+                    node = node->parent;
+                    rotateRight(root, node, nil);
+                }
+                node->parent->color = BLACK;
+                if (node->parent->parent) {
+                    node->parent->parent->color = RED;
+                    rotateLeft(root, node->parent->parent, nil);
+                }
+            }
+        }
+    }
+    root->color = BLACK;
+}
+
+// Puts v (possibly nil) where u was under u's parent.
+template<typename Node>
+void transplant(Node *&root, Node *u, Node *v, Node *nil = nullptr) {
+    if (!u->parent) {
+        root = v;
+    } else if (u == u->parent->left) {
+        u->parent->left = v;
+    } else {
+        u->parent->right = v;
+    }
+    if (v && v != nil) v->parent = u->parent;
+}
+
+// Fixes the extra black left at x after a black node was unlinked. x may
+// be nil, so its parent is passed separately.
+template<typename Node>
+void eraseFixup(Node *&root, Node *x, Node *xParent, Node *nil = nullptr) {
+    while (x != root && !isRed(x, nil) && xParent) {
+        if (x == xParent->left) {
+            Node *sibling = xParent->right;
+            if (isRed(sibling, nil)) {
+                // Case 1: Sibling is red
+                sibling->color = BLACK;
+                xParent->color = RED;
+                rotateLeft(root, xParent, nil);
+                sibling = xParent->right;
+            }
+            if (!isRed(sibling->left, nil) && !isRed(sibling->right, nil)) {
+                // Case 2: Sibling and both its children are black
+                sibling->color = RED;
+                x = xParent;
+                xParent = x->parent;
+            } else {
+                // Cases 3 & 4: Sibling has a red child
+                if (!isRed(sibling->right, nil)) {
+                    sibling->left->color = BLACK;
+                    sibling->color = RED;
+                    rotateRight(root, sibling, nil);
+                    sibling = xParent->right;
+                }
+                sibling->color = xParent->color;
+                xParent->color = BLACK;
+                sibling->right->color = BLACK;
+                rotateLeft(root, xParent, nil);
+                x = root;
+                break;
+            }
+        } else {
+            Node *sibling = xParent->left;
+            if (isRed(sibling, nil)) {
+                sibling->color = BLACK;
+                xParent->color = RED;
+                rotateRight(root, xParent, nil);
+                sibling = xParent->left;
+            }
+            if (!isRed(sibling->right, nil) && !isRed(sibling->left, nil)) {
+                sibling->color = RED;
+                x = xParent;
+                xParent = x->parent;
+            } else {
+                if (!isRed(sibling->left, nil)) {
+                    sibling->right->color = BLACK;
+                    sibling->color = RED;
+                    rotateLeft(root, sibling, nil);
+                    sibling = xParent->left;
+                }
+                sibling->color = xParent->color;
+                xParent->color = BLACK;
+                sibling->left->color = BLACK;
+                rotateRight(root, xParent, nil);
+                x = root;
+                break;
+            }
+        }
+    }
+    if (x && x != nil) x->color = BLACK;
+}
+
+// Unlinks node from the tree and rebalances. The node itself is left for
+// the caller to free.
+template<typename Node>
+void erase(Node *&root, Node *node, Node *nil = nullptr) {
+    Node *x = nil;
+    Node *xParent = nullptr;
+    Color removedColor = node->color;
+
+    if (node->left == nil) {
+        x = node->right;
+        xParent = node->parent;
+        transplant(root, node, node->right, nil);
+    } else if (node->right == nil) {
+        x = node->left;
+        xParent = node->parent;
+        transplant(root, node, node->left, nil);
+    } else {
+        // Two children: the in-order successor takes node's place
+        Node *successor = minimum(node->right, nil);
+        removedColor = successor->color;
+        x = successor->right;
+        if (successor->parent == node) {
+            xParent = successor;
+        } else {
+            xParent = successor->parent;
+            transplant(root, successor, successor->right, nil);
+            successor->right = node->right;
+            successor->right->parent = successor;
+        }
+        transplant(root, node, successor, nil);
+        successor->left = node->left;
+        successor->left->parent = successor;
+        successor->color = node->color;
+    }
+
+    if (removedColor == BLACK) eraseFixup(root, x, xParent, nil);
+}
+
+} // namespace rbtree
@@ -0,0 +1,384 @@
+#pragma once
+
+#include "hashmapcore.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HASHMAP_SWISS_SSE2 1
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// One metadata group of 16 control bytes. A control byte is kEmpty, kDeleted
+// (tombstone) or, for a full slot, the low 7 bits of the slot's hash (H2).
+// Each match returns a bitmask with bit i set for control byte i.
+class SwissGroup {
+public:
+    static constexpr int kWidth = 16;
+    static constexpr int8_t kEmpty = -128;  // 0b10000000
+    static constexpr int8_t kDeleted = -2;  // 0b11111110
+
+    explicit SwissGroup(const int8_t *ctrl) {
+#ifdef HASHMAP_SWISS_SSE2
+        ctrl_ = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl));
+#else
+        std::memcpy(ctrl_, ctrl, kWidth);
+#endif
+    }
+
+    uint32_t match(int8_t h2) const {
+#ifdef HASHMAP_SWISS_SSE2
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl_)));
+#else
+        uint32_t mask = 0;
+        for (int i = 0; i < kWidth; ++i) {
+            if (ctrl_[i] == h2) mask |= 1u << i;
+        }
+        return mask;
+#endif
+    }
+
+    uint32_t matchEmpty() const { return match(kEmpty); }
+
+    // Empty and deleted are the only control bytes with the sign bit set.
+    uint32_t matchEmptyOrDeleted() const {
+#ifdef HASHMAP_SWISS_SSE2
+        return static_cast<uint32_t>(_mm_movemask_epi8(ctrl_));
+#else
+        uint32_t mask = 0;
+        for (int i = 0; i < kWidth; ++i) {
+            if (ctrl_[i] < 0) mask |= 1u << i;
+        }
+        return mask;
+#endif
+    }
+
+    uint32_t matchFull() const { return ~matchEmptyOrDeleted() & 0xFFFFu; }
+
+    static int lowestBit(uint32_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    static int popCount(uint32_t mask) {
+        int count = 0;
+        for (; mask; mask &= mask - 1) ++count;
+        return count;
+    }
+
+private:
+#ifdef HASHMAP_SWISS_SSE2
+    __m128i ctrl_;
+#else
+    int8_t ctrl_[kWidth];
+#endif
+};
+
+// Open-addressing hash table in the Swiss-table style: slots are split into
+// groups of 16, each with a control-byte group that is matched against the
+// key's H2 in one SSE2 compare, so most misses never touch a slot. Probing
+// walks whole groups linearly; erase leaves a tombstone unless the group
+// still has an empty slot (in which case no probe ever passed through it).
+//
+// Same interface as HashMapCore, with one "bucket" per probe group so the
+// visualizer can keep drawing bucketSizes()/getBucketContents().
+template<typename K, typename V,
+         typename Hash = HashMapHash<K>,
+         typename Eq = std::equal_to<>>
+class SwissHashMapCore {
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using hasher = Hash;
+
+    struct Node {
+        K key;
+        V value;
+    };
+
+    // A probe group can never be more than 7/8 full on average.
+    static constexpr float kMaxLoadFactor = 0.875f;
+    static constexpr bool kCuckoo = false;
+    static constexpr bool kDenseEntries = false;
+    static constexpr bool kPlainModulo = false;
+
+    explicit SwissHashMapCore(int initialBucketCount = 16, float maxLoadFactor = 0.75f,
+                              const Hash &hash = Hash(), const Eq &eq = Eq())
+        : maxLoadFactor_(std::min(maxLoadFactor, kMaxLoadFactor)),
+        hash_(hash),
+        eq_(eq) {
+        allocate(std::max(1, initialBucketCount));
+    }
+
+    ~SwissHashMapCore() { destroyAll(); }
+
+    SwissHashMapCore(const SwissHashMapCore &) = delete;
+    SwissHashMapCore &operator=(const SwissHashMapCore &) = delete;
+
+    int size() const { return numElements_; }
+    int bucketCount() const { return groupCount_; }
+    int capacity() const { return groupCount_ * SwissGroup::kWidth; }
+    int tombstones() const { return numDeleted_; }
+    float maxLoadFactor() const { return maxLoadFactor_; }
+    void setMaxLoadFactor(float maxLoadFactor) { maxLoadFactor_ = std::min(maxLoadFactor, kMaxLoadFactor); }
+
+    // Fraction of slots holding an element.
+    float loadFactor() const {
+        return static_cast<float>(numElements_) / static_cast<float>(capacity());
+    }
+
+    template<typename Q>
+    size_t hashOf(const Q &key) const { return hash_(key); }
+    const Hash &hashFunction() const { return hash_; }
+
+    int bucketForHash(size_t hash, int bucketCount) const {
+        return static_cast<int>(h1(hash) % static_cast<size_t>(bucketCount));
+    }
+    int bucketForHash(size_t hash) const { return bucketForHash(hash, groupCount_); }
+    int bucketFor(const K &key, int bucketCount) const { return bucketForHash(hash_(key), bucketCount); }
+    int bucketFor(const K &key) const { return bucketFor(key, groupCount_); }
+    // Group the node actually sits in, which probing may have moved past
+    // its home group.
+    int bucketOf(const Node &node) const { return static_cast<int>(indexOf(&node) / SwissGroup::kWidth); }
+
+    // Tombstones occupy probe positions, so they count towards the limit.
+    bool needsGrow() const {
+        const float projected = static_cast<float>(numElements_ + numDeleted_ + 1)
+        / static_cast<float>(capacity());
+        return projected > maxLoadFactor_;
+    }
+
+    // When tombstones rather than live elements fill the table, rebuilding
+    // at the same size is enough to reclaim them.
+    int grownBucketCount() const {
+        const float liveLoad = static_cast<float>(numElements_ + 1) / static_cast<float>(capacity());
+        if (liveLoad <= maxLoadFactor_ / 2.0f) return groupCount_;
+        return std::max(2, groupCount_ * 2);
+    }
+
+    // Only slots whose 7-bit tag matches are compared, so a uniform hash
+    // finds its key at the first compare almost always.
+    double expectedHitCompares() const { return 1.0; }
+
+    int bucketCountFor(int expectedElements, float load) const {
+        const float effective = std::min(load, maxLoadFactor_);
+        const int slots = static_cast<int>(std::ceil(expectedElements / effective));
+        return std::max(1, (slots + SwissGroup::kWidth - 1) / SwissGroup::kWidth);
+    }
+
+    template<typename Q, typename Visit>
+    Node *find(const Q &key, size_t hash, Visit &&visit) {
+        const int8_t tag = h2(hash);
+        int group = bucketForHash(hash);
+        for (int probes = 0; probes < groupCount_; ++probes) {
+            const int8_t *ctrl = &ctrl_[static_cast<size_t>(group) * SwissGroup::kWidth];
+            const SwissGroup g(ctrl);
+            for (uint32_t mask = g.match(tag); mask; mask &= mask - 1) {
+                Node &node = slot(group, SwissGroup::lowestBit(mask));
+                const bool matched = eq_(node.key, key);
+                visit(static_cast<const Node &>(node), matched);
+                if (matched) return &node;
+            }
+            if (g.matchEmpty()) return nullptr;
+            group = nextGroup(group);
+        }
+        return nullptr;
+    }
+
+    Node *find(const K &key) {
+        return find(key, hash_(key), [](const Node &, bool) {});
+    }
+
+    // Pulls in the home group's control bytes and first slot.
+    void prefetch(size_t hash) const {
+        const size_t start = static_cast<size_t>(bucketForHash(hash)) * SwissGroup::kWidth;
+        hashMapPrefetch(&ctrl_[start]);
+        hashMapPrefetch(&slots_[start]);
+    }
+
+    // Places a new element in the first free slot of its probe sequence.
+    // The key must be absent.
+    Node &insertUnique(size_t hash, K key, V value) {
+        if (numElements_ + numDeleted_ >= capacity()) {
+            rehash(grownBucketCount());
+        }
+        const size_t index = findFreeSlot(hash, ctrl_.data(), groupCount_);
+        if (ctrl_[index] == SwissGroup::kDeleted) --numDeleted_;
+        ctrl_[index] = h2(hash);
+        Node *node = new (slots_[index].bytes) Node{std::move(key), std::move(value)};
+        ++numElements_;
+        return *node;
+    }
+
+    template<typename Q, typename Visit>
+    bool erase(const Q &key, size_t hash, Visit &&visit) {
+        Node *node = find(key, hash, std::forward<Visit>(visit));
+        if (!node) return false;
+        const size_t index = indexOf(node);
+        node->~Node();
+        const size_t groupStart = index - index % SwissGroup::kWidth;
+        if (SwissGroup(&ctrl_[groupStart]).matchEmpty()) {
+            ctrl_[index] = SwissGroup::kEmpty;
+        } else {
+            ctrl_[index] = SwissGroup::kDeleted;
+            ++numDeleted_;
+        }
+        --numElements_;
+        return true;
+    }
+
+    // Rebuilds the table into newBucketCount probe groups (grown if needed
+    // to fit the current elements), dropping all tombstones.
+    template<typename OnMove>
+    void rehash(int newBucketCount, OnMove &&onMove) {
+        const int minimum = bucketCountFor(numElements_ + 1, maxLoadFactor_);
+        newBucketCount = std::max({1, newBucketCount, minimum});
+
+        std::vector<int8_t> oldCtrl;
+        std::unique_ptr<Slot[]> oldSlots;
+        oldCtrl.swap(ctrl_);
+        oldSlots.swap(slots_);
+        allocate(newBucketCount);
+
+        for (size_t i = 0; i < oldCtrl.size(); ++i) {
+            if (oldCtrl[i] < 0) continue;
+            Node &node = *oldSlots[i].node();
+            const size_t hash = hash_(node.key);
+            const size_t index = findFreeSlot(hash, ctrl_.data(), groupCount_);
+            onMove(static_cast<const Node &>(node), static_cast<int>(index / SwissGroup::kWidth));
+            ctrl_[index] = h2(hash);
+            new (slots_[index].bytes) Node{std::move(node)};
+            node.~Node();
+            ++numElements_;
+        }
+    }
+
+    void rehash(int newBucketCount) {
+        rehash(newBucketCount, [](const Node &, int) {});
+    }
+
+    // Open addressing can't probe two tables cheaply, so this backend always
+    // resizes in one go and never reports a migration in progress.
+    static constexpr bool kIncrementalRehash = false;
+
+    template<typename OnMove>
+    bool rehashStep(int, OnMove &&) { return false; }
+
+    // Slots live inline in one array, so there is a single "slab" and no
+    // per-node allocation to pool.
+    size_t nodeBytesReserved() const { return static_cast<size_t>(capacity()) * (sizeof(Slot) + 1); }
+    size_t nodeBytesLive() const { return static_cast<size_t>(numElements_) * sizeof(Node); }
+    int nodeSlabs() const { return groupCount_ > 0 ? 1 : 0; }
+
+    bool isRehashing() const { return false; }
+    int rehashSourceBuckets() const { return 0; }
+    int rehashedBuckets() const { return 0; }
+
+    // Probing moves on to the next group instead of growing a chain, so
+    // there is nothing to treeify.
+    bool isTreeBucket(int) const { return false; }
+    int treeBucketCount() const { return 0; }
+
+    void clear() {
+        destroyAll();
+        std::fill(ctrl_.begin(), ctrl_.end(), SwissGroup::kEmpty);
+    }
+
+    int bucketSize(int index) const {
+        return SwissGroup::popCount(SwissGroup(&ctrl_[static_cast<size_t>(index) * SwissGroup::kWidth]).matchFull());
+    }
+
+    template<typename F>
+    void forEachInBucket(int index, F &&f) const {
+        const size_t start = static_cast<size_t>(index) * SwissGroup::kWidth;
+        for (size_t i = start; i < start + SwissGroup::kWidth; ++i) {
+            if (ctrl_[i] >= 0) f(static_cast<const Node &>(*slots_[i].node()));
+        }
+    }
+
+    template<typename F>
+    void forEach(F &&f) const {
+        for (int g = 0; g < groupCount_; ++g) forEachInBucket(g, f);
+    }
+
+private:
+    struct Slot {
+        alignas(Node) unsigned char bytes[sizeof(Node)];
+        Node *node() { return std::launder(reinterpret_cast<Node *>(bytes)); }
+        const Node *node() const { return std::launder(reinterpret_cast<const Node *>(bytes)); }
+    };
+
+    std::vector<int8_t> ctrl_;
+    std::unique_ptr<Slot[]> slots_;
+    int groupCount_ = 0;
+    int numElements_ = 0;
+    int numDeleted_ = 0;
+    float maxLoadFactor_ = 0.75f;
+    Hash hash_;
+    Eq eq_;
+
+    // Spread the hash so identity hashes (std::hash<int>) still yield
+    // distinct H2 tags and well-distributed home groups.
+    static size_t mix(size_t hash) {
+        const uint64_t h = static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+    static size_t h1(size_t hash) { return mix(hash) >> 7; }
+    static int8_t h2(size_t hash) { return static_cast<int8_t>(mix(hash) & 0x7F); }
+
+    int nextGroup(int group) const { return group + 1 == groupCount_ ? 0 : group + 1; }
+
+    Node &slot(int group, int offset) {
+        return *slots_[static_cast<size_t>(group) * SwissGroup::kWidth + static_cast<size_t>(offset)].node();
+    }
+
+    size_t indexOf(const Node *node) const {
+        const Slot *s = reinterpret_cast<const Slot *>(reinterpret_cast<const unsigned char *>(node));
+        return static_cast<size_t>(s - slots_.get());
+    }
+
+    size_t findFreeSlot(size_t hash, const int8_t *ctrl, int groups) const {
+        int group = bucketForHash(hash, groups);
+        for (;;) {
+            const uint32_t mask = SwissGroup(&ctrl[static_cast<size_t>(group) * SwissGroup::kWidth]).matchEmptyOrDeleted();
+            if (mask) {
+                return static_cast<size_t>(group) * SwissGroup::kWidth + static_cast<size_t>(SwissGroup::lowestBit(mask));
+            }
+            group = group + 1 == groups ? 0 : group + 1;
+        }
+    }
+
+    void allocate(int groups) {
+        groupCount_ = groups;
+        const size_t slots = static_cast<size_t>(groups) * SwissGroup::kWidth;
+        ctrl_.assign(slots, SwissGroup::kEmpty);
+        slots_.reset(new Slot[slots]);
+        numElements_ = 0;
+        numDeleted_ = 0;
+    }
+
+    void destroyAll() {
+        if (!slots_) return;
+        for (size_t i = 0; i < ctrl_.size(); ++i) {
+            if (ctrl_[i] >= 0) slots_[i].node()->~Node();
+        }
+        numElements_ = 0;
+        numDeleted_ = 0;
+    }
+};